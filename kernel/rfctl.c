@@ -33,6 +33,9 @@
 #include <linux/gpio.h>
 #include <linux/cdev.h>
 #include <linux/kfifo.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/wait.h>
 
 #define DRIVER_VERSION       "1.0"
 #define DRIVER_NAME          "rfctl"
@@ -69,6 +72,7 @@ static int device_open = 0;
 static int hw_mode = HW_MODE_POWER_DOWN;
 
 static DEFINE_MUTEX(read_lock);
+static DEFINE_MUTEX(write_lock);
 
 #define xstringify(s) stringify(s)
 #define stringify(s) #s
@@ -120,7 +124,30 @@ static struct timeval lasttv = { 0, 0 };
 /* Use FIFO to store received pulses */
 static DEFINE_KFIFO(rxfifo, int32_t, RBUF_LEN);
 
-static int32_t wbuf[WBUF_LEN];
+/*
+ * TX is double buffered.  One buffer is sent from an hrtimer, one
+ * element per expiry, while write() fills the other.  As long as user
+ * space keeps up, writes continue the waveform without any gap.  The
+ * timer is always forwarded from its last expiry, so late callbacks do
+ * not add up to drift.
+ */
+struct txbuf {
+	int32_t data[WBUF_LEN];
+	int     len;
+};
+
+static struct txbuf txbuf[2];
+static int tx_head;		/* Buffer being sent */
+static int tx_ready;		/* Buffers filled, including the one sent */
+static int tx_pos;		/* Next element in buffer being sent */
+static int32_t tx_last;		/* Last element sent */
+static bool tx_active;
+static bool tx_dry;		/* Ran dry after a pulse, see tx_next() */
+static unsigned int underruns;
+
+static struct hrtimer tx_timer;
+static DEFINE_SPINLOCK(tx_lock);
+static DECLARE_WAIT_QUEUE_HEAD(tx_wait);
 
 /* AUREL RTX-MID transceiver TX setup sequence
    will use rf_enable as well as tx_ctrl pins.
@@ -219,33 +246,76 @@ static void off(void)
 	gpio_set_value(gpio_out_pin, 0);
 }
 
-#ifndef MAX_UDELAY_MS
-#define MAX_UDELAY_US 5000
-#else
-#define MAX_UDELAY_US (MAX_UDELAY_MS*1000)
-#endif
-
-static void safe_udelay(unsigned long usecs)
+/*
+ * Send next element, switching to the other buffer, without a gap, at
+ * the end of the current one.  When there is nothing more to send the
+ * transmitter is turned off.  All generated waveforms end on a space,
+ * so running dry after a pulse is either the end of a raw stream, or
+ * user space not keeping up with it.  Only a following write() to the
+ * same open device tells, then it is an underrun.
+ */
+static enum hrtimer_restart tx_next(struct hrtimer *timer)
 {
-	while (usecs > MAX_UDELAY_US) {
-		udelay(MAX_UDELAY_US);
-		usecs -= MAX_UDELAY_US;
+	enum hrtimer_restart rc = HRTIMER_RESTART;
+	unsigned long flags;
+	int32_t val;
+
+	spin_lock_irqsave(&tx_lock, flags);
+	if (tx_pos == txbuf[tx_head].len) {
+		tx_head = !tx_head;
+		tx_pos = 0;
+		tx_ready--;
+		wake_up_interruptible(&tx_wait);
+
+		if (!tx_ready) {
+			if (tx_last & LIRC_MODE2_PULSE)
+				tx_dry = true;
+
+			off();
+			tx_active = false;
+			rc = HRTIMER_NORESTART;
+			goto leave;
+		}
 	}
-	udelay(usecs);
+
+	val = txbuf[tx_head].data[tx_pos++];
+	if (val & LIRC_MODE2_PULSE)
+		on();
+	else
+		off();
+	tx_last = val;
+	hrtimer_add_expires_ns(timer, (u64)(val & LIRC_VALUE_MASK) * NSEC_PER_USEC);
+
+leave:
+	spin_unlock_irqrestore(&tx_lock, flags);
+	return rc;
 }
 
-static void send_pulse_gpio(unsigned long length)
+/* Wait for all queued elements to be sent, or drop them on signal */
+static void tx_drain(void)
 {
-	on();
-	/* dbg("%ld us\n", length); */
-	safe_udelay(length);
+	unsigned long flags;
+
+	if (wait_event_interruptible(tx_wait, !tx_active)) {
+		hrtimer_cancel(&tx_timer);
+
+		spin_lock_irqsave(&tx_lock, flags);
+		tx_active = false;
+		tx_ready = 0;
+		spin_unlock_irqrestore(&tx_lock, flags);
+		wake_up_interruptible(&tx_wait);
+	}
+	off();
 }
 
-static void send_space_gpio(unsigned long length)
+/* New stream, running dry after the last one is not an underrun */
+static void tx_clear_dry(void)
 {
-	off();
-	/* dbg("%ld us\n", length); */
-	safe_udelay(length);
+	unsigned long flags;
+
+	spin_lock_irqsave(&tx_lock, flags);
+	tx_dry = false;
+	spin_unlock_irqrestore(&tx_lock, flags);
 }
 
 static irqreturn_t irq_handler(int i, void *blah)
@@ -393,6 +463,7 @@ static ssize_t rfctl_read(struct file *filp, char *buf, size_t length, loff_t *o
 	int ret = 0;
 	unsigned int copied = 0;
 
+	tx_drain();
 	set_rx_mode();
 	if (!interrupt_enabled) {
 		//enable_irq(irq);
@@ -407,48 +478,92 @@ static ssize_t rfctl_read(struct file *filp, char *buf, size_t length, loff_t *o
 	return (ssize_t)(ret ? ret : copied);
 }
 
+/*
+ * Queue elements for sending, returns as soon as they are in a buffer.
+ * Writes of any length are accepted, a write larger than one buffer
+ * blocks until the first part has been sent.  A write continuing a
+ * stream that ran dry after a pulse, an underrun, fails with -EPIPE,
+ * the following ones start a new stream.
+ */
 static ssize_t rfctl_write(struct file *file, const char *buf, size_t n, loff_t *ppos)
 {
-	int i, err, count;
 	unsigned long flags;
+	size_t count, done = 0;
+	bool dry;
+	int err = 0;
+
+	dbg("%zd bytes\n", n);
+
+	if (n % sizeof(int32_t))
+		return -EINVAL;
+	count = n / sizeof(int32_t);
+
+	if (mutex_lock_interruptible(&write_lock))
+		return -ERESTARTSYS;
+
+	spin_lock_irqsave(&tx_lock, flags);
+	dry = tx_dry;
+	tx_dry = false;
+	spin_unlock_irqrestore(&tx_lock, flags);
+	if (dry) {
+		underruns++;
+		errx("TX underrun, %u in total\n", underruns);
+		err = -EPIPE;
+		goto leave;
+	}
 
 	if (interrupt_enabled) {
 		//disable_irq(irq);
 		interrupt_enabled = 0;
 	}
-	set_tx_mode();
 
-	/* Workaround, TX pin gets reset to input in long-time test */
-	gpio_direction(gpio_out_pin,  0, "TX");
+	while (done < count) {
+		size_t len = min_t(size_t, count - done, WBUF_LEN);
+		int slot;
 
-	dbg("%zd bytes\n", n);
+		if (wait_event_interruptible(tx_wait, tx_ready < 2)) {
+			err = -ERESTARTSYS;
+			break;
+		}
 
-	if (n % sizeof(int32_t))
-		return -EINVAL;
+		/* The timer never touches a buffer that is not ready */
+		spin_lock_irqsave(&tx_lock, flags);
+		slot = (tx_head + tx_ready) % 2;
+		spin_unlock_irqrestore(&tx_lock, flags);
 
-	count = n / sizeof(int32_t);
-	if (count > WBUF_LEN) {
-		errx("Too many elements (%d) in TX buffer, max %d\n", count, WBUF_LEN);
-		return -EINVAL;
-	}
+		if (copy_from_user(txbuf[slot].data, buf + done * sizeof(int32_t), len * sizeof(int32_t))) {
+			errx("Failed copy_from_user() TX buffer\n");
+			err = -EFAULT;
+			break;
+		}
 
-	err = copy_from_user(wbuf, buf, n);
-	if (err) {
-		errx("Failed copy_from_user() TX buffer, err %d\n", err);
-		return -EFAULT;
-	}
+		if (!tx_active) {
+			set_tx_mode();
 
-	local_irq_save(flags);
-	for (i = 0; i < count; i++) {
-		if (wbuf[i] & LIRC_MODE2_PULSE)
-			send_pulse_gpio(wbuf[i] & LIRC_VALUE_MASK);
-		else
-			send_space_gpio(wbuf[i] & LIRC_VALUE_MASK);
+			/* Workaround, TX pin gets reset to input in long-time test */
+			gpio_direction(gpio_out_pin,  0, "TX");
+		}
+
+		spin_lock_irqsave(&tx_lock, flags);
+		txbuf[slot].len = len;
+		tx_ready++;
+		if (!tx_active) {
+			tx_active = true;
+			tx_pos = 0;
+			tx_last = 0;
+			hrtimer_start(&tx_timer, ktime_set(0, 0), HRTIMER_MODE_REL);
+		}
+		spin_unlock_irqrestore(&tx_lock, flags);
+
+		done += len;
 	}
-	off();
-	local_irq_restore(flags);
 
-	return n;
+leave:
+	mutex_unlock(&write_lock);
+	if (done)
+		return done * sizeof(int32_t);
+
+	return err;
 }
 
 static long rfctl_ioctl(struct file *filep, unsigned int cmd, unsigned long arg)
@@ -505,6 +620,7 @@ static int rfctl_open(struct inode *ino, struct file *filep)
 		interrupt_enabled = 0;
 	}
 
+	tx_clear_dry();
 	try_module_get(THIS_MODULE);
 	device_open++;
 
@@ -513,7 +629,9 @@ static int rfctl_open(struct inode *ino, struct file *filep)
 
 static int rfctl_close(struct inode *node, struct file *file)
 {
-	off();
+	/* Let queued elements go out before we let go, a raw stream ends here */
+	tx_drain();
+	tx_clear_dry();
 
 	if (interrupt_enabled) {
 		//disable_irq(irq);
@@ -617,6 +735,9 @@ static int rfctl_init_module(void)
 	if (result < 0)
 		goto leave;
 
+	hrtimer_init(&tx_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	tx_timer.function = tx_next;
+
 	info("%s %s registered\n", DRIVER_NAME, DRIVER_VERSION);
 	dbg("dev major = %d\n", dev_major);
 	dbg("IRQ = %d\n", irq);
@@ -631,6 +752,7 @@ leave:
 
 static void rfctl_exit_module(void)
 {
+	hrtimer_cancel(&tx_timer);
 	cdev_del(&rfctl_dev);
 	unregister_chrdev_region(MKDEV(dev_major, 0), 1);
 
@@ -662,6 +784,9 @@ MODULE_LICENSE("GPL");
 module_param(debug, bool, S_IRUGO | S_IWUSR);
 MODULE_PARM_DESC(debug, "Enable debugging messages");
 
+module_param(underruns, uint, S_IRUGO);
+MODULE_PARM_DESC(underruns, "Number of TX underruns, user space did not keep up with a stream");
+
 module_param(gpio_out_pin, int, S_IRUGO);
 MODULE_PARM_DESC(gpio_out_pin, "GPIO output (Tx) pin of the BCM"
 		 " processor. (default " xstringify(DEFAULT_GPIO_OUT_PIN) ")");
@@ -6,6 +6,8 @@
 #
 #   crontab onoff.tab
 #
+# The lights are the group 'lights' in /etc/rfctl.conf, see rfctl.conf
+#
 
 onoff=$1
 #FIREFLY=/home/pi/firefly.py
@@ -13,11 +15,8 @@ RFCTL=/usr/local/bin/rfctl
 
 onoff()
 {
-    for i in `seq 1 4`; do
-	echo "$RFCTL -p CONRAD -g 1 -c $i -l $1"
-	sleep 1
-	$RFCTL -p CONRAD -g 1 -c $i -l $1
-    done
+    echo "$RFCTL -n lights -l $1"
+    $RFCTL -n lights -l $1
 }
 
 if [ $# -lt 1 ]; then
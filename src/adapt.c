@@ -0,0 +1,148 @@
+/* Control tool for NEXA and other RF remote receivers
+ *
+ * Copyright (C) 2010, 2012  Tord Andersson <tord.andersson@endian.se>
+ * Copyright (C) 2017        Joachim Nilsson <troglobit@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, visit the Free Software Foundation
+ * website at http://www.gnu.org/licenses/gpl-2.0.html or write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "common.h"
+#include "protocol.h"
+
+/*
+ * Only NEXA_L is decoded, so only its windows are adapted.  The other
+ * classes keep their nominal windows until they get decoders.
+ */
+#define CLASS RF_CLASS_NEXA_L
+#define S     NEXA_L_PERIOD
+#define L     NEXA_L_LONG_PERIOD
+
+void rf_adapt_nominal(int32_t *s, int32_t *l)
+{
+	*s = S;
+	*l = L;
+}
+
+void rf_adapt_init(struct rf_adapt *ad)
+{
+	memset(ad, 0, sizeof(*ad));
+	rf_windows_init(&ad->win);
+}
+
+/*
+ * Two-means over the histogram bins within the nominal short and long
+ * windows, widened by the max drift, starting from the nominal levels.
+ * Returns 0 and the levels in @s and @l, or -1 if there are too few
+ * samples or they are too far off to be this protocol.
+ */
+static int cluster(const struct rf_adapt *ad, const struct rf_windows *nom, int32_t *s, int32_t *l)
+{
+	int lo = nom->lo[CLASS * 3 + RF_SYM_SHORT] * (100 - RF_ADAPT_DRIFT) / 100 / RF_ADAPT_BIN;
+	int hi = nom->hi[CLASS * 3 + RF_SYM_LONG] * (100 + RF_ADAPT_DRIFT) / 100 / RF_ADAPT_BIN;
+	int iter, b;
+
+	if (hi >= RF_ADAPT_BINS)
+		hi = RF_ADAPT_BINS - 1;
+
+	*s = S;
+	*l = L;
+	for (iter = 0; iter < 8; iter++) {
+		uint64_t sum[2] = { 0 }, num[2] = { 0 };
+		int32_t mid = (*s + *l) / 2;
+
+		for (b = lo; b <= hi; b++) {
+			int32_t usec = b * RF_ADAPT_BIN + RF_ADAPT_BIN / 2;
+			int k = usec >= mid;
+
+			sum[k] += (uint64_t)usec * ad->hist[b];
+			num[k] += ad->hist[b];
+		}
+		if (num[0] < RF_ADAPT_MIN || num[1] < RF_ADAPT_MIN)
+			return -1;
+
+		*s = sum[0] / num[0];
+		*l = sum[1] / num[1];
+	}
+
+	if (abs(*s - S) * 100 > S * RF_ADAPT_DRIFT || abs(*l - L) * 100 > L * RF_ADAPT_DRIFT)
+		return -1;
+
+	return 0;
+}
+
+/*
+ * Nominal windows are scaled by how much longer or shorter the symbols
+ * are, and the short/long boundary is put half way between the learned
+ * levels.  The windows keep their width relative to the symbols, they
+ * are only moved.
+ */
+static void relearn(struct rf_adapt *ad)
+{
+	struct rf_windows nom;
+	int32_t s, l;
+	int w;
+
+	rf_windows_init(&nom);
+	ad->win = nom;
+
+	if (cluster(ad, &nom, &s, &l)) {
+		ad->level[0] = ad->level[1] = 0;
+		return;
+	}
+	ad->level[0] = s;
+	ad->level[1] = l;
+
+	for (w = CLASS * 3; w < CLASS * 3 + 3; w++) {
+		ad->win.lo[w] = (int64_t)nom.lo[w] * (s + l) / (S + L);
+		ad->win.hi[w] = (int64_t)nom.hi[w] * (s + l) / (S + L);
+	}
+	ad->win.hi[CLASS * 3 + RF_SYM_SHORT] = (s + l) / 2;
+	ad->win.lo[CLASS * 3 + RF_SYM_LONG]  = (s + l) / 2;
+}
+
+/*
+ * Add durations of a frame decoded as @protocol and update the windows.
+ * Frames of other protocols are ignored, so they never move the NEXA_L
+ * windows.
+ */
+void rf_adapt_frame(struct rf_adapt *ad, rf_protocol_t protocol, const int32_t *edges, int len)
+{
+	int i, b;
+
+	if (protocol != PROT_NEXA_L)
+		return;
+
+	for (i = 0; i < len; i++) {
+		if (LIRC_IS_TIMEOUT(edges[i]))
+			continue;
+
+		b = LIRC_VALUE(edges[i]) / RF_ADAPT_BIN;
+		if (b >= RF_ADAPT_BINS)
+			continue;
+
+		ad->hist[b]++;
+		if (++ad->samples < RF_ADAPT_DECAY)
+			continue;
+
+		/* Older frames weigh less, so drift is tracked */
+		for (b = 0; b < RF_ADAPT_BINS; b++)
+			ad->hist[b] /= 2;
+		ad->samples /= 2;
+	}
+
+	relearn(ad);
+}
@@ -0,0 +1,365 @@
+/* Control tool for NEXA and other RF remote receivers
+ *
+ * Copyright (C) 2010, 2012  Tord Andersson <tord.andersson@endian.se>
+ * Copyright (C) 2017        Joachim Nilsson <troglobit@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, visit the Free Software Foundation
+ * website at http://www.gnu.org/licenses/gpl-2.0.html or write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <errno.h>
+#include <time.h>
+
+#include "common.h"
+#include "batch.h"
+
+struct worker {
+	struct batch      *b;
+	int                id;
+	struct rx_decoder  dec;
+};
+
+static int64_t now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void collect(void *arg, const struct rx_event *ev)
+{
+	struct batch_seg *seg = arg;
+
+	if (seg->num == seg->max) {
+		size_t max = seg->max ? seg->max * 2 : 64;
+		struct batch_hit *hit;
+
+		hit = realloc(seg->hit, max * sizeof(*hit));
+		if (!hit) {
+			seg->error = ENOMEM;
+			return;
+		}
+		seg->hit = hit;
+		seg->max = max;
+	}
+
+	seg->hit[seg->num].ev   = *ev;
+	seg->hit[seg->num].file = seg->file;
+	seg->num++;
+}
+
+/*
+ * Each worker has its own cursor in the shared, read-only, mapping of
+ * the file.  Adaptation starts over from nominal timing per segment.
+ */
+static void segment(struct worker *w, struct batch_seg *seg)
+{
+	struct capture cap = w->b->cap[seg->file];
+	bool synced = seg->first == 0;
+	int32_t val;
+	int rc;
+
+	rx_decoder_init(&w->dec, collect, seg);
+	if (capture_block(&cap, seg->first)) {
+		seg->error = errno;
+		return;
+	}
+
+	while ((rc = capture_next(&cap, &val)) > 0) {
+		bool past = cap.blk > seg->last;
+		bool gap  = LIRC_IS_TIMEOUT(val) || (LIRC_IS_SPACE(val) && LIRC_VALUE(val) >= RX_GAP);
+
+		/* Frame in progress at the start belongs to the previous segment */
+		if (!synced) {
+			if (past)
+				break;
+			synced = gap;
+			continue;
+		}
+
+		seg->edges++;
+		if (rx_decoder_edge(&w->dec, val, cap.time - LIRC_VALUE(val)) && past)
+			break;
+	}
+	if (rc < 0)
+		seg->error = errno;
+	rx_decoder_flush(&w->dec);
+
+	seg->frames   = w->dec.frames;
+	seg->commands = w->dec.commands;
+	seg->repeats  = w->dec.repeats;
+	seg->undecoded = w->dec.undecoded;
+}
+
+/* Next segment of our own queue, or -1 */
+static ssize_t take(struct batch_queue *q)
+{
+	ssize_t i = -1;
+
+	pthread_mutex_lock(&q->lock);
+	if (q->head < q->tail)
+		i = q->head++;
+	pthread_mutex_unlock(&q->lock);
+
+	return i;
+}
+
+/* Last segment of the busiest other queue, or -1 when all are done */
+static ssize_t steal(struct batch *b, int id)
+{
+	while (1) {
+		struct batch_queue *q = NULL;
+		size_t most = 0;
+		ssize_t i = -1;
+		int j;
+
+		for (j = 0; j < b->jobs; j++) {
+			struct batch_queue *v = &b->queue[j];
+			size_t left;
+
+			if (j == id)
+				continue;
+
+			pthread_mutex_lock(&v->lock);
+			left = v->tail - v->head;
+			pthread_mutex_unlock(&v->lock);
+			if (left > most) {
+				most = left;
+				q = v;
+			}
+		}
+		if (!q)
+			return -1;
+
+		pthread_mutex_lock(&q->lock);
+		if (q->head < q->tail)
+			i = --q->tail;
+		pthread_mutex_unlock(&q->lock);
+
+		if (i >= 0) {
+			atomic_fetch_add(&b->steals, 1);
+			return i;
+		}
+	}
+}
+
+static void *worker(void *arg)
+{
+	struct worker *w = arg;
+	ssize_t i;
+
+	while ((i = take(&w->b->queue[w->id])) >= 0 || (i = steal(w->b, w->id)) >= 0)
+		segment(w, &w->b->seg[i]);
+
+	return NULL;
+}
+
+/*
+ * Split files into segments of BATCH_BLOCKS, and hand each worker an
+ * equal run of consecutive segments to start with.
+ */
+int batch_open(struct batch *b, char **name, int files, int jobs)
+{
+	size_t num = 0;
+	int i;
+
+	memset(b, 0, sizeof(*b));
+	atomic_init(&b->steals, 0);
+	if (jobs <= 0)
+		jobs = sysconf(_SC_NPROCESSORS_ONLN);
+	if (jobs <= 0)
+		jobs = 1;
+
+	b->name = name;
+	b->cap  = calloc(files, sizeof(*b->cap));
+	if (!b->cap)
+		goto nomem;
+
+	for (i = 0; i < files; i++) {
+		if (capture_open(&b->cap[i], name[i])) {
+			int err = errno;
+
+			fprintf(stderr, "Error opening %s: %s\n", name[i], strerror(err));
+			batch_close(b);
+			errno = err;
+			return -1;
+		}
+		b->files++;
+		num += (b->cap[i].num + BATCH_BLOCKS - 1) / BATCH_BLOCKS;
+	}
+
+	b->seg = calloc(num ? num : 1, sizeof(*b->seg));
+	b->queue = calloc(jobs, sizeof(*b->queue));
+	if (!b->seg || !b->queue)
+		goto nomem;
+
+	for (i = 0; i < files; i++) {
+		uint32_t blk;
+
+		for (blk = 0; blk < b->cap[i].num; blk += BATCH_BLOCKS) {
+			struct batch_seg *seg = &b->seg[b->segs++];
+
+			seg->file  = i;
+			seg->first = blk;
+			seg->last  = blk + BATCH_BLOCKS < b->cap[i].num ? blk + BATCH_BLOCKS : b->cap[i].num;
+		}
+	}
+
+	b->jobs = jobs;
+	for (i = 0; i < jobs; i++) {
+		struct batch_queue *q = &b->queue[i];
+
+		pthread_mutex_init(&q->lock, NULL);
+		q->head = b->segs * i / jobs;
+		q->tail = b->segs * (i + 1) / jobs;
+	}
+
+	return 0;
+nomem:
+	fprintf(stderr, "Error allocating decode segments\n");
+	batch_close(b);
+	errno = ENOMEM;
+
+	return -1;
+}
+
+static int by_time(const void *a, const void *b)
+{
+	const struct batch_hit *x = a, *y = b;
+
+	if (x->ev.time != y->ev.time)
+		return x->ev.time < y->ev.time ? -1 : 1;
+
+	return x->file - y->file;
+}
+
+/*
+ * Join segment results.  A button held across a segment boundary was
+ * seen as two presses, the first at the end of one segment and the
+ * second at the start of the next, those are one again.
+ */
+static int merge(struct batch *b)
+{
+	struct batch_hit *prev = NULL;
+	size_t num = 0, s, i;
+
+	for (s = 0; s < b->segs; s++)
+		num += b->seg[s].num;
+
+	b->hit = malloc((num ? num : 1) * sizeof(*b->hit));
+	if (!b->hit)
+		return -1;
+
+	for (s = 0; s < b->segs; s++) {
+		struct batch_seg *seg = &b->seg[s];
+
+		b->edges    += seg->edges;
+		b->frames   += seg->frames;
+		b->commands += seg->commands;
+		b->repeats  += seg->repeats;
+		b->undecoded += seg->undecoded;
+		if (seg->error == ENOMEM) {
+			errno = ENOMEM;
+			return -1;
+		}
+		if (seg->error)
+			b->corrupt++;
+
+		for (i = 0; i < seg->num; i++) {
+			struct rx_event *ev = &seg->hit[i].ev;
+
+			if (i == 0 && prev && prev->file == seg->file &&
+			    !memcmp(&prev->ev.cmd, &ev->cmd, sizeof(ev->cmd)) &&
+			    ev->time - prev->ev.end <= rx_repeat_gap(ev->cmd.protocol)) {
+				prev->ev.last   = ev->last;
+				prev->ev.end    = ev->end;
+				prev->ev.count += ev->count;
+				b->repeats++;
+				continue;
+			}
+
+			b->hit[b->num] = seg->hit[i];
+			prev = &b->hit[b->num++];
+		}
+		if (!seg->num)
+			prev = NULL;
+	}
+
+	/* Files may overlap in time, e.g. from several receivers */
+	qsort(b->hit, b->num, sizeof(*b->hit), by_time);
+
+	return 0;
+}
+
+/* Decode all segments, returns -1 with errno set on failure */
+int batch_run(struct batch *b)
+{
+	struct worker *w;
+	pthread_t *tid;
+	int64_t start;
+	int i, n;
+
+	w   = calloc(b->jobs, sizeof(*w));
+	tid = calloc(b->jobs, sizeof(*tid));
+	if (!w || !tid) {
+		free(w);
+		free(tid);
+		errno = ENOMEM;
+		return -1;
+	}
+
+	start = now_us();
+	for (n = 0; n < b->jobs; n++) {
+		w[n].b  = b;
+		w[n].id = n;
+		if (pthread_create(&tid[n], NULL, worker, &w[n]))
+			break;
+	}
+
+	/* Others steal the work of a worker that could not be started */
+	if (!n)
+		worker(&w[0]);
+	for (i = 0; i < n; i++)
+		pthread_join(tid[i], NULL);
+	b->usec = now_us() - start;
+
+	free(tid);
+	free(w);
+
+	return merge(b);
+}
+
+void batch_close(struct batch *b)
+{
+	size_t s;
+	int i;
+
+	for (i = 0; i < b->files; i++)
+		capture_close(&b->cap[i]);
+	for (s = 0; s < b->segs; s++)
+		free(b->seg[s].hit);
+	if (b->queue) {
+		for (i = 0; i < b->jobs; i++)
+			pthread_mutex_destroy(&b->queue[i].lock);
+	}
+	free(b->queue);
+	free(b->seg);
+	free(b->cap);
+	free(b->hit);
+	memset(b, 0, sizeof(*b));
+}
@@ -0,0 +1,92 @@
+/* Control tool for NEXA and other RF remote receivers
+ *
+ * Copyright (C) 2010, 2012  Tord Andersson <tord.andersson@endian.se>
+ * Copyright (C) 2017        Joachim Nilsson <troglobit@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, visit the Free Software Foundation
+ * website at http://www.gnu.org/licenses/gpl-2.0.html or write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef RFCTL_BATCH_H_
+#define RFCTL_BATCH_H_
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "capture.h"
+#include "rx.h"
+
+#define BATCH_BLOCKS 64		/* Capture blocks per segment, about 128k elements */
+
+/* Decoded command, repeats included, and the file it was read from */
+struct batch_hit {
+	struct rx_event  ev;
+	int              file;
+};
+
+/*
+ * Blocks [first, last) of a capture file.  A segment decodes the frames
+ * that start after the first gap in it, or at the start of the file, up
+ * to the first gap at or after its end.  So neighbours agree on where
+ * one ends and the next begins, without reading each other's output.
+ */
+struct batch_seg {
+	int               file;
+	uint32_t          first, last;
+	struct batch_hit *hit;		/* In time order */
+	size_t            num, max;
+	unsigned long     edges;
+	unsigned long     frames, commands, repeats, undecoded;
+	int               error;		/* errno, EINVAL on a bad block */
+};
+
+/*
+ * Segments not yet decoded by a worker, [head, tail).  The worker takes
+ * from the head, in file order, idle workers steal from the tail.
+ */
+struct batch_queue {
+	pthread_mutex_t   lock;
+	size_t            head, tail;
+};
+
+/*
+ * Offline decoding of capture files on a pool of worker threads, one per
+ * core by default.  Results are merged in time order into @hit.
+ */
+struct batch {
+	int                 files;
+	char              **name;
+	struct capture     *cap;
+
+	struct batch_seg   *seg;
+	size_t              segs;
+	struct batch_queue *queue;
+	int                 jobs;
+	atomic_ulong        steals;
+
+	struct batch_hit   *hit;
+	size_t              num;
+
+	unsigned long       edges, frames, commands, repeats, undecoded;
+	int64_t             usec;		/* Wall-clock time decoding */
+	int                 corrupt;		/* Segments with bad blocks */
+};
+
+int  batch_open  (struct batch *b, char **name, int files, int jobs);
+int  batch_run   (struct batch *b);
+void batch_close (struct batch *b);
+
+#endif /* RFCTL_BATCH_H_ */
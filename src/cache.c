@@ -0,0 +1,223 @@
+/* Control tool for NEXA and other RF remote receivers
+ *
+ * Copyright (C) 2010, 2012  Tord Andersson <tord.andersson@endian.se>
+ * Copyright (C) 2017        Joachim Nilsson <troglobit@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, visit the Free Software Foundation
+ * website at http://www.gnu.org/licenses/gpl-2.0.html or write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <errno.h>
+
+#include "common.h"
+#include "cache.h"
+
+static time_t now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec;
+}
+
+static uint32_t hash(rf_protocol_t protocol, uint32_t address, int unit)
+{
+	uint32_t h = 2166136261u;
+
+	h = (h ^ protocol) * 16777619u;
+	h = (h ^ address)  * 16777619u;
+	h = (h ^ unit)     * 16777619u;
+
+	return h;
+}
+
+static struct cache_entry *slot_find(struct cache_entry *slot, uint32_t num, rf_protocol_t protocol,
+				     uint32_t address, int unit)
+{
+	uint32_t i = hash(protocol, address, unit) & (num - 1);
+
+	/* Never full, load is kept below 50% */
+	while (slot[i].protocol != PROT_UNKNOWN) {
+		if (slot[i].protocol == protocol && slot[i].address == address && slot[i].unit == unit)
+			break;
+		i = (i + 1) & (num - 1);
+	}
+
+	return &slot[i];
+}
+
+static int grow(struct cache *c)
+{
+	uint32_t num = c->num_slots * 2;
+	struct cache_entry *slot;
+	uint32_t i;
+
+	slot = calloc(num, sizeof(*slot));
+	if (!slot)
+		return -1;
+
+	for (i = 0; i < c->num_slots; i++) {
+		if (c->slot[i].protocol != PROT_UNKNOWN)
+			*slot_find(slot, num, c->slot[i].protocol, c->slot[i].address,
+				   c->slot[i].unit) = c->slot[i];
+	}
+
+	free(c->slot);
+	c->slot = slot;
+	c->num_slots = num;
+	c->cursor = 0;
+
+	return 0;
+}
+
+int cache_init(struct cache *c, int window, int reassert)
+{
+	memset(c, 0, sizeof(*c));
+	c->window    = window;
+	c->reassert  = reassert;
+	c->num_slots = 64;
+	c->slot      = calloc(c->num_slots, sizeof(*c->slot));
+
+	return c->slot ? 0 : -1;
+}
+
+/* Re-asserted states may be passed straight from the entry itself */
+static void copy(char *dst, const char *src)
+{
+	if (dst != src)
+		memmove(dst, src, strlen(src) + 1);
+}
+
+/*
+ * A NEXA_L group frame, unit 0, sets all units learned to the ID, so
+ * their cached state follows it.  A frame to one unit means the group
+ * no longer has one level, it is neither suppressed nor re-asserted
+ * until the next group frame, which would undo the unit's command.
+ */
+static void group_sync(struct cache *c, const struct cache_entry *e)
+{
+	struct cache_entry *g;
+	uint32_t i;
+
+	if (e->protocol != PROT_NEXA_L)
+		return;
+
+	if (e->unit) {
+		g = slot_find(c->slot, c->num_slots, e->protocol, e->address, 0);
+		if (g->protocol != PROT_UNKNOWN && g->level != e->level)
+			g->level = CACHE_MIXED;
+		return;
+	}
+
+	for (i = 0; i < c->num_slots; i++) {
+		struct cache_entry *u = &c->slot[i];
+
+		if (u->protocol != e->protocol || u->address != e->address || !u->unit)
+			continue;
+
+		u->level = e->level;
+		u->when  = e->when;
+		copy(u->value, e->value);
+	}
+}
+
+/*
+ * Check if command should be sent, returns 0 if it is identical to the
+ * last one sent to the device within the suppress window, otherwise
+ * the new state is recorded and 1 is returned.  Commands that cannot
+ * be cached, e.g. unsupported protocols, are always sent.  NEXA_L group
+ * frames also update all units of the ID, see group_sync().
+ */
+int cache_check(struct cache *c, rf_protocol_t protocol, const char *group,
+		const char *channel, const char *level, bool force)
+{
+	struct cache_entry *e;
+	uint32_t address;
+	int unit, lvl;
+
+	if (rf_address(protocol, group, channel, &address, &unit) ||
+	    strlen(group) >= sizeof(e->group) || strlen(channel) >= sizeof(e->channel) ||
+	    strlen(level) >= sizeof(e->value)) {
+		c->sent++;
+		return 1;
+	}
+
+	lvl = atoi(level);
+	e = slot_find(c->slot, c->num_slots, protocol, address, unit);
+	if (e->protocol != PROT_UNKNOWN && e->level == lvl && !force &&
+	    now() - e->when < c->window) {
+		c->suppressed++;
+		return 0;
+	}
+
+	if (e->protocol == PROT_UNKNOWN) {
+		if ((c->num + 1) * 2 > c->num_slots) {
+			if (grow(c))
+				goto done;
+			e = slot_find(c->slot, c->num_slots, protocol, address, unit);
+		}
+		c->num++;
+	}
+
+	e->protocol = protocol;
+	e->address  = address;
+	e->unit     = unit;
+	e->level    = lvl;
+	e->when     = now();
+	copy(e->group, group);
+	copy(e->channel, channel);
+	copy(e->value, level);
+	group_sync(c, e);
+done:
+	c->sent++;
+
+	return 1;
+}
+
+/*
+ * Find next device whose state was last sent more than the re-assert
+ * interval ago, round-robin over all devices.  Its timestamp is updated,
+ * so the caller is expected to send it.
+ */
+struct cache_entry *cache_stale(struct cache *c)
+{
+	time_t t = now();
+	uint32_t i;
+
+	if (!c->reassert)
+		return NULL;
+
+	for (i = 0; i < c->num_slots; i++) {
+		struct cache_entry *e = &c->slot[c->cursor];
+
+		c->cursor = (c->cursor + 1) & (c->num_slots - 1);
+		if (e->protocol != PROT_UNKNOWN && e->level != CACHE_MIXED &&
+		    t - e->when >= c->reassert) {
+			e->when = t;
+			c->reasserted++;
+			return e;
+		}
+	}
+
+	return NULL;
+}
+
+void cache_exit(struct cache *c)
+{
+	free(c->slot);
+	memset(c, 0, sizeof(*c));
+}
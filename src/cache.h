@@ -0,0 +1,63 @@
+/* Control tool for NEXA and other RF remote receivers
+ *
+ * Copyright (C) 2010, 2012  Tord Andersson <tord.andersson@endian.se>
+ * Copyright (C) 2017        Joachim Nilsson <troglobit@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, visit the Free Software Foundation
+ * website at http://www.gnu.org/licenses/gpl-2.0.html or write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef RFCTL_CACHE_H_
+#define RFCTL_CACHE_H_
+
+#include <time.h>
+#include "protocol.h"
+
+#define CACHE_MIXED  -1	/* Group whose units have been sent different levels */
+
+/* Last commanded state of one device, or NEXA_L group, unit 0 */
+struct cache_entry {
+	rf_protocol_t protocol;	/* PROT_UNKNOWN marks an empty slot */
+	uint32_t      address;
+	int           unit;
+	int           level;	/* Or CACHE_MIXED */
+	time_t        when;	/* Last sent, monotonic seconds */
+	char          group[16];
+	char          channel[16];
+	char          value[8];	/* Level as given, for re-assert */
+};
+
+struct cache {
+	struct cache_entry *slot;
+	uint32_t            num_slots;
+	uint32_t            num;
+	uint32_t            cursor;	/* Next slot to consider for re-assert */
+
+	int                 window;	/* Suppress identical commands, seconds */
+	int                 reassert;	/* Re-send state older than this, seconds */
+
+	unsigned long       sent;
+	unsigned long       suppressed;
+	unsigned long       reasserted;
+};
+
+int  cache_init       (struct cache *c, int window, int reassert);
+int  cache_check      (struct cache *c, rf_protocol_t protocol, const char *group,
+		       const char *channel, const char *level, bool force);
+struct cache_entry *cache_stale(struct cache *c);
+void cache_exit       (struct cache *c);
+
+#endif /* RFCTL_CACHE_H_ */
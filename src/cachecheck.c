@@ -0,0 +1,101 @@
+/* Control tool for NEXA and other RF remote receivers
+ *
+ * Copyright (C) 2010, 2012  Tord Andersson <tord.andersson@endian.se>
+ * Copyright (C) 2017        Joachim Nilsson <troglobit@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, visit the Free Software Foundation
+ * website at http://www.gnu.org/licenses/gpl-2.0.html or write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Check of the state cache with NEXA_L group frames, run by 'make
+ * check'.  A group frame sets all units of the ID, so a unit command
+ * after it must be sent, and re-asserting must not undo it.
+ */
+#include "common.h"
+#include "cache.h"
+
+#define ID "4711"
+
+static int fails;
+
+static void expect(bool ok, const char *what)
+{
+	printf("cache: %-48s %s\n", what, ok ? "ok" : "FAIL");
+	if (!ok)
+		fails++;
+}
+
+/* Make all states old enough to be re-asserted */
+static void age(struct cache *c)
+{
+	uint32_t i;
+
+	for (i = 0; i < c->num_slots; i++)
+		c->slot[i].when -= 3600;
+}
+
+/* Re-assert everything due, returns -1 if unit was sent @level, else 0 */
+static int reassert(struct cache *c, const char *unit, int level)
+{
+	struct cache_entry *e;
+	int rc = 0;
+
+	while ((e = cache_stale(c))) {
+		if (!strcmp(e->channel, unit) && e->level == level)
+			rc = -1;
+	}
+
+	return rc;
+}
+
+int main(void)
+{
+	struct cache c;
+
+	/* unit on, group off, unit on: the last must not be suppressed */
+	if (cache_init(&c, 3600, 0))
+		return 1;
+	cache_check(&c, PROT_NEXA_L, ID, "1", "1", false);
+	cache_check(&c, PROT_NEXA_L, ID, "all", "0", false);
+	expect(cache_check(&c, PROT_NEXA_L, ID, "1", "1", false) == 1,
+	       "unit on, group off, unit on is sent");
+	expect(cache_check(&c, PROT_NEXA_L, ID, "1", "1", false) == 0,
+	       "unit on again is suppressed");
+	cache_exit(&c);
+
+	/* unit on, group off: re-assert must not turn the unit back on */
+	if (cache_init(&c, 0, 60))
+		return 1;
+	cache_check(&c, PROT_NEXA_L, ID, "1", "1", false);
+	cache_check(&c, PROT_NEXA_L, ID, "all", "0", false);
+	age(&c);
+	expect(reassert(&c, "1", 1) == 0, "re-assert after group off keeps unit off");
+	cache_exit(&c);
+
+	/* group off, unit on: re-assert must not send the group off again */
+	if (cache_init(&c, 0, 60))
+		return 1;
+	cache_check(&c, PROT_NEXA_L, ID, "all", "0", false);
+	cache_check(&c, PROT_NEXA_L, ID, "1", "1", false);
+	age(&c);
+	expect(reassert(&c, "all", 0) == 0, "re-assert after unit on skips group off");
+	cache_exit(&c);
+
+	printf("%s\n", fails ? "FAIL" : "PASS");
+
+	return fails ? 1 : 0;
+}
@@ -0,0 +1,426 @@
+/* Control tool for NEXA and other RF remote receivers
+ *
+ * Copyright (C) 2010, 2012  Tord Andersson <tord.andersson@endian.se>
+ * Copyright (C) 2017        Joachim Nilsson <troglobit@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, visit the Free Software Foundation
+ * website at http://www.gnu.org/licenses/gpl-2.0.html or write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "common.h"
+#include "capture.h"
+
+#define ALIGN8(len) (((len) + 7) & ~7)
+
+static int fail(int err)
+{
+	errno = err;
+	return -1;
+}
+
+int64_t capture_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+
+	return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/*
+ * Parse wall-clock time, seconds since the epoch, or local time as
+ * 'YYYY-MM-DD[ HH:MM[:SS]]', a 'T' may also separate date and time.
+ */
+int capture_time(const char *str, int64_t *time)
+{
+	struct tm tm = { .tm_isdst = -1 };
+	char *end;
+	double sec;
+	int num;
+
+	sec = strtod(str, &end);
+	if (end != str && !*end && !strchr(str, '-')) {
+		*time = sec * 1000000;
+		return 0;
+	}
+
+	num = sscanf(str, "%d-%d-%d%*[ T]%d:%d:%d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+		     &tm.tm_hour, &tm.tm_min, &tm.tm_sec);
+	if (num != 3 && num != 5 && num != 6)
+		return fail(EINVAL);
+
+	tm.tm_year -= 1900;
+	tm.tm_mon  -= 1;
+	*time = (int64_t)mktime(&tm) * 1000000;
+
+	return 0;
+}
+
+/* Start a new capture file at @path, truncating any existing file */
+int capture_create(struct capture_out *out, const char *path, const char *device,
+		   rf_interface_t iface, int glitch)
+{
+	struct capture_hdr hdr = {
+		.magic    = CAPTURE_MAGIC,
+		.version  = CAPTURE_VERSION,
+		.hdr_size = sizeof(hdr),
+		.iface    = iface,
+		.clock    = CLOCK_REALTIME,
+		.glitch   = glitch,
+		.start    = capture_now(),
+	};
+
+	memset(out, 0, sizeof(*out));
+	if (device)
+		strncpy(hdr.device, device, sizeof(hdr.device) - 1);
+
+	out->fp = fopen(path, "w");
+	if (!out->fp)
+		return -1;
+
+	if (fwrite(&hdr, sizeof(hdr), 1, out->fp) != 1) {
+		fclose(out->fp);
+		out->fp = NULL;
+		return -1;
+	}
+	out->offset = sizeof(hdr);
+
+	return 0;
+}
+
+/* Write current block, if any, and add it to the index */
+static int block_end(struct capture_out *out)
+{
+	static const uint8_t pad[8];
+	struct capture_blk *blk = &out->blk;
+
+	if (!blk->num)
+		return 0;
+
+	if (out->num == out->max) {
+		uint32_t max = out->max ? out->max * 2 : 64;
+		struct capture_idx *idx;
+
+		idx = realloc(out->idx, max * sizeof(*idx));
+		if (!idx)
+			return -1;
+		out->idx = idx;
+		out->max = max;
+	}
+	out->idx[out->num].time   = blk->time;
+	out->idx[out->num].offset = out->offset;
+	out->num++;
+
+	if (fwrite(blk, sizeof(*blk), 1, out->fp) != 1 ||
+	    fwrite(out->data, 1, blk->len, out->fp) != blk->len ||
+	    fwrite(pad, 1, ALIGN8(blk->len) - blk->len, out->fp) != ALIGN8(blk->len) - blk->len)
+		return -1;
+
+	out->offset += sizeof(*blk) + ALIGN8(blk->len);
+	memset(blk, 0, sizeof(*blk));
+
+	return 0;
+}
+
+/*
+ * Append @len elements, @end is the wall-clock time the last of them
+ * ended, in us, or 0 for now.  The start of each new block is derived
+ * from it, so timestamps do not drift from the clock over long runs.
+ */
+int capture_write(struct capture_out *out, const int32_t *buf, int len, int64_t end)
+{
+	struct capture_blk *blk = &out->blk;
+	int64_t time;
+	int i;
+
+	if (!end)
+		end = capture_now();
+
+	time = end;
+	for (i = 0; i < len; i++)
+		time -= LIRC_VALUE(buf[i]);
+
+	for (i = 0; i < len; i++) {
+		uint32_t v = (uint32_t)LIRC_VALUE(buf[i]) << 2 | (LIRC_MODE2(buf[i]) >> 24 & 3);
+
+		if (blk->len + 5 > CAPTURE_BLOCK && block_end(out))
+			return -1;
+		if (!blk->num)
+			blk->time = time;
+
+		while (v >= 0x80) {
+			out->data[blk->len++] = v | 0x80;
+			v >>= 7;
+		}
+		out->data[blk->len++] = v;
+		blk->num++;
+
+		time += LIRC_VALUE(buf[i]);
+	}
+
+	return 0;
+}
+
+/* End current block and push it to disk, e.g. when reception is idle */
+int capture_flush(struct capture_out *out)
+{
+	if (block_end(out))
+		return -1;
+
+	return fflush(out->fp);
+}
+
+/* Flush last block, write index and close */
+int capture_finish(struct capture_out *out)
+{
+	struct capture_tail tail = { .magic = CAPTURE_INDEX };
+	int rc = 0;
+
+	if (!out->fp)
+		return 0;
+
+	if (block_end(out))
+		rc = -1;
+	tail.num    = out->num;
+	tail.offset = out->offset;
+
+	if (out->num && fwrite(out->idx, sizeof(*out->idx), out->num, out->fp) != out->num)
+		rc = -1;
+	if (fwrite(&tail, sizeof(tail), 1, out->fp) != 1)
+		rc = -1;
+	if (fclose(out->fp))
+		rc = -1;
+
+	free(out->idx);
+	memset(out, 0, sizeof(*out));
+
+	return rc;
+}
+
+/* Walk block headers of a file without index, stops at first torn block */
+static int index_build(struct capture *cap)
+{
+	uint64_t off = cap->hdr->hdr_size;
+	uint32_t max = 0;
+
+	while (off + sizeof(struct capture_blk) <= cap->size) {
+		const struct capture_blk *blk = (const void *)((const uint8_t *)cap->map + off);
+
+		if (blk->len > CAPTURE_BLOCK || !blk->num ||
+		    off + sizeof(*blk) + blk->len > cap->size)
+			break;
+
+		if (cap->num == max) {
+			struct capture_idx *idx;
+
+			max = max ? max * 2 : 64;
+			idx = realloc(cap->built, max * sizeof(*idx));
+			if (!idx)
+				return -1;
+			cap->built = idx;
+		}
+		cap->built[cap->num].time   = blk->time;
+		cap->built[cap->num].offset = off;
+		cap->num++;
+
+		off += sizeof(*blk) + ALIGN8(blk->len);
+	}
+	cap->idx = cap->built;
+
+	return 0;
+}
+
+/* Map capture file read-only, validating header and locating the index */
+int capture_open(struct capture *cap, const char *path)
+{
+	const struct capture_tail *tail;
+	struct stat sb;
+	int fd;
+
+	memset(cap, 0, sizeof(*cap));
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	if (fstat(fd, &sb) || (size_t)sb.st_size < sizeof(struct capture_hdr)) {
+		close(fd);
+		return fail(EINVAL);
+	}
+
+	cap->size = sb.st_size;
+	cap->map = mmap(NULL, cap->size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (cap->map == MAP_FAILED) {
+		cap->map = NULL;
+		return -1;
+	}
+
+	cap->hdr = cap->map;
+	if (memcmp(cap->hdr->magic, CAPTURE_MAGIC, sizeof(cap->hdr->magic)) ||
+	    cap->hdr->version != CAPTURE_VERSION || cap->hdr->hdr_size != sizeof(struct capture_hdr)) {
+		capture_close(cap);
+		return fail(EINVAL);
+	}
+
+	tail = (const void *)((const uint8_t *)cap->map + cap->size - sizeof(*tail));
+	if (cap->size >= sizeof(struct capture_hdr) + sizeof(*tail) && !(cap->size & 7) &&
+	    !memcmp(tail->magic, CAPTURE_INDEX, sizeof(tail->magic)) &&
+	    tail->offset + (uint64_t)tail->num * sizeof(struct capture_idx) + sizeof(*tail) == cap->size) {
+		cap->idx = (const void *)((const uint8_t *)cap->map + tail->offset);
+		cap->num = tail->num;
+	} else if (index_build(cap)) {
+		capture_close(cap);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Position at the first element of block @i, e.g. for parallel readers */
+int capture_block(struct capture *cap, uint32_t i)
+{
+	const struct capture_blk *blk;
+	uint64_t off = cap->idx[i].offset;
+
+	if (off < cap->hdr->hdr_size || off + sizeof(*blk) > cap->size)
+		return fail(EINVAL);
+
+	blk = (const void *)((const uint8_t *)cap->map + off);
+	if (blk->len > CAPTURE_BLOCK || off + sizeof(*blk) + blk->len > cap->size)
+		return fail(EINVAL);
+
+	cap->pos  = (const uint8_t *)&blk[1];
+	cap->end  = cap->pos + blk->len;
+	cap->left = blk->num;
+	cap->time = blk->time;
+	cap->blk  = i + 1;
+
+	return 0;
+}
+
+/* Last block starting at or before wall-clock @time, or the first */
+uint32_t capture_find(const struct capture *cap, int64_t time)
+{
+	uint32_t lo = 0, hi = cap->num;
+
+	while (hi - lo > 1) {
+		uint32_t mid = lo + (hi - lo) / 2;
+
+		if (cap->idx[mid].time <= time)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/*
+ * Position at the element that is on air at wall-clock @time, using
+ * the index to find the block, or at the start of the file if earlier.
+ */
+int capture_seek(struct capture *cap, int64_t time)
+{
+	cap->blk  = 0;
+	cap->left = 0;
+	if (!cap->num)
+		return 0;
+
+	if (capture_block(cap, capture_find(cap, time)))
+		return -1;
+
+	while (cap->left) {
+		const uint8_t *pos = cap->pos;
+		int64_t start = cap->time;
+		int32_t val;
+
+		if (capture_next(cap, &val) < 0)
+			return -1;
+		if (cap->time > time) {
+			cap->pos  = pos;
+			cap->time = start;
+			cap->left++;
+			break;
+		}
+	}
+
+	return 0;
+}
+
+/* Next element, returns 1, or 0 at end of file, or -1 on a bad block */
+int capture_next(struct capture *cap, int32_t *val)
+{
+	uint32_t v = 0;
+	int shift = 0;
+
+	while (!cap->left) {
+		if (cap->blk >= cap->num)
+			return 0;
+		if (capture_block(cap, cap->blk))
+			return -1;
+	}
+
+	do {
+		if (cap->pos >= cap->end || shift > 28)
+			return fail(EINVAL);
+		v |= (uint32_t)(*cap->pos & 0x7f) << shift;
+		shift += 7;
+	} while (*cap->pos++ & 0x80);
+
+	*val = (v & 3) << 24 | ((v >> 2) & LIRC_VALUE_MASK);
+	cap->time += LIRC_VALUE(*val);
+	cap->left--;
+
+	return 1;
+}
+
+/*
+ * Read up to @max elements, @time is set to the wall-clock start of the
+ * first.  Returns number of elements, 0 at end of file, or -1 on error.
+ */
+int capture_read(struct capture *cap, int32_t *buf, int max, int64_t *time)
+{
+	int num = 0;
+	int rc;
+
+	while (num < max) {
+		rc = capture_next(cap, &buf[num]);
+		if (rc < 0)
+			return -1;
+		if (rc == 0)
+			break;
+		if (num == 0 && time)
+			*time = cap->time - LIRC_VALUE(buf[0]);
+		num++;
+	}
+
+	return num;
+}
+
+void capture_close(struct capture *cap)
+{
+	if (cap->map)
+		munmap(cap->map, cap->size);
+	free(cap->built);
+	memset(cap, 0, sizeof(*cap));
+}
@@ -0,0 +1,119 @@
+/* Control tool for NEXA and other RF remote receivers
+ *
+ * Copyright (C) 2010, 2012  Tord Andersson <tord.andersson@endian.se>
+ * Copyright (C) 2017        Joachim Nilsson <troglobit@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, visit the Free Software Foundation
+ * website at http://www.gnu.org/licenses/gpl-2.0.html or write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef RFCTL_CAPTURE_H_
+#define RFCTL_CAPTURE_H_
+
+#include "protocol.h"
+
+#define CAPTURE_MAGIC    "RFCR"
+#define CAPTURE_INDEX    "RFCI"
+#define CAPTURE_VERSION  1
+#define CAPTURE_BLOCK    4096	/* Max bytes of elements in a block */
+
+/*
+ * Capture file of received LIRC mode2 elements.  Written on the target,
+ * so all fields are in host byte order, like the frame store.  Layout:
+ *
+ *     struct capture_hdr
+ *     struct capture_blk, data[len], padded to 8 bytes    repeated
+ *     struct capture_idx[num]                             one per block
+ *     struct capture_tail
+ *
+ * Each element is one varint of its duration shifted up two bits, with
+ * the LIRC mode, space, pulse or timeout, in the low bits.  A file that
+ * lacks the index and tail, e.g. from a recorder that was killed, still
+ * opens, the index is rebuilt from the block headers.
+ */
+struct capture_hdr {
+	char     magic[4];
+	uint16_t version;
+	uint16_t hdr_size;	/* sizeof(struct capture_hdr) */
+	char     device[64];
+	uint8_t  iface;		/* rf_interface_t */
+	uint8_t  clock;		/* Of timestamps, CLOCK_REALTIME */
+	uint16_t reserved;
+	uint32_t glitch;	/* Shorter pulses were dropped, us, 0 none */
+	int64_t  start;		/* Wall-clock time of file, us */
+};
+
+struct capture_blk {
+	uint32_t len;		/* bytes of data */
+	uint32_t num;		/* elements */
+	int64_t  time;		/* Wall-clock start of first element, us */
+};
+
+struct capture_idx {
+	int64_t  time;
+	uint64_t offset;	/* of struct capture_blk */
+};
+
+struct capture_tail {
+	char     magic[4];
+	uint32_t num;
+	uint64_t offset;	/* of struct capture_idx[0] */
+};
+
+/* Buffered streaming writer */
+struct capture_out {
+	FILE               *fp;
+	uint64_t            offset;	/* of current block */
+	struct capture_blk  blk;
+	uint8_t             data[CAPTURE_BLOCK];
+	int64_t             time;	/* Start of next element */
+	struct capture_idx *idx;
+	uint32_t            num, max;
+};
+
+/* Memory mapped reader */
+struct capture {
+	void                     *map;
+	size_t                    size;
+	const struct capture_hdr *hdr;
+	const struct capture_idx *idx;
+	struct capture_idx       *built;	/* Index rebuilt at open */
+	uint32_t                  num;
+
+	uint32_t                  blk;		/* Next block to read */
+	const uint8_t            *pos, *end;	/* Data left in current block */
+	uint32_t                  left;		/* Elements in current block */
+	int64_t                   time;		/* Start of next element */
+};
+
+int     capture_create (struct capture_out *out, const char *path, const char *device,
+			rf_interface_t iface, int glitch);
+int     capture_write  (struct capture_out *out, const int32_t *buf, int len, int64_t end);
+int     capture_flush  (struct capture_out *out);
+int     capture_finish (struct capture_out *out);
+
+int     capture_open   (struct capture *cap, const char *path);
+uint32_t capture_find  (const struct capture *cap, int64_t time);
+int     capture_seek   (struct capture *cap, int64_t time);
+int     capture_block  (struct capture *cap, uint32_t i);
+int     capture_next   (struct capture *cap, int32_t *val);
+int     capture_read   (struct capture *cap, int32_t *buf, int max, int64_t *time);
+void    capture_close  (struct capture *cap);
+
+int64_t capture_now    (void);
+int     capture_time   (const char *str, int64_t *time);
+
+#endif /* RFCTL_CAPTURE_H_ */
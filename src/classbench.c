@@ -0,0 +1,118 @@
+/* Control tool for NEXA and other RF remote receivers
+ *
+ * Copyright (C) 2010, 2012  Tord Andersson <tord.andersson@endian.se>
+ * Copyright (C) 2017        Joachim Nilsson <troglobit@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, visit the Free Software Foundation
+ * website at http://www.gnu.org/licenses/gpl-2.0.html or write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Benchmark of rf_classify(), with whatever vector kernel the CPU has,
+ * against the scalar loop, run by 'make bench'.  Both classify the same
+ * buffer of random elements around the windows of all protocols, and
+ * must produce the same codes, also for lengths and offsets that leave
+ * a remainder for the scalar loop.
+ */
+#include <time.h>
+
+#include "common.h"
+#include "protocol.h"
+
+#define ELEMENTS (4 * 1024 * 1024)
+#define ROUNDS   10
+
+typedef void (*classify_fn)(const struct rf_windows *, const int32_t *, int, uint16_t *);
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Elements per second, best of ROUNDS to keep noise out */
+static double bench(classify_fn fn, const struct rf_windows *win, const int32_t *edges,
+		    int len, uint16_t *sym)
+{
+	double best = 0;
+	int i;
+
+	for (i = 0; i < ROUNDS; i++) {
+		double start = now(), rate;
+
+		fn(win, edges, len, sym);
+		rate = len / (now() - start);
+		if (rate > best)
+			best = rate;
+	}
+
+	return best;
+}
+
+int main(void)
+{
+	static const int32_t modes[] = { LIRC_MODE2_PULSE, LIRC_MODE2_SPACE, LIRC_MODE2_TIMEOUT };
+	struct rf_windows win;
+	uint16_t *vec, *ref;
+	int32_t *edges;
+	double v, s;
+	int i, len, rc = 0;
+
+	edges = malloc(ELEMENTS * sizeof(*edges));
+	vec   = malloc(ELEMENTS * sizeof(*vec));
+	ref   = malloc(ELEMENTS * sizeof(*ref));
+	if (!edges || !vec || !ref)
+		return 1;
+
+	/* Mostly up to 2x the longest sync, some far beyond */
+	srand(4711);
+	for (i = 0; i < ELEMENTS; i++) {
+		int32_t usec = rand() % 16 ? rand() % (4 * NEXA_L_SYNC_PERIOD) : rand() & LIRC_VALUE_MASK;
+
+		edges[i] = usec | modes[rand() % (rand() % 64 ? 2 : 3)];
+	}
+	rf_windows_init(&win);
+
+	for (len = 0; len < 64; len++) {
+		for (i = 0; i < 4; i++) {
+			rf_classify(&win, &edges[i], len, vec);
+			rf_classify_scalar(&win, &edges[i], len, ref);
+			if (memcmp(vec, ref, len * sizeof(*vec))) {
+				printf("classify: mismatch, length %d offset %d\n", len, i);
+				rc = 1;
+			}
+		}
+	}
+
+	v = bench(rf_classify, &win, edges, ELEMENTS, vec);
+	s = bench(rf_classify_scalar, &win, edges, ELEMENTS, ref);
+	if (memcmp(vec, ref, ELEMENTS * sizeof(*vec))) {
+		printf("classify: mismatch in %d elements\n", ELEMENTS);
+		rc = 1;
+	}
+
+	printf("classify: rf_classify() %.1f M/s, scalar %.1f M/s, %.1fx\n", v / 1e6, s / 1e6, v / s);
+	printf("%s\n", rc ? "FAIL" : "PASS");
+
+	free(edges);
+	free(vec);
+	free(ref);
+
+	return rc;
+}
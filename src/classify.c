@@ -0,0 +1,214 @@
+/* Control tool for NEXA and other RF remote receivers
+ *
+ * Copyright (C) 2010, 2012  Tord Andersson <tord.andersson@endian.se>
+ * Copyright (C) 2017        Joachim Nilsson <troglobit@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, visit the Free Software Foundation
+ * website at http://www.gnu.org/licenses/gpl-2.0.html or write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "common.h"
+#include "protocol.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+/* Window bounds are exclusive at hi */
+static void window(struct rf_windows *win, int class, int sym, int lo, int hi)
+{
+	win->lo[class * 3 + sym] = lo;
+	win->hi[class * 3 + sym] = hi;
+}
+
+/* Same tolerances for all fixed-code protocols */
+static void windows(struct rf_windows *win, int class, int s, int l, int sync)
+{
+	window(win, class, RF_SYM_SHORT, s / 2,    (s + l) / 2);
+	window(win, class, RF_SYM_LONG,  (s + l) / 2, 2 * l);
+	window(win, class, RF_SYM_SYNC,  sync / 2, 2 * sync + 1);
+}
+
+/* Nominal windows of all protocols */
+void rf_windows_init(struct rf_windows *win)
+{
+	memset(win, 0, sizeof(*win));
+
+	windows(win, RF_CLASS_NEXA,    NEXA_SHORT_PERIOD,    NEXA_LONG_PERIOD,    NEXA_SYNC_PERIOD);
+	windows(win, RF_CLASS_SARTANO, SARTANO_SHORT_PERIOD, SARTANO_LONG_PERIOD, SARTANO_SYNC_PERIOD);
+	windows(win, RF_CLASS_IKEA,    IKEA_SHORT_PERIOD,    IKEA_LONG_PERIOD,    IKEA_SYNC_PERIOD);
+
+	/* Self-learning spaces are 1T or 5T, with a 10T sync */
+	window(win, RF_CLASS_NEXA_L, RF_SYM_SHORT, 0, 3 * NEXA_L_PERIOD);
+	window(win, RF_CLASS_NEXA_L, RF_SYM_LONG, 3 * NEXA_L_PERIOD,
+	       (NEXA_L_LONG_PERIOD + NEXA_L_SYNC_PERIOD) / 2);
+	window(win, RF_CLASS_NEXA_L, RF_SYM_SYNC, (NEXA_L_LONG_PERIOD + NEXA_L_SYNC_PERIOD) / 2,
+	       2 * NEXA_L_SYNC_PERIOD + 1);
+}
+
+/* One element at a time, the reference the vector kernels must match */
+void rf_classify_scalar(const struct rf_windows *win, const int32_t *edges, int len, uint16_t *sym)
+{
+	int i, w;
+
+	for (i = 0; i < len; i++) {
+		int32_t usec = LIRC_VALUE(edges[i]);
+		uint16_t code = 0;
+
+		for (w = 0; w < RF_WINDOWS; w++) {
+			if (usec >= win->lo[w] && usec < win->hi[w])
+				code |= 1 << w;
+		}
+		if (LIRC_IS_PULSE(edges[i]))
+			code |= RF_SYM_PULSE;
+		else if (LIRC_IS_SPACE(edges[i]))
+			code |= RF_SYM_SPACE;
+
+		sym[i] = code;
+	}
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#ifdef __SSE2__
+/* Four elements at a time, signed compares are fine for 24-bit values */
+static int classify_sse2(const struct rf_windows *win, const int32_t *edges, int len, uint16_t *sym)
+{
+	const __m128i mask  = _mm_set1_epi32(LIRC_VALUE_MASK);
+	const __m128i pulse = _mm_set1_epi32(LIRC_MODE2_PULSE);
+	const __m128i space = _mm_set1_epi32(LIRC_MODE2_SPACE);
+	const __m128i mode  = _mm_set1_epi32(LIRC_MODE2_MASK);
+	int i, w;
+
+	for (i = 0; i + 4 <= len; i += 4) {
+		__m128i v   = _mm_loadu_si128((const __m128i *)&edges[i]);
+		__m128i val = _mm_and_si128(v, mask);
+		__m128i m2  = _mm_and_si128(v, mode);
+		__m128i acc;
+
+		acc = _mm_and_si128(_mm_cmpeq_epi32(m2, pulse), _mm_set1_epi32(RF_SYM_PULSE));
+		acc = _mm_or_si128(acc, _mm_and_si128(_mm_cmpeq_epi32(m2, space), _mm_set1_epi32(RF_SYM_SPACE)));
+
+		for (w = 0; w < RF_WINDOWS; w++) {
+			__m128i below = _mm_cmpgt_epi32(_mm_set1_epi32(win->lo[w]), val);
+			__m128i under = _mm_cmpgt_epi32(_mm_set1_epi32(win->hi[w]), val);
+			__m128i in    = _mm_andnot_si128(below, under);
+
+			acc = _mm_or_si128(acc, _mm_and_si128(in, _mm_set1_epi32(1 << w)));
+		}
+
+		/* Codes fit in 15 bits, so signed saturation is a plain narrow */
+		_mm_storel_epi64((__m128i *)&sym[i], _mm_packs_epi32(acc, acc));
+	}
+
+	return i;
+}
+#endif
+
+/* Eight elements at a time, when the CPU has it */
+__attribute__((target("avx2")))
+static int classify_avx2(const struct rf_windows *win, const int32_t *edges, int len, uint16_t *sym)
+{
+	const __m256i mask  = _mm256_set1_epi32(LIRC_VALUE_MASK);
+	const __m256i pulse = _mm256_set1_epi32(LIRC_MODE2_PULSE);
+	const __m256i space = _mm256_set1_epi32(LIRC_MODE2_SPACE);
+	const __m256i mode  = _mm256_set1_epi32(LIRC_MODE2_MASK);
+	int i, w;
+
+	for (i = 0; i + 8 <= len; i += 8) {
+		__m256i v   = _mm256_loadu_si256((const __m256i *)&edges[i]);
+		__m256i val = _mm256_and_si256(v, mask);
+		__m256i m2  = _mm256_and_si256(v, mode);
+		__m256i acc;
+
+		acc = _mm256_and_si256(_mm256_cmpeq_epi32(m2, pulse), _mm256_set1_epi32(RF_SYM_PULSE));
+		acc = _mm256_or_si256(acc, _mm256_and_si256(_mm256_cmpeq_epi32(m2, space),
+							    _mm256_set1_epi32(RF_SYM_SPACE)));
+
+		for (w = 0; w < RF_WINDOWS; w++) {
+			__m256i below = _mm256_cmpgt_epi32(_mm256_set1_epi32(win->lo[w]), val);
+			__m256i under = _mm256_cmpgt_epi32(_mm256_set1_epi32(win->hi[w]), val);
+			__m256i in    = _mm256_andnot_si256(below, under);
+
+			acc = _mm256_or_si256(acc, _mm256_and_si256(in, _mm256_set1_epi32(1 << w)));
+		}
+
+		_mm_storeu_si128((__m128i *)&sym[i],
+				 _mm_packs_epi32(_mm256_castsi256_si128(acc),
+						 _mm256_extracti128_si256(acc, 1)));
+	}
+
+	return i;
+}
+#elif defined(__ARM_NEON)
+static int classify_neon(const struct rf_windows *win, const int32_t *edges, int len, uint16_t *sym)
+{
+	const uint32x4_t mask  = vdupq_n_u32(LIRC_VALUE_MASK);
+	const uint32x4_t mode  = vdupq_n_u32(LIRC_MODE2_MASK);
+	const uint32x4_t pulse = vdupq_n_u32(LIRC_MODE2_PULSE);
+	const uint32x4_t space = vdupq_n_u32(LIRC_MODE2_SPACE);
+	int i, w;
+
+	for (i = 0; i + 4 <= len; i += 4) {
+		uint32x4_t v   = vld1q_u32((const uint32_t *)&edges[i]);
+		uint32x4_t val = vandq_u32(v, mask);
+		uint32x4_t m2  = vandq_u32(v, mode);
+		uint32x4_t acc;
+
+		acc = vandq_u32(vceqq_u32(m2, pulse), vdupq_n_u32(RF_SYM_PULSE));
+		acc = vorrq_u32(acc, vandq_u32(vceqq_u32(m2, space), vdupq_n_u32(RF_SYM_SPACE)));
+
+		for (w = 0; w < RF_WINDOWS; w++) {
+			uint32x4_t in = vandq_u32(vcgeq_u32(val, vdupq_n_u32(win->lo[w])),
+						  vcltq_u32(val, vdupq_n_u32(win->hi[w])));
+
+			acc = vorrq_u32(acc, vandq_u32(in, vdupq_n_u32(1 << w)));
+		}
+
+		vst1_u16(&sym[i], vmovn_u32(acc));
+	}
+
+	return i;
+}
+#endif
+
+/*
+ * Classify @len elements against the windows of all protocols at once,
+ * storing one code per element in @sym, see RF_SYM().  Uses AVX2, SSE2,
+ * or NEON when available, the remainder is done one at a time.
+ */
+void rf_classify(const struct rf_windows *win, const int32_t *edges, int len, uint16_t *sym)
+{
+	int i = 0;
+
+#if defined(__x86_64__) || defined(__i386__)
+	static int avx2 = -1;
+
+	if (avx2 < 0)
+		avx2 = __builtin_cpu_supports("avx2");
+	if (avx2)
+		i = classify_avx2(win, edges, len, sym);
+#ifdef __SSE2__
+	else
+		i = classify_sse2(win, edges, len, sym);
+#endif
+#elif defined(__ARM_NEON)
+	i = classify_neon(win, edges, len, sym);
+#endif
+
+	rf_classify_scalar(win, &edges[i], len - i, &sym[i]);
+}
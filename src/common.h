@@ -30,6 +30,10 @@
 #include <string.h>
 #include <unistd.h>
 
+#ifndef NELEMS
+#define NELEMS(v) (sizeof(v) / sizeof(v[0]))
+#endif
+
 #define PRINT(fmt, args...) if (verbose) printf(fmt, ##args)
 
 extern bool verbose;
@@ -24,7 +24,7 @@
 #include "protocol.h"
 
 /* Convert generic bitstream format to CUL433 format */
-int bitstream2cul443(int32_t *bitstream, int len, int repeat, char *cul)
+int bitstream2cul443(const int32_t *bitstream, int len, int repeat, char *cul)
 {
 	int i;
 	int pulses = 0;
@@ -61,3 +61,104 @@ int bitstream2cul443(int32_t *bitstream, int len, int repeat, char *cul)
 
 	return 0;
 }
+
+static int hexval(int c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+
+	return -1;
+}
+
+/*
+ * Convert one complete line of CUL433 receive output to LIRC mode2
+ * elements.  In raw receive mode the stick reports pulse/space lengths
+ * as 16-bit hex words, optionally prefixed with 'r', where bit 15 set
+ * means pulse and the lower 15 bits are the length in microseconds,
+ * 0x7FFF marks a timeout.  Anything else, e.g. the version banner or
+ * the echo of our X01 command, is not edge data and is skipped.
+ */
+static int cul443_line(const char *line, size_t len, int32_t *edges, int max)
+{
+	size_t i = 0;
+	int num = 0;
+
+	if (len > 0 && (line[0] == 'r' || line[0] == 'R'))
+		i++;
+
+	if (len == i || (len - i) % 4)
+		return 0;
+
+	for (; i < len && num < max; i += 4) {
+		int32_t val = 0;
+		int j;
+
+		for (j = 0; j < 4; j++) {
+			int nibble = hexval(line[i + j]);
+
+			if (nibble < 0)
+				return num;
+			val = (val << 4) | nibble;
+		}
+
+		if ((val & 0x7FFF) == 0x7FFF)
+			edges[num++] = LIRC_TIMEOUT(val & 0x7FFF);
+		else if (val & 0x8000)
+			edges[num++] = LIRC_PULSE(val & 0x7FFF);
+		else
+			edges[num++] = LIRC_SPACE(val & 0x7FFF);
+	}
+
+	return num;
+}
+
+void cul443_rx_init(struct cul_rx *rx)
+{
+	rx->len = 0;
+	rx->overflow = false;
+}
+
+/*
+ * Incremental parser for the ASCII receive output of a CUL433 stick.
+ * Feed it whatever read() returned, partial lines are kept in @rx
+ * until the line terminator arrives.  Parsed elements are stored in
+ * @edges, at most @max, and the number of input bytes consumed is
+ * returned in @used.  Call again with the remaining bytes if @used is
+ * less than @len, i.e., when @edges was filled up.
+ */
+int cul443_rx_parse(struct cul_rx *rx, const char *buf, size_t len,
+		    int32_t *edges, int max, size_t *used)
+{
+	size_t i;
+	int num = 0;
+
+	for (i = 0; i < len; i++) {
+		char c = buf[i];
+
+		if (c != '\r' && c != '\n') {
+			if (rx->len < sizeof(rx->line))
+				rx->line[rx->len++] = c;
+			else
+				rx->overflow = true;
+			continue;
+		}
+
+		/* Complete line, make sure it fits before consuming it */
+		if (rx->len > 0 && !rx->overflow) {
+			if (num > 0 && max - num < (int)(rx->len / 4))
+				break;
+			num += cul443_line(rx->line, rx->len, &edges[num], max - num);
+		}
+
+		rx->len = 0;
+		rx->overflow = false;
+	}
+
+	*used = i;
+
+	return num;
+}
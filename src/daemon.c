@@ -0,0 +1,188 @@
+/* Control tool for NEXA and other RF remote receivers
+ *
+ * Copyright (C) 2010, 2012  Tord Andersson <tord.andersson@endian.se>
+ * Copyright (C) 2017        Joachim Nilsson <troglobit@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, visit the Free Software Foundation
+ * website at http://www.gnu.org/licenses/gpl-2.0.html or write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "common.h"
+#include "router.h"
+#include "scene.h"
+
+#define DAEMON_MAX_CLIENTS 16
+
+struct client {
+	int    sd;
+	char   buf[256];
+	size_t len;
+};
+
+static int sock_open(const char *path)
+{
+	struct sockaddr_un sun;
+	int sd;
+
+	sd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (sd < 0)
+		return -1;
+
+	memset(&sun, 0, sizeof(sun));
+	sun.sun_family = AF_UNIX;
+	strncpy(sun.sun_path, path, sizeof(sun.sun_path) - 1);
+
+	unlink(path);
+	if (bind(sd, (struct sockaddr *)&sun, sizeof(sun)) || listen(sd, 5)) {
+		close(sd);
+		return -1;
+	}
+
+	return sd;
+}
+
+static void reply(struct client *c, int rc)
+{
+	char msg[80];
+
+	if (rc)
+		snprintf(msg, sizeof(msg), "ERR %s\n", strerror(errno));
+	else
+		snprintf(msg, sizeof(msg), "OK\n");
+
+	if (write(c->sd, msg, strlen(msg)) < 0)
+		PRINT("Failed replying to client: %s\n", strerror(errno));
+}
+
+/* Run each complete line received from client as a command */
+static int client_read(struct router *r, struct client *c)
+{
+	ssize_t len;
+	char *nl;
+
+	len = read(c->sd, &c->buf[c->len], sizeof(c->buf) - c->len - 1);
+	if (len <= 0)
+		return -1;
+
+	c->len += len;
+	c->buf[c->len] = 0;
+
+	while ((nl = strchr(c->buf, '\n'))) {
+		*nl++ = 0;
+		if (!strncmp(c->buf, "stats", 5)) {
+			char msg[1024];
+
+			router_stats(r, msg, sizeof(msg));
+			if (write(c->sd, msg, strlen(msg)) < 0)
+				PRINT("Failed replying to client: %s\n", strerror(errno));
+		} else {
+			reply(c, router_cmd(r, c->buf));
+		}
+
+		c->len -= nl - c->buf;
+		memmove(c->buf, nl, c->len + 1);
+	}
+
+	/* Line too long, drop it */
+	if (c->len == sizeof(c->buf) - 1) {
+		errno = EMSGSIZE;
+		reply(c, -1);
+		c->len = 0;
+	}
+
+	return 0;
+}
+
+/*
+ * Serve commands from clients on a UNIX socket until *running is
+ * cleared.  Each line is one command, same format as for the -f
+ * option, and is answered with "OK" or "ERR reason" once queued.
+ * The "stats" command replies with a line of statistics.  Scenes in
+ * the router's schedule are sent on the second they are due.
+ */
+int daemon_run(struct router *r, const char *path, atomic_bool *running)
+{
+	struct client client[DAEMON_MAX_CLIENTS];
+	struct pollfd pfd[DAEMON_MAX_CLIENTS + 1];
+	int num = 0;
+	int sd, i;
+
+	sd = sock_open(path);
+	if (sd < 0)
+		return -1;
+
+	PRINT("Listening for commands on %s\n", path);
+	while (*running) {
+		int timeout = r->cache ? 100 : 1000;
+
+		if (r->schedule) {
+			schedule_run(r->schedule, r);
+			timeout = schedule_timeout(r->schedule, timeout);
+		}
+
+		pfd[0].fd = sd;
+		pfd[0].events = POLLIN;
+		for (i = 0; i < num; i++) {
+			pfd[i + 1].fd = client[i].sd;
+			pfd[i + 1].events = POLLIN;
+		}
+
+		/* Short timeout to fill idle airtime with re-asserts */
+		if (poll(pfd, num + 1, timeout) <= 0) {
+			router_idle(r);
+			continue;
+		}
+
+		for (i = num - 1; i >= 0; i--) {
+			if (!pfd[i + 1].revents)
+				continue;
+
+			if (client_read(r, &client[i])) {
+				close(client[i].sd);
+				client[i] = client[--num];
+			}
+		}
+
+		if (pfd[0].revents & POLLIN) {
+			int cd;
+
+			cd = accept(sd, NULL, NULL);
+			if (cd < 0)
+				continue;
+
+			if (num == DAEMON_MAX_CLIENTS) {
+				close(cd);
+				continue;
+			}
+
+			client[num].sd = cd;
+			client[num].len = 0;
+			num++;
+		}
+	}
+
+	for (i = 0; i < num; i++)
+		close(client[i].sd);
+	close(sd);
+	unlink(path);
+
+	return 0;
+}
@@ -0,0 +1,77 @@
+/* Control tool for NEXA and other RF remote receivers
+ *
+ * Copyright (C) 2010, 2012  Tord Andersson <tord.andersson@endian.se>
+ * Copyright (C) 2017        Joachim Nilsson <troglobit@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, visit the Free Software Foundation
+ * website at http://www.gnu.org/licenses/gpl-2.0.html or write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "common.h"
+#include "protocol.h"
+
+/*
+ * Find and decode the first frame in a stream of received pulses and
+ * spaces, with their rf_classify() codes in @sym.  Returns number of
+ * elements up to and including the frame, or 0 if there is no complete
+ * frame in @edges.
+ */
+int rf_decode_sym(const int32_t *edges, const uint16_t *sym, int len, struct rfctl_cmd *cmd)
+{
+	int i, num;
+
+	for (i = 0; i + 1 < len; i++) {
+		if (!(sym[i] & RF_SYM_PULSE) || !(sym[i + 1] & RF_SYM_SPACE))
+			continue;
+
+		num = nexa_l_decode(&edges[i], &sym[i], len - i, cmd);
+		if (num > 0)
+			return i + num;
+	}
+
+	return 0;
+}
+
+/* Protocols rf_decode_sym() can find, only these are ever received */
+bool rf_decodable(rf_protocol_t protocol)
+{
+	return protocol == PROT_NEXA_L;
+}
+
+/* Same as rf_decode_sym(), classifying @edges with nominal windows */
+int rf_decode(const int32_t *edges, int len, struct rfctl_cmd *cmd)
+{
+	uint16_t buf[RF_MAX_RX_BITS];
+	uint16_t *sym = buf;
+	struct rf_windows win;
+	int num;
+
+	rf_windows_init(&win);
+
+	if (len > (int)NELEMS(buf)) {
+		sym = malloc(len * sizeof(*sym));
+		if (!sym)
+			return 0;
+	}
+
+	rf_classify(&win, edges, len, sym);
+	num = rf_decode_sym(edges, sym, len, cmd);
+
+	if (sym != buf)
+		free(sym);
+
+	return num;
+}
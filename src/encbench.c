@@ -0,0 +1,153 @@
+/* Control tool for NEXA and other RF remote receivers
+ *
+ * Copyright (C) 2010, 2012  Tord Andersson <tord.andersson@endian.se>
+ * Copyright (C) 2017        Joachim Nilsson <troglobit@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, visit the Free Software Foundation
+ * website at http://www.gnu.org/licenses/gpl-2.0.html or write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Benchmark of rfctl_encode_batch() against the string encoders, run
+ * by 'make bench'.  A scene of NEXA, SARTANO and NEXA_L commands is
+ * encoded into one contiguous buffer, once from parsed commands and
+ * once per command from strings, the way rfctl did before.  Both must
+ * give the same elements.
+ */
+#include <time.h>
+
+#include "common.h"
+#include "protocol.h"
+#include "librfctl.h"
+
+#define SCENE   48		/* Commands in one scene */
+#define ROUNDS  20000
+
+struct scene {
+	struct rfctl_cmd cmd[SCENE];
+	const char      *proto[SCENE];
+	char             group[SCENE][16];
+	char             channel[SCENE][16];
+	char             level[SCENE][4];
+};
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void scene_init(struct scene *sc)
+{
+	int i, j;
+
+	for (i = 0; i < SCENE; i++) {
+		struct rfctl_cmd *c = &sc->cmd[i];
+
+		c->level = i & 1;
+		snprintf(sc->level[i], sizeof(sc->level[i]), "%d", c->level);
+
+		switch (i % 3) {
+		case 0:
+			c->protocol = RFCTL_PROTO_NEXA;
+			c->address  = i % 16;
+			c->unit     = i % 16 + 1;
+			sc->proto[i] = "NEXA";
+			snprintf(sc->group[i], sizeof(sc->group[i]), "%c", 'A' + c->address);
+			snprintf(sc->channel[i], sizeof(sc->channel[i]), "%d", c->unit);
+			break;
+
+		case 1:
+			c->protocol = RFCTL_PROTO_SARTANO;
+			c->address  = (i * 37) & 0x3ff;
+			sc->proto[i] = "SARTANO";
+			strcpy(sc->group[i], "-");
+			for (j = 0; j < 10; j++)
+				sc->channel[i][j] = c->address & (1 << (9 - j)) ? '1' : '0';
+			sc->channel[i][j] = 0;
+			break;
+
+		default:
+			c->protocol = RFCTL_PROTO_NEXA_L;
+			c->address  = 4711 + i;
+			c->unit     = i % 16 + 1;
+			sc->proto[i] = "NEXA_L";
+			snprintf(sc->group[i], sizeof(sc->group[i]), "%u", c->address);
+			snprintf(sc->channel[i], sizeof(sc->channel[i]), "%d", c->unit);
+			break;
+		}
+	}
+}
+
+/* One command at a time from strings, repeats copied after each other */
+static int encode_strings(const struct scene *sc, int32_t *buf, size_t len)
+{
+	size_t pos = 0;
+	int i, j;
+
+	for (i = 0; i < SCENE; i++) {
+		int32_t frame[RF_MAX_TX_BITS];
+		int flen, repeat;
+
+		flen = rfctl_encode(sc->proto[i], sc->group[i], sc->channel[i], sc->level[i],
+				    frame, NELEMS(frame), &repeat);
+		if (flen <= 0 || pos + (size_t)flen * repeat > len)
+			return -1;
+
+		for (j = 0; j < repeat; j++) {
+			memcpy(&buf[pos], frame, flen * sizeof(int32_t));
+			pos += flen;
+		}
+	}
+
+	return pos;
+}
+
+int main(void)
+{
+	static int32_t batch[SCENE * RF_MAX_FRAME_BITS * 8], strings[NELEMS(batch)];
+	struct scene sc;
+	double start, b, s;
+	int i, len, rc = 0;
+
+	scene_init(&sc);
+
+	start = now();
+	for (i = 0; i < ROUNDS; i++)
+		len = rfctl_encode_batch(sc.cmd, SCENE, batch, NELEMS(batch));
+	b = ROUNDS * SCENE / (now() - start);
+
+	start = now();
+	for (i = 0; i < ROUNDS; i++)
+		rc = encode_strings(&sc, strings, NELEMS(strings));
+	s = ROUNDS * SCENE / (now() - start);
+
+	if (len <= 0 || rc != len || memcmp(batch, strings, len * sizeof(int32_t))) {
+		printf("encode: batch and string encoders differ, %d and %d elements\n", len, rc);
+		rc = 1;
+	} else {
+		rc = 0;
+	}
+
+	printf("encode: batch %.2f M commands/s, strings %.2f M commands/s, %.1fx\n",
+	       b / 1e6, s / 1e6, b / s);
+	printf("%s\n", rc ? "FAIL" : "PASS");
+
+	return rc;
+}
@@ -0,0 +1,233 @@
+/* Control tool for NEXA and other RF remote receivers
+ *
+ * Copyright (C) 2010, 2012  Tord Andersson <tord.andersson@endian.se>
+ * Copyright (C) 2017        Joachim Nilsson <troglobit@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, visit the Free Software Foundation
+ * website at http://www.gnu.org/licenses/gpl-2.0.html or write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "common.h"
+#include "protocol.h"
+
+rf_protocol_t rf_protocol(const char *name)
+{
+	if (strcmp("NEXA", name) == 0)
+		return PROT_NEXA;
+	if (strcmp("PROOVE", name) == 0)
+		return PROT_NEXA;
+	if (strcmp("WAVEMAN", name) == 0)
+		return PROT_WAVEMAN;
+	if (strcmp("SARTANO", name) == 0)
+		return PROT_SARTANO;
+	if (strcmp("ELRO", name) == 0)
+		return PROT_SARTANO;
+	if (strcmp("IMPULS", name) == 0)
+		return PROT_IMPULS;
+	if (strcmp("NEXA_L", name) == 0)
+		return PROT_NEXA_L;
+	if (strcmp("IKEA", name) == 0)
+		return PROT_IKEA;
+	if (strcmp("CONRAD", name) == 0)
+		return PROT_CONRAD;
+	if (strcmp("RAW", name) == 0)
+		return PROT_RAW;
+
+	return PROT_UNKNOWN;
+}
+
+const char *rf_protocol_name(rf_protocol_t protocol)
+{
+	switch (protocol) {
+	case PROT_RAW:
+		return "RAW";
+	case PROT_NEXA:
+		return "NEXA";
+	case PROT_PROOVE:
+		return "PROOVE";
+	case PROT_WAVEMAN:
+		return "WAVEMAN";
+	case PROT_SARTANO:
+		return "SARTANO";
+	case PROT_IMPULS:
+		return "IMPULS";
+	case PROT_NEXA_L:
+		return "NEXA_L";
+	case PROT_IKEA:
+		return "IKEA";
+	case PROT_CONRAD:
+		return "CONRAD";
+	default:
+		return "UNKNOWN";
+	}
+}
+
+rf_interface_t rf_interface(const char *name)
+{
+	if (strcmp("RFCTL", name) == 0)
+		return IFC_RFCTL;
+	if (strcmp("CUL", name) == 0)
+		return IFC_CUL;
+	if (strcmp("TELLSTICK", name) == 0)
+		return IFC_TELLSTICK;
+
+	return IFC_UNKNOWN;
+}
+
+/*
+ * Build generic transmit bitstream for the selected protocol.
+ * Returns number of elements in bitstream, 0 on invalid arguments, or
+ * -1 if the protocol is not supported.
+ */
+int rf_encode(rf_protocol_t protocol, const char *group, const char *channel, const char *level,
+	      int32_t *bitstream, int *repeat)
+{
+	switch (protocol) {
+	case PROT_NEXA:
+		return nexa_bitstream(group, channel, level, bitstream, repeat);
+
+	case PROT_WAVEMAN:
+		return waveman_bitstream(group, channel, level, bitstream, repeat);
+
+	case PROT_NEXA_L:
+		return nexa_l_bitstream(group, channel, level, bitstream, repeat);
+
+	case PROT_SARTANO:
+		return sartano_bitstream(channel, level, bitstream, repeat);
+
+	case PROT_CONRAD:
+		return conrad_bitstream(group, channel, level, bitstream, repeat);
+
+	case PROT_IMPULS:
+		return impulse_bitstream(channel, level, bitstream, repeat);
+
+	case PROT_IKEA:
+		return ikea_bitstream(group, channel, level, "1", bitstream, repeat);
+
+	default:
+		break;
+	}
+
+	return -1;
+}
+
+/*
+ * Convert string arguments to the binary address and unit used by
+ * rf_frame(), see struct rfctl_cmd.  Returns -1 on invalid arguments.
+ */
+int rf_address(rf_protocol_t protocol, const char *group, const char *channel,
+	       uint32_t *address, int *unit)
+{
+	unsigned long id;
+	char *end;
+	int code;
+
+	*unit = 0;
+	switch (protocol) {
+	case PROT_NEXA:
+	case PROT_WAVEMAN:
+		if (!group || *group < 'A' || *group > 'P')
+			return -1;
+		*address = *group - 'A';
+		*unit = atoi(channel);
+		break;
+
+	case PROT_NEXA_L:
+		if (!group)
+			return -1;
+		id = strtoul(group, &end, 0);
+		if (end == group || *end || id > NEXA_L_MAX_ID)
+			return -1;
+		*address = id;
+		if (strcmp(channel, "all")) {
+			*unit = atoi(channel);
+			if (*unit < 1 || *unit > 16)
+				return -1;
+		}
+		break;
+
+	case PROT_SARTANO:
+	case PROT_IMPULS:
+		code = sartano_code(channel);
+		if (code < 0)
+			return -1;
+		*address = code;
+		break;
+
+	case PROT_CONRAD:
+	case PROT_IKEA:
+		if (!group)
+			return -1;
+		*address = atoi(group);
+		*unit = atoi(channel);
+		break;
+
+	default:
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Build one frame from already parsed arguments, see struct rfctl_cmd
+ * for the meaning of address and unit.  Same return values as above.
+ */
+int rf_frame(rf_protocol_t protocol, uint32_t address, int unit, int level,
+	     int32_t *bitstream, int *repeat)
+{
+	switch (protocol) {
+	case PROT_NEXA:
+	case PROT_WAVEMAN:
+		*repeat = NEXA_REPEAT;
+		if (address > 15)
+			return 0;
+		return nexa_frame(address, unit - 1, level, protocol == PROT_WAVEMAN, bitstream);
+
+	case PROT_NEXA_L:
+		*repeat = NEXA_L_REPEAT;
+		if (unit < 0 || unit > 16)
+			return 0;
+		return nexa_l_frame(address, unit == 0, unit ? unit - 1 : 0, level, bitstream);
+
+	case PROT_SARTANO:
+		*repeat = SARTANO_REPEAT;
+		if (address > 0x3FF)
+			return 0;
+		return sartano_frame(address, level, bitstream);
+
+	case PROT_CONRAD:
+		*repeat = SARTANO_REPEAT;
+		if (address > 4)
+			return 0;
+		return sartano_frame(conrad_code(address, unit), level, bitstream);
+
+	case PROT_IMPULS:
+		*repeat = SARTANO_REPEAT;
+		if (address > 0x3FF)
+			return 0;
+		return impulse_frame(address, level, bitstream);
+
+	case PROT_IKEA:
+		*repeat = IKEA_REPEAT;
+		return ikea_frame(address, unit, level, true, bitstream);
+
+	default:
+		break;
+	}
+
+	return -1;
+}
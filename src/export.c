@@ -0,0 +1,380 @@
+/* Control tool for NEXA and other RF remote receivers
+ *
+ * Copyright (C) 2010, 2012  Tord Andersson <tord.andersson@endian.se>
+ * Copyright (C) 2017        Joachim Nilsson <troglobit@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, visit the Free Software Foundation
+ * website at http://www.gnu.org/licenses/gpl-2.0.html or write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <errno.h>
+#include <time.h>
+
+#include "common.h"
+#include "export.h"
+
+#define ZIP_LOCAL   0x04034b50
+#define ZIP_CENTRAL 0x02014b50
+#define ZIP_END     0x06054b50
+
+static uint32_t crc_table[256];
+
+static void crc_init(void)
+{
+	uint32_t c;
+	int i, j;
+
+	for (i = 0; i < 256; i++) {
+		c = i;
+		for (j = 0; j < 8; j++)
+			c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+		crc_table[i] = c;
+	}
+}
+
+static uint32_t crc32(uint32_t crc, const uint8_t *buf, size_t len)
+{
+	crc = ~crc;
+	while (len--)
+		crc = crc_table[(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+
+	return ~crc;
+}
+
+/* Zip fields are little endian, regardless of host */
+static uint8_t *put16(uint8_t *p, uint16_t v)
+{
+	*p++ = v;
+	*p++ = v >> 8;
+
+	return p;
+}
+
+static uint8_t *put32(uint8_t *p, uint32_t v)
+{
+	p = put16(p, v);
+
+	return put16(p, v >> 16);
+}
+
+static void dos_time(uint16_t *date, uint16_t *tod)
+{
+	time_t now = time(NULL);
+	struct tm *tm = localtime(&now);
+
+	*date = (tm->tm_year - 80) << 9 | (tm->tm_mon + 1) << 5 | tm->tm_mday;
+	*tod  = tm->tm_hour << 11 | tm->tm_min << 5 | tm->tm_sec / 2;
+}
+
+/*
+ * Start a stored session member, its CRC and size are filled in by
+ * member_end(), so the file must be seekable.
+ */
+static int member_start(struct export *ex, const char *name)
+{
+	struct export_file *f;
+	uint8_t hdr[30], *p = hdr;
+	uint16_t date, tod;
+	off_t off;
+
+	off = ftello(ex->fp);
+	if (off < 0)
+		return -1;
+	if (off > UINT32_MAX) {
+		errno = EFBIG;
+		return -1;
+	}
+
+	f = realloc(ex->file, (ex->num + 1) * sizeof(*f));
+	if (!f)
+		return -1;
+	ex->file = f;
+	f = &ex->file[ex->num++];
+	memset(f, 0, sizeof(*f));
+	snprintf(f->name, sizeof(f->name), "%s", name);
+	f->offset = off;
+
+	dos_time(&date, &tod);
+	p = put32(p, ZIP_LOCAL);
+	p = put16(p, 10);		/* Version needed, 1.0 */
+	p = put16(p, 0);		/* Flags */
+	p = put16(p, 0);		/* Stored */
+	p = put16(p, tod);
+	p = put16(p, date);
+	p = put32(p, 0);		/* CRC, sizes, see member_end() */
+	p = put32(p, 0);
+	p = put32(p, 0);
+	p = put16(p, strlen(f->name));
+	p = put16(p, 0);
+
+	if (fwrite(hdr, sizeof(hdr), 1, ex->fp) != 1 ||
+	    fwrite(f->name, strlen(f->name), 1, ex->fp) != 1)
+		return -1;
+
+	return 0;
+}
+
+static int member_data(struct export *ex, const void *buf, size_t len)
+{
+	struct export_file *f = &ex->file[ex->num - 1];
+
+	if (f->size + (uint64_t)len > UINT32_MAX) {
+		errno = EFBIG;
+		return -1;
+	}
+	if (fwrite(buf, len, 1, ex->fp) != 1)
+		return -1;
+
+	f->crc   = crc32(f->crc, buf, len);
+	f->size += len;
+
+	return 0;
+}
+
+static int member_end(struct export *ex)
+{
+	struct export_file *f = &ex->file[ex->num - 1];
+	uint8_t buf[12], *p = buf;
+
+	p = put32(p, f->crc);
+	p = put32(p, f->size);
+	p = put32(p, f->size);
+
+	if (fseeko(ex->fp, f->offset + 14, SEEK_SET) ||
+	    fwrite(buf, sizeof(buf), 1, ex->fp) != 1 ||
+	    fseeko(ex->fp, 0, SEEK_END))
+		return -1;
+
+	return 0;
+}
+
+/* Central directory of all members, ends the zip archive */
+static int central(struct export *ex)
+{
+	uint8_t hdr[46], *p;
+	uint16_t date, tod;
+	uint32_t size = 0;
+	off_t off;
+	int i;
+
+	off = ftello(ex->fp);
+	if (off < 0)
+		return -1;
+	if (off > UINT32_MAX) {
+		errno = EFBIG;
+		return -1;
+	}
+
+	dos_time(&date, &tod);
+	for (i = 0; i < ex->num; i++) {
+		struct export_file *f = &ex->file[i];
+
+		p = put32(hdr, ZIP_CENTRAL);
+		p = put16(p, 20);		/* Made by, 2.0 */
+		p = put16(p, 10);		/* Version needed, 1.0 */
+		p = put16(p, 0);
+		p = put16(p, 0);
+		p = put16(p, tod);
+		p = put16(p, date);
+		p = put32(p, f->crc);
+		p = put32(p, f->size);
+		p = put32(p, f->size);
+		p = put16(p, strlen(f->name));
+		p = put16(p, 0);		/* Extra */
+		p = put16(p, 0);		/* Comment */
+		p = put16(p, 0);		/* Disk */
+		p = put16(p, 0);		/* Internal attributes */
+		p = put32(p, 0);		/* External attributes */
+		p = put32(p, f->offset);
+
+		if (fwrite(hdr, sizeof(hdr), 1, ex->fp) != 1 ||
+		    fwrite(f->name, strlen(f->name), 1, ex->fp) != 1)
+			return -1;
+		size += sizeof(hdr) + strlen(f->name);
+	}
+
+	p = put32(hdr, ZIP_END);
+	p = put16(p, 0);
+	p = put16(p, 0);
+	p = put16(p, ex->num);
+	p = put16(p, ex->num);
+	p = put32(p, size);
+	p = put32(p, off);
+	p = put16(p, 0);
+	if (fwrite(hdr, p - hdr, 1, ex->fp) != 1)
+		return -1;
+
+	return 0;
+}
+
+static int session_start(struct export *ex, const char *channel)
+{
+	char meta[256];
+
+	snprintf(meta, sizeof(meta),
+		 "[global]\n"
+		 "sigrok version=0.5.2\n"
+		 "\n"
+		 "[device 1]\n"
+		 "capturefile=logic-1\n"
+		 "total probes=1\n"
+		 "samplerate=%d MHz\n"
+		 "total analog=0\n"
+		 "probe1=%s\n"
+		 "unitsize=1\n", EXPORT_RATE / 1000000, channel);
+
+	if (member_start(ex, "version") || member_data(ex, "2", 1) || member_end(ex) ||
+	    member_start(ex, "metadata") || member_data(ex, meta, strlen(meta)) || member_end(ex))
+		return -1;
+
+	return 0;
+}
+
+/* One byte per sample, in logic files of up to EXPORT_CHUNK samples */
+static int samples(struct export *ex, int level, int32_t num)
+{
+	uint8_t buf[4096];
+
+	memset(buf, level, sizeof(buf));
+	while (num > 0) {
+		struct export_file *f = &ex->file[ex->num - 1];
+		size_t len = num < (int32_t)sizeof(buf) ? (size_t)num : sizeof(buf);
+		char name[24];
+
+		if (strncmp(f->name, "logic-", 6) || f->size == EXPORT_CHUNK) {
+			if (!strncmp(f->name, "logic-", 6) && member_end(ex))
+				return -1;
+			snprintf(name, sizeof(name), "logic-1-%d", ex->num - 1);
+			if (member_start(ex, name))
+				return -1;
+			f = &ex->file[ex->num - 1];
+		}
+		if (len > EXPORT_CHUNK - f->size)
+			len = EXPORT_CHUNK - f->size;
+
+		if (member_data(ex, buf, len))
+			return -1;
+		num -= len;
+	}
+
+	return 0;
+}
+
+/*
+ * Create waveform file at @path, a sigrok session if it ends in '.sr',
+ * otherwise a VCD.  @start is the wall-clock time of the first element,
+ * or 0 for an encoded, not yet sent, waveform.
+ */
+int export_open(struct export *ex, const char *path, const char *channel, int64_t start)
+{
+	const char *ext = strrchr(path, '.');
+
+	memset(ex, 0, sizeof(*ex));
+	ex->level  = -1;
+	ex->format = ext && !strcmp(ext, ".sr") ? EXPORT_SR : EXPORT_VCD;
+
+	ex->fp = fopen(path, "wb");
+	if (!ex->fp)
+		return -1;
+
+	if (ex->format == EXPORT_SR) {
+		crc_init();
+		if (session_start(ex, channel))
+			goto fail;
+
+		return 0;
+	}
+
+	if (start) {
+		time_t sec = start / 1000000;
+		char date[32];
+
+		strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", localtime(&sec));
+		fprintf(ex->fp, "$date %s.%06d $end\n", date, (int)(start % 1000000));
+	}
+	fprintf(ex->fp, "$version rfctl %s $end\n"
+		"$timescale 1 us $end\n"
+		"$scope module rfctl $end\n"
+		"$var wire 1 ! %s $end\n"
+		"$upscope $end\n"
+		"$enddefinitions $end\n", VERSION, channel);
+	if (ferror(ex->fp))
+		goto fail;
+
+	return 0;
+fail:
+	fclose(ex->fp);
+	free(ex->file);
+	ex->fp = NULL;
+	ex->file = NULL;
+
+	return -1;
+}
+
+/* Append elements, a timeout is low like a space */
+int export_edges(struct export *ex, const int32_t *buf, int len)
+{
+	int i;
+
+	for (i = 0; i < len; i++) {
+		int level = LIRC_IS_PULSE(buf[i]) ? 1 : 0;
+
+		if (ex->format == EXPORT_SR) {
+			if (samples(ex, level, LIRC_VALUE(buf[i])))
+				return -1;
+		} else if (level != ex->level) {
+			fprintf(ex->fp, "#%lld\n%d!\n", (long long)ex->time, level);
+		}
+
+		ex->level = level;
+		ex->time += LIRC_VALUE(buf[i]);
+	}
+
+	if (ferror(ex->fp))
+		return -1;
+
+	return 0;
+}
+
+/* End the waveform and close, returns -1 if any write failed */
+int export_close(struct export *ex)
+{
+	int rc = 0;
+
+	if (!ex->fp)
+		return 0;
+
+	if (ex->format == EXPORT_SR) {
+		if (!strncmp(ex->file[ex->num - 1].name, "logic-", 6))
+			rc = member_end(ex);
+		else
+			rc = member_start(ex, "logic-1-1") || member_end(ex) ? -1 : 0;
+		if (!rc)
+			rc = central(ex);
+	} else {
+		fprintf(ex->fp, "#%lld\n", (long long)ex->time);
+	}
+
+	if (ferror(ex->fp))
+		rc = -1;
+	if (fclose(ex->fp))
+		rc = -1;
+	free(ex->file);
+	ex->fp = NULL;
+	ex->file = NULL;
+
+	return rc;
+}
@@ -0,0 +1,63 @@
+/* Control tool for NEXA and other RF remote receivers
+ *
+ * Copyright (C) 2010, 2012  Tord Andersson <tord.andersson@endian.se>
+ * Copyright (C) 2017        Joachim Nilsson <troglobit@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, visit the Free Software Foundation
+ * website at http://www.gnu.org/licenses/gpl-2.0.html or write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef RFCTL_EXPORT_H_
+#define RFCTL_EXPORT_H_
+
+#include "protocol.h"
+
+#define EXPORT_RATE  1000000	/* Samples per second in sigrok sessions, one per us */
+#define EXPORT_CHUNK (4 << 20)	/* Max samples per logic file in a sigrok session */
+
+enum {
+	EXPORT_VCD,
+	EXPORT_SR,
+};
+
+/* Member of a sigrok session, which is a zip archive */
+struct export_file {
+	char     name[24];
+	uint32_t offset;	/* of local header */
+	uint32_t crc;
+	uint32_t size;
+};
+
+/*
+ * Waveform of LIRC mode2 elements, as a Value Change Dump or a sigrok
+ * session, for viewing in e.g. PulseView.  One channel, high during
+ * pulses.  Sessions are stored uncompressed, at one sample per us.
+ */
+struct export {
+	FILE               *fp;
+	int                 format;
+	int64_t             time;	/* Of next element, since the first, us */
+	int                 level;	/* Of last element, -1 before first */
+
+	struct export_file *file;	/* Session members written so far */
+	int                 num;
+};
+
+int export_open  (struct export *ex, const char *path, const char *channel, int64_t start);
+int export_edges (struct export *ex, const int32_t *buf, int len);
+int export_close (struct export *ex);
+
+#endif /* RFCTL_EXPORT_H_ */
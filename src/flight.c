@@ -0,0 +1,164 @@
+/* Control tool for NEXA and other RF remote receivers
+ *
+ * Copyright (C) 2010, 2012  Tord Andersson <tord.andersson@endian.se>
+ * Copyright (C) 2017        Joachim Nilsson <troglobit@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, visit the Free Software Foundation
+ * website at http://www.gnu.org/licenses/gpl-2.0.html or write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <errno.h>
+#include <time.h>
+
+#include "common.h"
+#include "capture.h"
+#include "flight.h"
+
+/* Save snapshots as capture files, one at a time */
+static void *writer(void *arg)
+{
+	struct flight *fl = arg;
+	struct capture_out out;
+	char path[256], name[64];
+	struct tm tm;
+	time_t now;
+
+	pthread_mutex_lock(&fl->lock);
+	while (1) {
+		while (!fl->busy && !fl->stop)
+			pthread_cond_wait(&fl->cond, &fl->lock);
+		if (!fl->busy)
+			break;
+		pthread_mutex_unlock(&fl->lock);
+
+		now = fl->snap_end / 1000000;
+		localtime_r(&now, &tm);
+		strftime(name, sizeof(name), FLIGHT_FILE, &tm);
+		snprintf(path, sizeof(path), "%s/%s-%s.rfc", fl->dir, name, fl->reason);
+
+		if (capture_create(&out, path, "flight recorder", IFC_UNKNOWN, 0) ||
+		    capture_write(&out, fl->snap, fl->len, fl->snap_end) || capture_finish(&out))
+			fprintf(stderr, "Flight recorder failed writing %s: %s\n", path, strerror(errno));
+		else
+			fprintf(stderr, "Flight recorder saved %u elements to %s\n", fl->len, path);
+
+		pthread_mutex_lock(&fl->lock);
+		fl->busy = false;
+	}
+	pthread_mutex_unlock(&fl->lock);
+
+	return NULL;
+}
+
+int flight_init(struct flight *fl, int keep, const char *dir)
+{
+	memset(fl, 0, sizeof(*fl));
+	fl->keep = keep;
+	fl->dir  = dir ? dir : FLIGHT_DIR;
+	atomic_init(&fl->request, false);
+
+	fl->buf  = malloc(FLIGHT_LEN * sizeof(*fl->buf));
+	fl->snap = malloc(FLIGHT_LEN * sizeof(*fl->snap));
+	if (!fl->buf || !fl->snap)
+		goto fail;
+
+	pthread_mutex_init(&fl->lock, NULL);
+	pthread_cond_init(&fl->cond, NULL);
+	if (pthread_create(&fl->writer, NULL, writer, fl))
+		goto fail;
+
+	return 0;
+fail:
+	free(fl->buf);
+	free(fl->snap);
+	fl->buf = fl->snap = NULL;
+
+	return -1;
+}
+
+/*
+ * Hand the elements of the last @keep seconds to the writer.  Must be
+ * called from the thread that adds elements.  If the writer is still
+ * busy with the previous dump, this one is missed.
+ */
+void flight_dump(struct flight *fl, const char *reason)
+{
+	uint32_t num = fl->head < FLIGHT_LEN ? fl->head : FLIGHT_LEN;
+	uint32_t len = 0, first;
+	int64_t span = 0;
+
+	pthread_mutex_lock(&fl->lock);
+	if (fl->busy) {
+		fl->missed++;
+		pthread_mutex_unlock(&fl->lock);
+		return;
+	}
+	pthread_mutex_unlock(&fl->lock);
+
+	while (len < num && span < (int64_t)fl->keep * 1000000) {
+		span += LIRC_VALUE(fl->buf[(fl->head - len - 1) & (FLIGHT_LEN - 1)]);
+		len++;
+	}
+	if (!len)
+		return;
+
+	/* Oldest first, in at most two pieces */
+	first = (fl->head - len) & (FLIGHT_LEN - 1);
+	if (first + len <= FLIGHT_LEN) {
+		memcpy(fl->snap, &fl->buf[first], len * sizeof(*fl->snap));
+	} else {
+		uint32_t part = FLIGHT_LEN - first;
+
+		memcpy(fl->snap, &fl->buf[first], part * sizeof(*fl->snap));
+		memcpy(&fl->snap[part], fl->buf, (len - part) * sizeof(*fl->snap));
+	}
+
+	pthread_mutex_lock(&fl->lock);
+	fl->len      = len;
+	fl->snap_end = fl->end;
+	fl->reason   = reason;
+	fl->busy     = true;
+	fl->dumps++;
+	pthread_cond_signal(&fl->cond);
+	pthread_mutex_unlock(&fl->lock);
+}
+
+/* Dump on something odd seen by the decoder, at most once per window */
+void flight_anomaly(struct flight *fl, const char *reason)
+{
+	if (fl->last && fl->end - fl->last < (int64_t)fl->keep * 1000000)
+		return;
+
+	fl->last = fl->end;
+	flight_dump(fl, reason);
+}
+
+/* Waits for a dump in progress to be saved */
+void flight_exit(struct flight *fl)
+{
+	if (!fl->buf)
+		return;
+
+	pthread_mutex_lock(&fl->lock);
+	fl->stop = true;
+	pthread_cond_signal(&fl->cond);
+	pthread_mutex_unlock(&fl->lock);
+	pthread_join(fl->writer, NULL);
+
+	free(fl->buf);
+	free(fl->snap);
+	fl->buf = fl->snap = NULL;
+}
@@ -0,0 +1,88 @@
+/* Control tool for NEXA and other RF remote receivers
+ *
+ * Copyright (C) 2010, 2012  Tord Andersson <tord.andersson@endian.se>
+ * Copyright (C) 2017        Joachim Nilsson <troglobit@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, visit the Free Software Foundation
+ * website at http://www.gnu.org/licenses/gpl-2.0.html or write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef RFCTL_FLIGHT_H_
+#define RFCTL_FLIGHT_H_
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "protocol.h"
+
+#define FLIGHT_LEN   262144		/* Elements kept, power of two */
+#define FLIGHT_DIR   "/var/tmp"
+#define FLIGHT_FILE  "rfctl-%Y%m%d-%H%M%S"
+
+/*
+ * Flight recorder, the last received elements in a ring allocated up
+ * front.  A dump copies those of the last @keep seconds to a snapshot,
+ * also allocated up front, that a writer thread saves as a capture
+ * file, so reception is never held up by the disk.
+ */
+struct flight {
+	int32_t         *buf;
+	uint32_t         head;		/* Elements added in total */
+	int64_t          end;		/* Wall-clock end of newest element */
+	int              keep;		/* Seconds */
+	const char      *dir;
+
+	int32_t         *snap;
+	uint32_t         len;
+	int64_t          snap_end;
+	const char      *reason;
+	int64_t          last;		/* Latest anomaly dump */
+
+	atomic_bool      request;	/* From signal handler */
+	pthread_t        writer;
+	pthread_mutex_t  lock;
+	pthread_cond_t   cond;
+	bool             busy, stop;
+
+	unsigned long    dumps, missed;
+};
+
+int  flight_init    (struct flight *fl, int keep, const char *dir);
+void flight_dump    (struct flight *fl, const char *reason);
+void flight_anomaly (struct flight *fl, const char *reason);
+void flight_exit    (struct flight *fl);
+
+/* Called for every element, keep it cheap */
+static inline void flight_add(struct flight *fl, int32_t val, int64_t time)
+{
+	fl->buf[fl->head++ & (FLIGHT_LEN - 1)] = val;
+	fl->end = time + LIRC_VALUE(val);
+}
+
+/* Async-signal-safe, the dump is made by the next flight_poll() */
+static inline void flight_request(struct flight *fl)
+{
+	atomic_store(&fl->request, true);
+}
+
+static inline void flight_poll(struct flight *fl)
+{
+	if (atomic_load_explicit(&fl->request, memory_order_relaxed) &&
+	    atomic_exchange(&fl->request, false))
+		flight_dump(fl, "signal");
+}
+
+#endif /* RFCTL_FLIGHT_H_ */
@@ -0,0 +1,237 @@
+/* Control tool for NEXA and other RF remote receivers
+ *
+ * Copyright (C) 2010, 2012  Tord Andersson <tord.andersson@endian.se>
+ * Copyright (C) 2017        Joachim Nilsson <troglobit@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, visit the Free Software Foundation
+ * website at http://www.gnu.org/licenses/gpl-2.0.html or write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <time.h>
+
+#include "common.h"
+#include "protocol.h"
+
+static long long now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int serial_setup(int fd, speed_t speed)
+{
+	struct termios tio;
+
+	/* adjust serial port parameters */
+	memset(&tio, 0, sizeof(tio));	/* clear struct for new port settings */
+	tio.c_cflag = CS8 | CLOCAL | CREAD;
+	tio.c_iflag = IGNPAR;
+	tio.c_oflag = 0;
+	cfsetispeed(&tio, speed);
+	cfsetospeed(&tio, speed);
+	tcflush(fd, TCIFLUSH);
+
+	return tcsetattr(fd, TCSANOW, &tio);
+}
+
+/*
+ * Wait for the Tellstick to acknowledge each command in the last batch.
+ * It replies with the command character, e.g. "+S\r\n", when done.
+ */
+static int tellstick_ack(struct iface *ifc, int num)
+{
+	struct pollfd pfd = { .fd = ifc->fd, .events = POLLIN };
+	char buf[64];
+	ssize_t len;
+	int i;
+
+	while (num > 0) {
+		if (poll(&pfd, 1, TELLSTICK_ACK_TIMEOUT) <= 0) {
+			errno = ETIMEDOUT;
+			return -1;
+		}
+
+		len = read(ifc->fd, buf, sizeof(buf));
+		if (len <= 0)
+			return -1;
+
+		for (i = 0; i < len; i++) {
+			if (buf[i] == '+')
+				num--;
+		}
+	}
+
+	return 0;
+}
+
+int iface_open(struct iface *ifc, rf_interface_t type, const char *device)
+{
+	memset(ifc, 0, sizeof(*ifc));
+	ifc->type   = type;
+	ifc->device = device;
+
+	ifc->fd = open(device, O_RDWR | O_NOCTTY);
+	if (ifc->fd < 0)
+		return -1;
+
+	switch (type) {
+	case IFC_RFCTL:
+		break;
+
+	case IFC_CUL:
+		serial_setup(ifc->fd, B115200);
+		break;
+
+	case IFC_TELLSTICK:
+		serial_setup(ifc->fd, B4800);
+		break;
+
+	default:
+		close(ifc->fd);
+		ifc->fd = -1;
+		errno = EINVAL;
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Send all queued commands.  Only the Tellstick queues commands, they
+ * are sent as one serial transaction and then we wait for the device
+ * to acknowledge all of them before the next batch can be sent.
+ */
+int iface_flush(struct iface *ifc)
+{
+	long long start;
+	int rc = 0;
+
+	if (ifc->type != IFC_TELLSTICK || ifc->queued == 0)
+		return 0;
+
+	start = now_us();
+	if (write(ifc->fd, ifc->buf, ifc->len) != (ssize_t)ifc->len)
+		rc = -1;
+	else if (tellstick_ack(ifc, ifc->queued))
+		rc = -1;
+
+	ifc->usec += now_us() - start;
+	ifc->count += ifc->queued;
+	ifc->queued = 0;
+	ifc->len = 0;
+
+	return rc;
+}
+
+/*
+ * Send, or queue, one command on the interface.  The rfctl.ko driver
+ * and the CUL stick are written to directly, Tellstick commands are
+ * batched until the buffer is full or iface_flush() is called.
+ */
+int iface_send(struct iface *ifc, const int32_t *bitstream, int len, int repeat)
+{
+	char cmd[RF_MAX_TX_BITS * 6]; /* hex/ASCII representation is longer than bitstream */
+	long long start;
+	int cmd_len;
+	int rc = 0;
+	int i;
+
+	switch (ifc->type) {
+	case IFC_RFCTL:
+		start = now_us();
+		for (i = 0; i < repeat; i++) {
+			if (write(ifc->fd, bitstream, len * 4) < 0) {
+				rc = -1;
+				break;
+			}
+		}
+		break;
+
+	case IFC_CUL:
+		/* CUL433 nethome format */
+		cmd_len = bitstream2cul443(bitstream, len, repeat, cmd);
+		if (cmd_len == 0) {
+			errno = EINVAL;
+			return -1;
+		}
+
+		start = now_us();
+		if (write(ifc->fd, cmd, cmd_len) < 0)
+			rc = -1;
+		tcdrain(ifc->fd);
+		break;
+
+	case IFC_TELLSTICK:
+		cmd_len = bitstream2tellstick(bitstream, len, repeat, cmd);
+		if (cmd_len == 0) {
+			errno = EINVAL;
+			return -1;
+		}
+
+		if (ifc->len + cmd_len > sizeof(ifc->buf) && iface_flush(ifc))
+			return -1;
+
+		memcpy(&ifc->buf[ifc->len], cmd, cmd_len);
+		ifc->len += cmd_len;
+		ifc->queued++;
+
+		return 0;
+
+	default:
+		errno = EINVAL;
+		return -1;
+	}
+
+	ifc->usec += now_us() - start;
+	ifc->count++;
+
+	return rc;
+}
+
+/*
+ * Send a frame whose @repeat copies are already laid out back-to-back
+ * in @frames, e.g. from the frame store.  The rfctl.ko driver gets all
+ * of them in one write, the serial interfaces repeat on their own.
+ */
+int iface_send_frames(struct iface *ifc, const int32_t *frames, int len, int repeat)
+{
+	if (ifc->type == IFC_RFCTL)
+		return iface_send(ifc, frames, len * repeat, 1);
+
+	return iface_send(ifc, frames, len, repeat);
+}
+
+/* Flush any queued commands and close, returns -1 if flush failed */
+int iface_close(struct iface *ifc)
+{
+	int rc;
+
+	if (ifc->fd < 0)
+		return 0;
+
+	rc = iface_flush(ifc);
+	close(ifc->fd);
+	ifc->fd = -1;
+
+	return rc;
+}
@@ -23,141 +23,116 @@
 #include "common.h"
 #include "protocol.h"
 
-int ikea_bitstream(const char *house, const char *chan, const char *level,
-		   const char *dim_style, int32_t *bitstream, int *repeat)
+/* Append one element, IKEA toggles the level on every element */
+static int ikea_elem(int32_t *bitstream, int i, int usec)
 {
-#if 0
-	*pStrReturn = '\0';	/* Make sure tx Bitstream is empty */
-
-	const char STARTCODE[] = "STTTTTT�";
-	const char TT[] = "TT";
-	const char A[] = "�";
-	int system = atoi(house) - 1;	/* System 1..16 */
-	int channel = atoi(chan);	/* Channel 1..10 */
-	int lvl = atoi(level);	/* off,10,20,..,90,on */
-	int dim = atoi(dim_style);
-	int code = 0;
-	int checksum1 = 0;
-	int checksum2 = 0;
-	int fade;
-	int i;
-	int raw = 0;
-
-	/* check converted parameters for validity */
-	if ((channel <= 0) || (channel > 10) || (system < 0) || (system > 15) ||
-	    (lvl < 0) || (lvl > 10) || (dim < 0) || (dim > 1))
-		return 0;
+	bitstream[i] = i % 2 ? LIRC_SPACE(usec) : LIRC_PULSE(usec);
 
-	if (channel == 10)
-		channel = 0;
-	raw = (1 << (9 - channel));
-
-	strcat(pStrReturn, STARTCODE);	//Startcode, always like this;
-	code = (system << 10) | raw;
-
-	for (i = 13; i >= 0; --i) {
-		if ((code >> i) & 1) {
-			strcat(pStrReturn, TT);
-			if (i % 2 == 0)
-				checksum2++;
-			else
-				checksum1++;
-		} else {
-			strcat(pStrReturn, A);
-		}
-	}
+	return i + 1;
+}
 
-	if (checksum1 % 2 == 0)
-		strcat(pStrReturn, TT);
-	else
-		strcat(pStrReturn, A);	//1st checksum
-
-	if (checksum2 % 2 == 0)
-		strcat(pStrReturn, TT);
-	else
-		strcat(pStrReturn, A);	//2nd checksum
-
-	if (dim == 1)
-		fade = 11 << 4;	//Smooth
-	else
-		fade = 1 << 4;	//Instant
-
-	switch (lvl) {
-	case 0:
-		code = (10 | fade);	//Concat level and fade
-		break;
-
-	case 1:
-		code = (1 | fade);	//Concat level and fade
-		break;
-
-	case 2:
-		code = (2 | fade);	//Concat level and fade
-		break;
-
-	case 3:
-		code = (3 | fade);	//Concat level and fade
-		break;
-
-	case 4:
-		code = (4 | fade);	//Concat level and fade
-		break;
-
-	case 5:
-		code = (5 | fade);	//Concat level and fade
-		break;
-
-	case 6:
-		code = (6 | fade);	//Concat level and fade
-		break;
-
-	case 7:
-		code = (7 | fade);	//Concat level and fade
-		break;
-
-	case 8:
-		code = (8 | fade);	//Concat level and fade
-		break;
-
-	case 9:
-		code = (9 | fade);	//Concat level and fade
-		break;
-
-	case 10:
-	default:
-		code = (0 | fade);	//Concat level and fade
-		break;
+/* A one is two short elements, a zero one long */
+static int ikea_bit(int32_t *bitstream, int i, int bit)
+{
+	if (bit) {
+		i = ikea_elem(bitstream, i, IKEA_SHORT_PERIOD);
+		return ikea_elem(bitstream, i, IKEA_SHORT_PERIOD);
 	}
 
-	checksum1 = 0;
-	checksum2 = 0;
+	return ikea_elem(bitstream, i, IKEA_LONG_PERIOD);
+}
 
-	for (i = 0; i < 6; ++i) {
-		if ((code >> i) & 1) {
-			strcat(pStrReturn, TT);
+/*
+ * Encode one frame for IKEA Koppla, system 1..16, channel 1..10, level
+ * 0..100 in steps of 10.  Level 1 is on, full level, as for all other
+ * protocols, so scenes and groups sending '1' work.  With @smooth the
+ * receiver fades to the new level on its own, so a dim ramp is one
+ * frame instead of one per step.  Returns number of elements, or 0 on
+ * invalid arguments.
+ */
+int ikea_frame(int system, int channel, int level, bool smooth, int32_t *bitstream)
+{
+	int checksum1 = 0, checksum2 = 0;
+	int code, lvl;
+	int i, bit;
 
-			if (i % 2 == 0)
-				checksum1++;
-			else
-				checksum2++;
-		} else {
-			strcat(pStrReturn, A);
-		}
-	}
+	if (system < 1 || system > 16 || channel < 1 || channel > 10 ||
+	    level < 0 || level > 100)
+		return 0;
 
-	if (checksum1 % 2 == 0)
-		strcat(pStrReturn, TT);
-	else
-		strcat(pStrReturn, A);	//2nd checksum
+	/* Start code, always the same */
+	for (i = 0; i < 6;)
+		i = ikea_elem(bitstream, i, IKEA_SHORT_PERIOD);
+	i = ikea_elem(bitstream, i, IKEA_LONG_PERIOD);
+
+	/* System and one bit per channel, 10 is the first */
+	code = ((system - 1) << 10) | (1 << (9 - channel % 10));
+	for (bit = 13; bit >= 0; bit--) {
+		int val = (code >> bit) & 1;
+
+		if (val && bit % 2)
+			checksum1++;
+		else if (val)
+			checksum2++;
+		i = ikea_bit(bitstream, i, val);
+	}
+	i = ikea_bit(bitstream, i, checksum1 % 2 == 0);
+	i = ikea_bit(bitstream, i, checksum2 % 2 == 0);
+
+	/* Level 1..9 is 10..90%, 10 is off and 0 is on */
+	lvl = level == 1 ? 10 : (level + 5) / 10;
+	if (lvl == 0)
+		lvl = 10;
+	else if (lvl == 10)
+		lvl = 0;
+	code = lvl | (smooth ? 11 << 4 : 1 << 4);
+
+	checksum1 = checksum2 = 0;
+	for (bit = 0; bit < 6; bit++) {
+		int val = (code >> bit) & 1;
+
+		if (val && bit % 2)
+			checksum2++;
+		else if (val)
+			checksum1++;
+		i = ikea_bit(bitstream, i, val);
+	}
+	i = ikea_bit(bitstream, i, checksum1 % 2 == 0);
+	i = ikea_bit(bitstream, i, checksum2 % 2 == 0);
 
-	if (checksum2 % 2 == 0)
-		strcat(pStrReturn, TT);
-	else
-		strcat(pStrReturn, A);	//2nd checksum
-	strcat(pStrReturn, "+");
+	/* Sync, a pulse ends the last element if it is a space */
+	if (i % 2 == 0)
+		i = ikea_elem(bitstream, i, IKEA_SHORT_PERIOD);
+	i = ikea_elem(bitstream, i, IKEA_SYNC_PERIOD);
 
-	return strlen(pStrReturn);
-#endif
-	return 0;
+	return i;
 }
 
+/*
+ * Level may end in ':smooth' or ':instant' to override @dim_style, 1
+ * for smooth and 0 for instant.
+ */
+int ikea_bitstream(const char *house, const char *chan, const char *level,
+		   const char *dim_style, int32_t *bitstream, int *repeat)
+{
+	int dim = atoi(dim_style);
+	char *end;
+	long lvl;
+
+	*repeat = IKEA_REPEAT;
+
+	lvl = strtol(level, &end, 10);
+	if (end == level)
+		return 0;
+	if (!strcmp(end, ":smooth"))
+		dim = 1;
+	else if (!strcmp(end, ":instant"))
+		dim = 0;
+	else if (*end)
+		return 0;
+
+	if (dim < 0 || dim > 1)
+		return 0;
+
+	return ikea_frame(atoi(house), atoi(chan), lvl, dim, bitstream);
+}
@@ -23,28 +23,24 @@
 #include "common.h"
 #include "protocol.h"
 
-int impulse_bitstream(const char *chan, const char *onoff, int32_t *bitstream, int *repeat)
+/*
+ * Encode one frame from an already parsed 10-bit channel code, same as
+ * for SARTANO, and on/off.  Returns number of elements, or 0 on error.
+ */
+int impulse_frame(int code, int enable, int32_t *bitstream)
 {
 	int i = 0;
-	int enable;
 	int bit;
 
-	enable = atoi(onoff);	/* ON/OFF 0..1 */
-	*repeat = SARTANO_REPEAT;
-
-	PRINT("Channel: %s, on_off: %d\n", chan, enable);
-
 	/* check converted parameters for validity */
-	if ((strlen(chan) != 10) || (enable < 0) || (enable > 1)) {
-		fprintf(stderr, "Invalid channel or on/off code\n");
+	if ((code < 0) || (code > 0x3FF) || (enable < 0) || (enable > 1))
 		return 0;
-	}
 
 	// The house code:
 	for (bit = 0; bit < 5; bit++) {
 		/* "1" bit */
 		// 11101110 is on
-		if (strncmp(chan + bit, "1", 1) == 0) {
+		if (code & (0x200 >> bit)) {
 			bitstream[i++] = LIRC_PULSE(SARTANO_LONG_PERIOD);
 			bitstream[i++] = LIRC_SPACE(SARTANO_SHORT_PERIOD);
 			bitstream[i++] = LIRC_PULSE(SARTANO_LONG_PERIOD);
@@ -63,7 +59,7 @@ int impulse_bitstream(const char *chan, const char *onoff, int32_t *bitstream, i
 	for (bit = 5; bit < 10; bit++) {
 		/* "1" bit */
 		// 10001000 is on
-		if (strncmp(chan + bit, "1", 1) == 0) {
+		if (code & (0x200 >> bit)) {
 			bitstream[i++] = LIRC_PULSE(SARTANO_SHORT_PERIOD);
 			bitstream[i++] = LIRC_SPACE(SARTANO_LONG_PERIOD);
 			bitstream[i++] = LIRC_PULSE(SARTANO_SHORT_PERIOD);
@@ -106,3 +102,10 @@ int impulse_bitstream(const char *chan, const char *onoff, int32_t *bitstream, i
 
 	return i;
 }
+
+int impulse_bitstream(const char *chan, const char *onoff, int32_t *bitstream, int *repeat)
+{
+	*repeat = SARTANO_REPEAT;
+
+	return impulse_frame(sartano_code(chan), atoi(onoff), bitstream);
+}
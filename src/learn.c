@@ -0,0 +1,344 @@
+/* Control tool for NEXA and other RF remote receivers
+ *
+ * Copyright (C) 2010, 2012  Tord Andersson <tord.andersson@endian.se>
+ * Copyright (C) 2017        Joachim Nilsson <troglobit@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, visit the Free Software Foundation
+ * website at http://www.gnu.org/licenses/gpl-2.0.html or write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <errno.h>
+
+#include "common.h"
+#include "learn.h"
+
+#define PROFILE_MAGIC "# rfctl profile"
+
+void learn_init(struct learn *ln, int presses)
+{
+	memset(ln, 0, sizeof(*ln));
+	ln->max  = presses;
+	ln->idle = true;
+}
+
+static void frame_end(struct learn *ln)
+{
+	if (ln->curlen >= LEARN_MIN && ln->num < LEARN_FRAMES) {
+		if (ln->idle) {
+			ln->presses++;
+			ln->idle = false;
+		}
+
+		memcpy(ln->frame[ln->num], ln->cur, ln->curlen * sizeof(ln->cur[0]));
+		ln->len[ln->num]   = ln->curlen;
+		ln->press[ln->num] = ln->presses;
+		ln->last[ln->num]  = false;
+		ln->num++;
+	}
+	ln->curlen = 0;
+}
+
+/*
+ * Add a received element.  Frames end at a space of at least RX_GAP,
+ * presses at a silence of LEARN_PRESS_GAP.  Returns true when all the
+ * presses asked for have been recorded.
+ */
+bool learn_edge(struct learn *ln, int32_t val)
+{
+	bool silence = LIRC_IS_TIMEOUT(val) ||
+		(LIRC_IS_SPACE(val) && LIRC_VALUE(val) >= LEARN_PRESS_GAP);
+
+	/* Frames start with a pulse */
+	if (!ln->curlen && !LIRC_IS_PULSE(val)) {
+		if (silence)
+			ln->idle = true;
+		return ln->idle && ln->presses >= ln->max;
+	}
+
+	if (ln->curlen == RF_MAX_FRAME_BITS)
+		ln->curlen = 0;		/* Too long, noise */
+	ln->cur[ln->curlen++] = val;
+
+	if (silence) {
+		int num = ln->num;
+
+		frame_end(ln);
+		if (ln->num > num)
+			ln->last[num] = true;
+		ln->idle = true;
+
+		return ln->presses >= ln->max;
+	}
+
+	if (LIRC_IS_SPACE(val) && LIRC_VALUE(val) >= RX_GAP)
+		frame_end(ln);
+
+	return false;
+}
+
+static int cmp(const void *a, const void *b)
+{
+	return *(const int32_t *)a - *(const int32_t *)b;
+}
+
+/* Silence after the last frame of a press is not part of the frame */
+static bool counted(const struct learn *ln, int f, int pos, int len)
+{
+	return !(ln->last[f] && pos == len - 1);
+}
+
+static int level(const int32_t *max, int num, int32_t usec)
+{
+	int k;
+
+	for (k = 0; k < num - 1; k++) {
+		if (usec <= max[k])
+			break;
+	}
+
+	return k;
+}
+
+/*
+ * Find the most common frame length, group all durations of those
+ * frames into levels, take the majority level at each position, and
+ * average the durations of frames that match it at every position.
+ * Each pulse and the space after it becomes one symbol.  Enough frames
+ * are repeated for one of them to arrive intact at the rate seen here,
+ * plus one, but never more than the remote itself sent.
+ */
+int learn_profile(struct learn *ln, struct profile *prof)
+{
+	int count[RF_MAX_FRAME_BITS + 1] = { 0 };
+	int32_t max[LEARN_LEVELS], lvl[RF_MAX_FRAME_BITS];
+	int64_t sum[LEARN_LEVELS] = { 0 };
+	int num[LEARN_LEVELS] = { 0 };
+	int per[LEARN_FRAMES + 1] = { 0 };
+	int32_t *all;
+	int f, pos, len = 0, n = 0, levels = 0, kept = 0, intact = 0, need, least;
+	int i, k;
+
+	memset(prof, 0, sizeof(*prof));
+
+	for (f = 0; f < ln->num; f++)
+		count[ln->len[f]]++;
+	for (i = LEARN_MIN; i <= RF_MAX_FRAME_BITS; i++) {
+		if (count[i] > count[len])
+			len = i;
+	}
+	if (!len || len % 2 || len / 2 > (int)sizeof(prof->pattern) - 1)
+		goto fail;
+
+	all = malloc(count[len] * len * sizeof(*all));
+	if (!all)
+		return -1;
+	for (f = 0; f < ln->num; f++) {
+		if (ln->len[f] != len)
+			continue;
+		for (pos = 0; pos < len; pos++) {
+			if (counted(ln, f, pos, len))
+				all[n++] = LIRC_VALUE(ln->frame[f][pos]);
+		}
+	}
+
+	/* Sorted durations split where one is LEARN_SPREAD longer than the one before */
+	qsort(all, n, sizeof(*all), cmp);
+	for (i = 0; i < n; i++) {
+		if (i && (int64_t)all[i] * 100 > (int64_t)all[i - 1] * (100 + LEARN_SPREAD)) {
+			max[levels++] = all[i - 1];
+			if (levels == LEARN_LEVELS)
+				break;
+		}
+	}
+	if (n && levels < LEARN_LEVELS)
+		max[levels++] = all[n - 1];
+	free(all);
+	if (!levels || levels == LEARN_LEVELS)
+		goto fail;
+
+	/* Majority level at each position, none if only seen before silence */
+	for (pos = 0; pos < len; pos++) {
+		int votes[LEARN_LEVELS] = { 0 };
+
+		for (f = 0; f < ln->num; f++) {
+			if (ln->len[f] == len && counted(ln, f, pos, len))
+				votes[level(max, levels, LIRC_VALUE(ln->frame[f][pos]))]++;
+		}
+		for (k = lvl[pos] = 0; k < levels; k++) {
+			if (votes[k] > votes[lvl[pos]])
+				lvl[pos] = k;
+		}
+		if (!votes[lvl[pos]])
+			lvl[pos] = -1;
+	}
+
+	for (f = 0; f < ln->num; f++) {
+		if (ln->len[f] != len)
+			continue;
+		kept++;
+		per[ln->press[f]]++;
+
+		for (pos = 0; pos < len; pos++) {
+			if (counted(ln, f, pos, len) &&
+			    level(max, levels, LIRC_VALUE(ln->frame[f][pos])) != lvl[pos])
+				break;
+		}
+		if (pos < len)
+			continue;
+
+		intact++;
+		for (pos = 0; pos < len; pos++) {
+			if (!counted(ln, f, pos, len))
+				continue;
+			sum[lvl[pos]] += LIRC_VALUE(ln->frame[f][pos]);
+			num[lvl[pos]]++;
+		}
+	}
+	if (!intact)
+		goto fail;
+
+	for (pos = 0; pos < len; pos += 2) {
+		int32_t pulse = sum[lvl[pos]] / num[lvl[pos]];
+		int32_t space = LEARN_GAP;
+
+		if (lvl[pos + 1] >= 0)
+			space = sum[lvl[pos + 1]] / num[lvl[pos + 1]];
+
+		for (k = 0; k < prof->num; k++) {
+			if (prof->pulse[k] == pulse && prof->space[k] == space)
+				break;
+		}
+		if (k == prof->num) {
+			if (k == PROFILE_SYMBOLS)
+				goto fail;
+			prof->pulse[k] = pulse;
+			prof->space[k] = space;
+			prof->num++;
+		}
+		prof->pattern[pos / 2] = '0' + k;
+	}
+
+	least = 0;
+	for (i = 1; i <= ln->presses && i <= LEARN_FRAMES; i++) {
+		if (per[i] && (!least || per[i] < least))
+			least = per[i];
+	}
+	need = (kept + intact - 1) / intact + 1;
+	prof->repeat  = need < least ? need : least;
+	prof->frames  = kept;
+	prof->intact  = intact;
+	prof->presses = ln->presses;
+
+	return 0;
+fail:
+	errno = EINVAL;
+	return -1;
+}
+
+int profile_save(const struct profile *prof, const char *file)
+{
+	FILE *fp;
+	int i;
+
+	fp = fopen(file, "w");
+	if (!fp)
+		return -1;
+
+	fprintf(fp, PROFILE_MAGIC ", %d presses, %d of %d frames intact\n",
+		prof->presses, prof->intact, prof->frames);
+	for (i = 0; i < prof->num; i++)
+		fprintf(fp, "symbol %d %d %d\n", i, prof->pulse[i], prof->space[i]);
+	fprintf(fp, "pattern %s\n", prof->pattern);
+	fprintf(fp, "repeat %d\n", prof->repeat);
+
+	return fclose(fp);
+}
+
+/*
+ * Load profile saved by profile_save(), files that do not start with
+ * its first line fail with ENOEXEC, so other formats can be tried.
+ */
+int profile_load(struct profile *prof, const char *file)
+{
+	char line[RF_MAX_FRAME_BITS], word[16], *pat;
+	int i, pulse, space;
+	FILE *fp;
+
+	memset(prof, 0, sizeof(*prof));
+	prof->repeat = 1;
+
+	fp = fopen(file, "r");
+	if (!fp)
+		return -1;
+
+	if (!fgets(line, sizeof(line), fp) || strncmp(line, PROFILE_MAGIC, strlen(PROFILE_MAGIC))) {
+		fclose(fp);
+		errno = ENOEXEC;
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), fp)) {
+		if (line[0] == '#' || sscanf(line, "%15s", word) != 1)
+			continue;
+
+		if (!strcmp(word, "symbol")) {
+			if (sscanf(line, "%*s %d %d %d", &i, &pulse, &space) != 3 ||
+			    i != prof->num || i >= PROFILE_SYMBOLS ||
+			    pulse <= 0 || space <= 0 || pulse > LIRC_VALUE_MASK || space > LIRC_VALUE_MASK)
+				goto fail;
+			prof->pulse[i] = pulse;
+			prof->space[i] = space;
+			prof->num++;
+		} else if (!strcmp(word, "pattern")) {
+			if (sscanf(line, "%*s %128s", prof->pattern) != 1)
+				goto fail;
+		} else if (!strcmp(word, "repeat")) {
+			if (sscanf(line, "%*s %d", &prof->repeat) != 1 || prof->repeat < 1)
+				goto fail;
+		} else {
+			goto fail;
+		}
+	}
+	fclose(fp);
+
+	if (!prof->pattern[0])
+		goto invalid;
+	for (pat = prof->pattern; *pat; pat++) {
+		if (*pat < '0' || *pat >= '0' + prof->num)
+			goto invalid;
+	}
+
+	return 0;
+fail:
+	fclose(fp);
+invalid:
+	errno = EINVAL;
+	return -1;
+}
+
+/* One frame of the profile, returns number of elements */
+int profile_frame(const struct profile *prof, int32_t *bitstream)
+{
+	const char *pat;
+	int len = 0;
+
+	for (pat = prof->pattern; *pat; pat++) {
+		bitstream[len++] = LIRC_PULSE(prof->pulse[*pat - '0']);
+		bitstream[len++] = LIRC_SPACE(prof->space[*pat - '0']);
+	}
+
+	return len;
+}
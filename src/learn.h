@@ -0,0 +1,76 @@
+/* Control tool for NEXA and other RF remote receivers
+ *
+ * Copyright (C) 2010, 2012  Tord Andersson <tord.andersson@endian.se>
+ * Copyright (C) 2017        Joachim Nilsson <troglobit@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, visit the Free Software Foundation
+ * website at http://www.gnu.org/licenses/gpl-2.0.html or write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef RFCTL_LEARN_H_
+#define RFCTL_LEARN_H_
+
+#include "rx.h"
+
+#define LEARN_PRESSES   5		/* Default number of presses to record */
+#define LEARN_PRESS_GAP 100000		/* us of silence between two presses */
+#define LEARN_FRAMES    256		/* Max frames recorded */
+#define LEARN_MIN       8		/* Shorter frames are noise */
+#define LEARN_SPREAD    25		/* Percent, durations closer are one level */
+#define LEARN_LEVELS    16
+#define LEARN_GAP       (2 * RX_GAP)	/* After frames only seen before silence */
+#define PROFILE_SYMBOLS 10		/* '0'..'9' */
+
+/*
+ * Replay profile of a learned remote button.  A frame is a pattern of
+ * symbols, each a pulse followed by a space, usually the last one has
+ * the long space that separates frames.
+ */
+struct profile {
+	int      num;			/* Symbols */
+	int32_t  pulse[PROFILE_SYMBOLS];
+	int32_t  space[PROFILE_SYMBOLS];
+	char     pattern[RF_MAX_FRAME_BITS / 2 + 1];
+	int      repeat;		/* Min frames for the receiver to get one */
+
+	int      frames, intact;	/* Recorded, and matching the pattern */
+	int      presses;
+};
+
+/* Received frames, split at gaps, and which press each belongs to */
+struct learn {
+	int32_t  frame[LEARN_FRAMES][RF_MAX_FRAME_BITS];
+	int      len[LEARN_FRAMES];
+	int      press[LEARN_FRAMES];
+	bool     last[LEARN_FRAMES];	/* Of press, ends in silence not a sync */
+	int      num;
+	int      presses;		/* Started */
+	int      max;			/* Presses to record */
+
+	int32_t  cur[RF_MAX_FRAME_BITS];
+	int      curlen;
+	bool     idle;			/* Silence since last frame */
+};
+
+void learn_init     (struct learn *ln, int presses);
+bool learn_edge     (struct learn *ln, int32_t val);
+int  learn_profile  (struct learn *ln, struct profile *prof);
+
+int  profile_save   (const struct profile *prof, const char *file);
+int  profile_load   (struct profile *prof, const char *file);
+int  profile_frame  (const struct profile *prof, int32_t *bitstream);
+
+#endif /* RFCTL_LEARN_H_ */
@@ -0,0 +1,254 @@
+/* Control tool for NEXA and other RF remote receivers
+ *
+ * Copyright (C) 2010, 2012  Tord Andersson <tord.andersson@endian.se>
+ * Copyright (C) 2017        Joachim Nilsson <troglobit@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, visit the Free Software Foundation
+ * website at http://www.gnu.org/licenses/gpl-2.0.html or write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "common.h"
+#include "protocol.h"
+#include "registry.h"
+#include "librfctl.h"
+
+struct rfctl {
+	struct iface ifc;
+};
+
+int rfctl_encode(const char *protocol, const char *group, const char *channel,
+		 const char *level, int32_t *bitstream, size_t len, int *repeat)
+{
+	int32_t tmp[RF_MAX_TX_BITS];
+	rf_protocol_t proto;
+	int num;
+
+	if (!protocol || !channel || !level || !bitstream || !repeat)
+		return RFCTL_ERR_ARGS;
+
+	proto = rf_protocol(protocol);
+	if (proto == PROT_UNKNOWN)
+		return RFCTL_ERR_PROTOCOL;
+
+	if (!group)
+		group = "-";
+
+	num = rf_encode(proto, group, channel, level, tmp, repeat);
+	if (num < 0)
+		return RFCTL_ERR_PROTOCOL;
+	if (num == 0)
+		return RFCTL_ERR_ARGS;
+	if ((size_t)num > len)
+		return RFCTL_ERR_NOSPC;
+
+	memcpy(bitstream, tmp, num * sizeof(int32_t));
+
+	return num;
+}
+
+int rfctl_encode_batch(const struct rfctl_cmd *cmd, size_t num,
+		       int32_t *bitstream, size_t len)
+{
+	int32_t frame[RF_MAX_FRAME_BITS];
+	size_t pos = 0;
+	size_t i;
+
+	if (!cmd || !bitstream)
+		return RFCTL_ERR_ARGS;
+
+	for (i = 0; i < num; i++) {
+		int repeat = 0;
+		int flen, j;
+
+		flen = rf_frame(cmd[i].protocol, cmd[i].address, cmd[i].unit,
+				cmd[i].level, frame, &repeat);
+		if (flen < 0)
+			return RFCTL_ERR_PROTOCOL;
+		if (flen == 0)
+			return RFCTL_ERR_ARGS;
+		if (pos + (size_t)flen * repeat > len)
+			return RFCTL_ERR_NOSPC;
+
+		/* Each frame ends with its sync gap, so repeats just follow */
+		for (j = 0; j < repeat; j++) {
+			memcpy(&bitstream[pos], frame, flen * sizeof(int32_t));
+			pos += flen;
+		}
+	}
+
+	return pos;
+}
+
+rfctl_registry_t *rfctl_registry_load(const char *file, int *err)
+{
+	struct registry *reg;
+
+	reg = malloc(sizeof(*reg));
+	if (!reg) {
+		if (err)
+			*err = RFCTL_ERR_NOMEM;
+		return NULL;
+	}
+
+	if (registry_load(reg, file ? file : REGISTRY_FILE)) {
+		free(reg);
+		if (err)
+			*err = RFCTL_ERR_REGISTRY;
+		return NULL;
+	}
+
+	return reg;
+}
+
+int rfctl_resolve(const rfctl_registry_t *reg, const char *name, int level,
+		  struct rfctl_cmd *cmd, size_t num)
+{
+	const int *dev;
+	int i, len;
+
+	if (!reg || !name || !cmd)
+		return RFCTL_ERR_ARGS;
+
+	len = registry_lookup(reg, name, &dev);
+	if (!len)
+		return RFCTL_ERR_NAME;
+	if ((size_t)len > num)
+		return RFCTL_ERR_NOSPC;
+
+	for (i = 0; i < len; i++) {
+		const struct reg_device *d = &reg->dev[dev[i]];
+
+		cmd[i].protocol = d->protocol;
+		cmd[i].level    = level;
+		if (rf_address(d->protocol, d->group, d->channel, &cmd[i].address, &cmd[i].unit))
+			return RFCTL_ERR_ARGS;
+	}
+
+	return len;
+}
+
+void rfctl_registry_free(rfctl_registry_t *reg)
+{
+	if (!reg)
+		return;
+
+	registry_free(reg);
+	free(reg);
+}
+
+rfctl_t *rfctl_open(const char *iface, const char *device, int *err)
+{
+	rf_interface_t type;
+	rfctl_t *rf;
+	int rc = RFCTL_OK;
+
+	type = iface ? rf_interface(iface) : IFC_RFCTL;
+	if (type == IFC_UNKNOWN) {
+		rc = RFCTL_ERR_IFACE;
+		goto fail;
+	}
+
+	rf = malloc(sizeof(*rf));
+	if (!rf) {
+		rc = RFCTL_ERR_NOMEM;
+		goto fail;
+	}
+
+	if (iface_open(&rf->ifc, type, device ? device : DEFAULT_DEVICE)) {
+		free(rf);
+		rc = RFCTL_ERR_OPEN;
+		goto fail;
+	}
+
+	return rf;
+fail:
+	if (err)
+		*err = rc;
+
+	return NULL;
+}
+
+int rfctl_send(rfctl_t *rf, const int32_t *bitstream, int len, int repeat)
+{
+	if (!rf || !bitstream || len <= 0 || repeat <= 0)
+		return RFCTL_ERR_ARGS;
+
+	if (iface_send(&rf->ifc, bitstream, len, repeat))
+		return RFCTL_ERR_IO;
+
+	return RFCTL_OK;
+}
+
+int rfctl_flush(rfctl_t *rf)
+{
+	if (!rf)
+		return RFCTL_ERR_ARGS;
+
+	if (iface_flush(&rf->ifc))
+		return RFCTL_ERR_IO;
+
+	return RFCTL_OK;
+}
+
+int rfctl_close(rfctl_t *rf)
+{
+	int rc = RFCTL_OK;
+
+	if (!rf)
+		return RFCTL_ERR_ARGS;
+
+	if (iface_close(&rf->ifc))
+		rc = RFCTL_ERR_IO;
+	free(rf);
+
+	return rc;
+}
+
+int rfctl_decode(const int32_t *edges, size_t len, struct rfctl_cmd *cmd)
+{
+	if (!edges || !cmd)
+		return RFCTL_ERR_ARGS;
+
+	return rf_decode(edges, len, cmd);
+}
+
+const char *rfctl_strerror(int err)
+{
+	switch (err) {
+	case RFCTL_OK:
+		return "Success";
+	case RFCTL_ERR_ARGS:
+		return "Invalid group, channel or level";
+	case RFCTL_ERR_PROTOCOL:
+		return "Unknown or unsupported protocol";
+	case RFCTL_ERR_NOSPC:
+		return "Buffer too small";
+	case RFCTL_ERR_IFACE:
+		return "Unknown interface type";
+	case RFCTL_ERR_OPEN:
+		return "Failed opening device";
+	case RFCTL_ERR_IO:
+		return "Failed writing to device";
+	case RFCTL_ERR_NOMEM:
+		return "Out of memory";
+	case RFCTL_ERR_NAME:
+		return "Unknown device or group name";
+	case RFCTL_ERR_REGISTRY:
+		return "Failed loading registry";
+	}
+
+	return "Unknown error";
+}
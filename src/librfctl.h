@@ -0,0 +1,139 @@
+/* Control tool for NEXA and other RF remote receivers
+ *
+ * Copyright (C) 2010, 2012  Tord Andersson <tord.andersson@endian.se>
+ * Copyright (C) 2017        Joachim Nilsson <troglobit@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, visit the Free Software Foundation
+ * website at http://www.gnu.org/licenses/gpl-2.0.html or write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef LIBRFCTL_H_
+#define LIBRFCTL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Error codes, all functions return 0 or a positive value on success
+ * and one of these on failure.  They never print anything.
+ */
+#define RFCTL_OK             0
+#define RFCTL_ERR_ARGS      -1	/* Invalid group, channel or level */
+#define RFCTL_ERR_PROTOCOL  -2	/* Unknown or unsupported protocol */
+#define RFCTL_ERR_NOSPC     -3	/* Caller's buffer too small */
+#define RFCTL_ERR_IFACE     -4	/* Unknown interface type */
+#define RFCTL_ERR_OPEN      -5	/* Failed opening device, see errno */
+#define RFCTL_ERR_IO        -6	/* Failed writing to device, see errno */
+#define RFCTL_ERR_NOMEM     -7
+#define RFCTL_ERR_NAME      -8	/* Unknown device or group name */
+#define RFCTL_ERR_REGISTRY  -9	/* Failed loading registry file */
+
+/* Protocols, for use with struct rfctl_cmd */
+#define RFCTL_PROTO_UNKNOWN  0
+#define RFCTL_PROTO_RAW      1
+#define RFCTL_PROTO_NEXA     2
+#define RFCTL_PROTO_PROOVE   3
+#define RFCTL_PROTO_NEXA_L   4
+#define RFCTL_PROTO_SARTANO  5
+#define RFCTL_PROTO_CONRAD   6
+#define RFCTL_PROTO_WAVEMAN  7
+#define RFCTL_PROTO_IKEA     8
+#define RFCTL_PROTO_ESIC     9
+#define RFCTL_PROTO_IMPULS   10
+
+/*
+ * One already parsed command for rfctl_encode_batch():
+ *
+ *   NEXA, WAVEMAN : address is house 0..15 (A..P), unit is 1..16
+ *   NEXA_L        : address is the 26-bit remote ID, unit is 1..16, or
+ *                   0 for all units learned to the ID (group)
+ *   SARTANO, IMPULS: address is the 10-bit code, first dip switch is
+ *                    the most significant bit, unit is not used
+ *   CONRAD        : address is group 1..4, unit is channel 1..4
+ *   IKEA          : address is system 1..16, unit is channel 1..10
+ *
+ * For all of these level is 0 for off and 1 for on, NEXA_L can also
+ * dim with a level of 2..100.  IKEA can dim with a level of 10..100 in
+ * steps of 10, with smooth fade.
+ */
+struct rfctl_cmd {
+	int      protocol;
+	uint32_t address;
+	int      unit;
+	int      level;
+};
+
+/* An open interface, e.g. /dev/rfctl or a CUL stick */
+typedef struct rfctl rfctl_t;
+
+/* Device registry, see rfctl(1) for the file format */
+typedef struct registry rfctl_registry_t;
+
+/*
+ * The library is built with hidden visibility, only the API below is
+ * exported from librfctl.so.
+ */
+#ifdef __GNUC__
+#pragma GCC visibility push(default)
+#endif
+
+/*
+ * Encode one command into the caller's buffer of @len elements.
+ * Returns the number of LIRC mode2 elements in @bitstream, and how
+ * many times the frame should be sent in @repeat.
+ */
+int         rfctl_encode   (const char *protocol, const char *group, const char *channel,
+			    const char *level, int32_t *bitstream, size_t len, int *repeat);
+
+/*
+ * Encode @num commands, with all repeats and sync gaps, back-to-back
+ * into @bitstream of @len elements, ready to be sent with one write.
+ * Returns total number of elements.
+ */
+int         rfctl_encode_batch(const struct rfctl_cmd *cmd, size_t num,
+			       int32_t *bitstream, size_t len);
+
+/*
+ * Load registry of device and group names, NULL @file for the default.
+ * rfctl_resolve() expands a name to at most @num commands in @cmd, all
+ * with the given @level, ready for rfctl_encode_batch().  Returns the
+ * number of devices.
+ */
+rfctl_registry_t *rfctl_registry_load(const char *file, int *err);
+int         rfctl_resolve  (const rfctl_registry_t *reg, const char *name, int level,
+			    struct rfctl_cmd *cmd, size_t num);
+void        rfctl_registry_free(rfctl_registry_t *reg);
+
+/* Open interface "RFCTL", "CUL", or "TELLSTICK" on @device */
+rfctl_t    *rfctl_open     (const char *iface, const char *device, int *err);
+int         rfctl_send     (rfctl_t *rf, const int32_t *bitstream, int len, int repeat);
+int         rfctl_flush    (rfctl_t *rf);
+int         rfctl_close    (rfctl_t *rf);
+
+/*
+ * Decode the first frame found in @len received LIRC mode2 elements.
+ * Returns the number of elements up to and including the frame, or 0
+ * if there is no complete frame in @edges.
+ */
+int         rfctl_decode   (const int32_t *edges, size_t len, struct rfctl_cmd *cmd);
+
+const char *rfctl_strerror (int err);
+
+#ifdef __GNUC__
+#pragma GCC visibility pop
+#endif
+
+#endif /* LIBRFCTL_H_ */
@@ -0,0 +1,327 @@
+/* Control tool for NEXA and other RF remote receivers
+ *
+ * Copyright (C) 2010, 2012  Tord Andersson <tord.andersson@endian.se>
+ * Copyright (C) 2017        Joachim Nilsson <troglobit@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, visit the Free Software Foundation
+ * website at http://www.gnu.org/licenses/gpl-2.0.html or write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "common.h"
+#include "logic.h"
+
+#define LOGIC_META 65536	/* Max size of session metadata */
+
+/* Parse sample rate, '24 MHz' as in sigrok sessions, '24M', or '24000000' */
+uint64_t logic_rate(const char *str)
+{
+	double val;
+	char *end;
+
+	val = strtod(str, &end);
+	while (*end == ' ')
+		end++;
+
+	switch (toupper(*end)) {
+	case 'G':
+		val *= 1e9;
+		end++;
+		break;
+
+	case 'M':
+		val *= 1e6;
+		end++;
+		break;
+
+	case 'K':
+		val *= 1e3;
+		end++;
+		break;
+	}
+
+	if ((*end && strcasecmp(end, "Hz")) || val < 1)
+		return 0;
+
+	return val + 0.5;
+}
+
+/* A sigrok session is a zip archive */
+bool logic_session(const char *path)
+{
+	char magic[4];
+	int fd;
+	bool rc;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return false;
+	rc = read(fd, magic, sizeof(magic)) == sizeof(magic) && !memcmp(magic, "PK\3\4", 4);
+	close(fd);
+
+	return rc;
+}
+
+/* Sample rate, unit size and name of sample files, from [device 1] */
+static int metadata(struct logic *lg)
+{
+	char *buf, *line, *next;
+	int probes = 0;
+	bool device = false;
+	ssize_t len, num;
+
+	buf = malloc(LOGIC_META);
+	if (!buf)
+		return -1;
+
+	if (unzip_member(lg->zip, "metadata"))
+		goto fail;
+	for (len = 0; len < LOGIC_META - 1; len += num) {
+		num = unzip_read(lg->zip, &buf[len], LOGIC_META - 1 - len);
+		if (num < 0)
+			goto fail;
+		if (num == 0)
+			break;
+	}
+	buf[len] = 0;
+
+	for (line = buf; line; line = next) {
+		char *val;
+
+		next = strchr(line, '\n');
+		if (next)
+			*next++ = 0;
+
+		if (line[0] == '[') {
+			device = !strncmp(line, "[device 1]", 10);
+			continue;
+		}
+		val = strchr(line, '=');
+		if (!device || !val)
+			continue;
+		*val++ = 0;
+
+		if (!strcmp(line, "samplerate"))
+			lg->rate = logic_rate(val);
+		else if (!strcmp(line, "unitsize"))
+			lg->unitsize = atoi(val);
+		else if (!strcmp(line, "total probes"))
+			probes = atoi(val);
+		else if (!strcmp(line, "capturefile"))
+			snprintf(lg->file, sizeof(lg->file), "%s", val);
+	}
+	free(buf);
+
+	if (!lg->rate || lg->unitsize < 1 || lg->unitsize > 8 || !lg->file[0] ||
+	    (probes && lg->probe >= probes)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	return 0;
+fail:
+	free(buf);
+	return -1;
+}
+
+/* Next samples, from the session's sample files in order, 0 at the end */
+static ssize_t refill(struct logic *lg)
+{
+	char name[80];
+	ssize_t num;
+
+	/* Keep a partial sample */
+	memmove(lg->buf, &lg->buf[lg->pos], lg->len - lg->pos);
+	lg->len -= lg->pos;
+	lg->pos  = 0;
+
+	while (1) {
+		if (lg->fd >= 0)
+			num = read(lg->fd, &lg->buf[lg->len], sizeof(lg->buf) - lg->len);
+		else
+			num = unzip_read(lg->zip, &lg->buf[lg->len], sizeof(lg->buf) - lg->len);
+		if (num != 0 || lg->fd >= 0)
+			break;
+
+		/* Sessions have logic-1-1, logic-1-2 ..., or just logic-1 */
+		snprintf(name, sizeof(name), "%s-%d", lg->file, ++lg->chunk);
+		if (!unzip_member(lg->zip, name))
+			continue;
+		if (errno == ENOENT && lg->chunk == 1 && !unzip_member(lg->zip, lg->file))
+			continue;
+		if (errno != ENOENT)
+			num = -1;
+		break;
+	}
+	if (num < 0)
+		lg->error = true;
+	if (num > 0)
+		lg->len += num;
+
+	return num;
+}
+
+/* Time of sample @s since the first, without overflow for days at GHz */
+static int64_t usec(const struct logic *lg, uint64_t s)
+{
+	return (s / lg->rate) * 1000000 + (s % lg->rate) * 1000000 / lg->rate;
+}
+
+/* Run of @level from @from to @to us, longer ones are cut short */
+static int32_t run(int level, int64_t from, int64_t to)
+{
+	int64_t len = to - from;
+
+	if (len > LIRC_VALUE_MASK)
+		len = LIRC_VALUE_MASK;
+
+	return level ? LIRC_PULSE(len) : LIRC_SPACE(len);
+}
+
+/*
+ * Level changes at sample @s.  A run shorter than 1 us is dropped,
+ * the one before it then continues.  Otherwise the run before it can
+ * be handed on, and this one is pending until the next change.
+ */
+static void change(struct logic *lg, int level, uint64_t s, int32_t *buf, int *num)
+{
+	int64_t now = usec(lg, s);
+
+	if (lg->level < 0) {
+		lg->edge = lg->mark = now;
+	} else if (now == lg->edge) {
+		if (lg->pend) {
+			lg->edge = lg->mark;
+			lg->pend = 0;
+		}
+	} else {
+		if (lg->pend)
+			buf[(*num)++] = lg->pend;
+		lg->pend = run(lg->level, lg->edge, now);
+		lg->mark = lg->edge;
+		lg->edge = now;
+	}
+	lg->level = level;
+}
+
+/*
+ * Open a sigrok session, or with @rate a raw dump of samples, @unitsize
+ * bytes each, least significant first.  Probes count from 1.
+ */
+int logic_open(struct logic *lg, const char *path, uint64_t rate, int unitsize, int probe)
+{
+	struct stat sb;
+	int err;
+
+	memset(lg, 0, sizeof(*lg));
+	lg->fd    = -1;
+	lg->level = -1;
+	lg->probe = probe - 1;
+	if (probe < 1 || probe > 64) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (stat(path, &sb))
+		return -1;
+	lg->start = (int64_t)sb.st_mtime * 1000000;
+
+	if (rate) {
+		if (unitsize < 1 || unitsize > 8 || probe > unitsize * 8) {
+			errno = EINVAL;
+			return -1;
+		}
+		lg->rate     = rate;
+		lg->unitsize = unitsize;
+		lg->fd = open(path, O_RDONLY);
+
+		return lg->fd < 0 ? -1 : 0;
+	}
+
+	lg->zip = malloc(sizeof(*lg->zip));
+	if (!lg->zip)
+		return -1;
+	if (unzip_open(lg->zip, path) || metadata(lg))
+		goto fail;
+	if (probe > lg->unitsize * 8) {
+		errno = EINVAL;
+		goto fail;
+	}
+
+	/* Done with metadata, the first sample file is opened by refill() */
+	lg->zip->in = lg->zip->end = NULL;
+	lg->zip->method = 0;
+
+	return 0;
+fail:
+	err = errno;
+	logic_close(lg);
+	errno = err;
+
+	return -1;
+}
+
+void logic_close(struct logic *lg)
+{
+	if (lg->fd >= 0)
+		close(lg->fd);
+	if (lg->zip) {
+		unzip_close(lg->zip);
+		free(lg->zip);
+	}
+	lg->fd  = -1;
+	lg->zip = NULL;
+}
+
+int rx_from_logic(void *arg, int32_t *buf, int max, int64_t *time)
+{
+	struct logic *lg = arg;
+	int bit = lg->probe % 8, byte = lg->probe / 8;
+	int num = 0;
+
+	if (lg->done)
+		return -1;
+
+	*time = lg->start + lg->mark;
+	while (num < max - 1) {
+		int level;
+
+		if (lg->len - lg->pos < (size_t)lg->unitsize && refill(lg) <= 0) {
+			int64_t now = usec(lg, lg->sample);
+
+			if (lg->pend)
+				buf[num++] = lg->pend;
+			if (lg->level >= 0 && now > lg->edge)
+				buf[num++] = run(lg->level, lg->edge, now);
+			lg->done = true;
+			break;
+		}
+		if (lg->len - lg->pos < (size_t)lg->unitsize)
+			continue;
+
+		level = (lg->buf[lg->pos + byte] >> bit) & 1;
+		lg->pos += lg->unitsize;
+		if (level != lg->level)
+			change(lg, level, lg->sample, buf, &num);
+		lg->sample++;
+	}
+
+	return num ? num : -1;
+}
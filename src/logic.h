@@ -0,0 +1,70 @@
+/* Control tool for NEXA and other RF remote receivers
+ *
+ * Copyright (C) 2010, 2012  Tord Andersson <tord.andersson@endian.se>
+ * Copyright (C) 2017        Joachim Nilsson <troglobit@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, visit the Free Software Foundation
+ * website at http://www.gnu.org/licenses/gpl-2.0.html or write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef RFCTL_LOGIC_H_
+#define RFCTL_LOGIC_H_
+
+#include "protocol.h"
+#include "unzip.h"
+
+#define LOGIC_CHUNK 65536	/* Bytes of samples read at a time */
+
+/*
+ * Logic analyzer capture as a source of received elements, either a
+ * sigrok session or a raw dump of samples at a known rate.  Samples are
+ * streamed in chunks, level changes of one probe become pulses (high)
+ * and spaces (low).  Their times are rounded to us from the sample
+ * count, so there is no drift, and levels shorter than 1 us are dropped.
+ * Neither format has the time of the capture, the file time is used.
+ */
+struct logic {
+	int            fd;		/* Raw dump, or -1 */
+	struct unzip  *zip;		/* sigrok session, or NULL */
+	char           file[64];	/* Session member prefix, 'logic-1' */
+	int            chunk;		/* Member being read */
+
+	uint64_t       rate;		/* Samples per second */
+	int            unitsize;	/* Bytes per sample */
+	int            probe;		/* Bit in sample, from 0 */
+
+	uint8_t        buf[LOGIC_CHUNK];
+	size_t         pos, len;
+
+	uint64_t       sample;		/* Samples read */
+	int            level;		/* Of current run, -1 before first sample */
+	int64_t        edge;		/* Start of current run, us */
+	int32_t        pend;		/* Previous run, until current is >= 1 us */
+	int64_t        mark;		/* Start of pending run, us */
+	int64_t        start;		/* Wall-clock time of first sample, us */
+	bool           done;
+	bool           error;
+};
+
+uint64_t logic_rate    (const char *str);
+bool     logic_session (const char *path);
+int      logic_open    (struct logic *lg, const char *path, uint64_t rate, int unitsize,
+			int probe);
+void     logic_close   (struct logic *lg);
+
+int      rx_from_logic (void *arg, int32_t *buf, int max, int64_t *time);
+
+#endif /* RFCTL_LOGIC_H_ */
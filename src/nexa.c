@@ -23,31 +23,22 @@
 #include "common.h"
 #include "protocol.h"
 
-static int bs(const char *group, const char *chan, const char *onoff, int32_t *bitstream, int *repeat, bool waveman)
+/*
+ * Encode one frame from already parsed house 0..15, channel 0..15 and
+ * on/off, returns number of elements, or 0 on invalid arguments.
+ */
+int nexa_frame(int house, int channel, int enable, bool waveman, int32_t *bitstream)
 {
-	int house;
-	int channel;
-	int enable;
 	int code = 0;
 	const int unknown = 0x6;
 	int bit;
 	int bitmask = 0x0001;
 	int i = 0;
 
-	*repeat = NEXA_REPEAT;
-
-	house   = (int)((*group) - 65);	/* House 'A'..'P' */
-	channel = atoi(chan) - 1;	/* Channel 1..16 */
-	enable  = atoi(onoff);		/* ON/OFF 0..1 */
-
-	PRINT("House: %d, channel: %d, on_off: %d\n", house, channel, enable);
-
 	/* check converted parameters for validity */
 	if ((house < 0) || (house > 15) ||	// House 'A'..'P'
-	    (channel < 0) || (channel > 15) || (enable < 0) || (enable > 1)) {
-		fprintf(stderr, "Invalid group (house), channel or on/off code\n");
+	    (channel < 0) || (channel > 15) || (enable < 0) || (enable > 1))
 		return 0;
-	}
 
 	/*
 	 * b0..b11 code where 'X' will be represented by 1 for simplicity.
@@ -87,6 +78,21 @@ static int bs(const char *group, const char *chan, const char *onoff, int32_t *b
 	return i;
 }
 
+static int bs(const char *group, const char *chan, const char *onoff, int32_t *bitstream, int *repeat, bool waveman)
+{
+	int house;
+	int channel;
+	int enable;
+
+	*repeat = NEXA_REPEAT;
+
+	house   = (int)((*group) - 65);	/* House 'A'..'P' */
+	channel = atoi(chan) - 1;	/* Channel 1..16 */
+	enable  = atoi(onoff);		/* ON/OFF 0..1 */
+
+	return nexa_frame(house, channel, enable, waveman, bitstream);
+}
+
 int nexa_bitstream(const char *house, const char *chan, const char *onoff, int32_t *bitstream, int *repeat)
 {
 	return bs(house, chan, onoff, bitstream, repeat, false);
@@ -96,3 +102,171 @@ int waveman_bitstream(const char *house, const char *chan, const char *onoff, in
 {
 	return bs(house, chan, onoff, bitstream, repeat, true);
 }
+
+/* One physical bit, the self-learning protocol is all short pulses */
+static int nexa_l_bit(int bit, int32_t *bitstream)
+{
+	bitstream[0] = LIRC_PULSE(NEXA_L_PERIOD);
+	bitstream[1] = LIRC_SPACE(bit ? NEXA_L_LONG_PERIOD : NEXA_L_PERIOD);
+
+	return 2;
+}
+
+/* Logical bits are sent as 01 and 10, MSB first */
+static int nexa_l_bits(uint32_t val, int num, int32_t *bitstream)
+{
+	int i = 0;
+
+	while (num--) {
+		int bit = (val >> num) & 1;
+
+		i += nexa_l_bit(bit, &bitstream[i]);
+		i += nexa_l_bit(!bit, &bitstream[i]);
+	}
+
+	return i;
+}
+
+/*
+ * Encode one NEXA self-learning frame: 26-bit remote ID, group bit, on
+ * or off, unit 0..15 and, for dimming, a 4-bit absolute level.  With
+ * the group bit set all units learned to the ID act on the frame.
+ * Level is 0 for off, 1 for on, and 2..100 to dim.  Returns number of
+ * elements, or 0 on invalid arguments.
+ */
+int nexa_l_frame(uint32_t id, bool group, int unit, int level, int32_t *bitstream)
+{
+	int i = 0;
+
+	if (id > NEXA_L_MAX_ID || unit < 0 || unit > 15 || level < 0 || level > 100)
+		return 0;
+
+	bitstream[i++] = LIRC_PULSE(NEXA_L_PERIOD);
+	bitstream[i++] = LIRC_SPACE(NEXA_L_SYNC_PERIOD);
+
+	i += nexa_l_bits(id, 26, &bitstream[i]);
+	i += nexa_l_bits(group, 1, &bitstream[i]);
+	if (level > 1) {
+		/* Dim is neither on nor off, both physical bits are 0 */
+		i += nexa_l_bit(0, &bitstream[i]);
+		i += nexa_l_bit(0, &bitstream[i]);
+	} else {
+		i += nexa_l_bits(level, 1, &bitstream[i]);
+	}
+	i += nexa_l_bits(unit, 4, &bitstream[i]);
+	if (level > 1)
+		i += nexa_l_bits((level * 15 + 50) / 100, 4, &bitstream[i]);
+
+	bitstream[i++] = LIRC_PULSE(NEXA_L_PERIOD);
+	bitstream[i++] = LIRC_SPACE(NEXA_L_PAUSE_PERIOD);
+
+	return i;
+}
+
+/* ID is decimal, or hex with 0x prefix, channel 1..16 or 'all' */
+int nexa_l_bitstream(const char *serial, const char *chan, const char *level, int32_t *bitstream, int *repeat)
+{
+	unsigned long id;
+	char *end;
+	int unit = 0;
+	bool group;
+
+	*repeat = NEXA_L_REPEAT;
+
+	id = strtoul(serial, &end, 0);
+	if (end == serial || *end || id > NEXA_L_MAX_ID)
+		return 0;
+
+	group = !strcmp(chan, "all");
+	if (!group) {
+		unit = atoi(chan) - 1;
+		if (unit < 0)
+			return 0;
+	}
+
+	return nexa_l_frame(id, group, unit, atoi(level), bitstream);
+}
+
+#define NEXA_L_SHORT RF_SYM(RF_CLASS_NEXA_L, RF_SYM_SHORT)
+#define NEXA_L_LONG  RF_SYM(RF_CLASS_NEXA_L, RF_SYM_LONG)
+#define NEXA_L_SYNC  RF_SYM(RF_CLASS_NEXA_L, RF_SYM_SYNC)
+
+/* Physical bit at @sym, -1 if not a short pulse and a bit space */
+static int nexa_l_phys(const uint16_t *sym)
+{
+	if ((sym[0] & (RF_SYM_PULSE | NEXA_L_SHORT)) != (RF_SYM_PULSE | NEXA_L_SHORT) ||
+	    !(sym[1] & RF_SYM_SPACE))
+		return -1;
+	if (sym[1] & NEXA_L_SHORT)
+		return 0;
+	if (sym[1] & NEXA_L_LONG)
+		return 1;
+
+	return -1;
+}
+
+/*
+ * Decode one self-learning frame starting with the sync at @edges, the
+ * inverse of nexa_l_frame().  @sym holds their rf_classify() codes.
+ * Returns number of elements used, or 0 if this is not a valid frame.
+ */
+int nexa_l_decode(const int32_t *edges, const uint16_t *sym, int len, struct rfctl_cmd *cmd)
+{
+	uint32_t val = 0;
+	int dim = 0, level = 0;
+	int bit, i;
+
+	if (len < NEXA_L_FRAME_LEN || !(sym[0] & RF_SYM_PULSE) || !(sym[1] & NEXA_L_SYNC))
+		return 0;
+
+	i = 2;
+	for (bit = 0; bit < 32; bit++, i += 4) {
+		int a = nexa_l_phys(&sym[i]);
+		int b = nexa_l_phys(&sym[i + 2]);
+
+		if (a < 0 || b < 0)
+			return 0;
+		if (bit == 27 && !a && !b) {
+			dim = 1;
+			continue;
+		}
+		if (a == b)
+			return 0;
+
+		if (bit == 27)
+			level = a;
+		else
+			val = (val << 1) | a;
+	}
+
+	if (dim) {
+		int lvl = 0;
+
+		if (len < i + 18)
+			return 0;
+		for (bit = 0; bit < 4; bit++, i += 4) {
+			int a = nexa_l_phys(&sym[i]);
+			int b = nexa_l_phys(&sym[i + 2]);
+
+			if (a < 0 || b < 0 || a == b)
+				return 0;
+			lvl = (lvl << 1) | a;
+		}
+
+		/* Inverse of the encoder, 2..100 */
+		level = (lvl * 100 + 7) / 15;
+		if (level < 2)
+			level = 2;
+	}
+
+	/* Stop pulse and pause, may be cut short by the receiver */
+	if (!(sym[i] & RF_SYM_PULSE))
+		return 0;
+
+	cmd->protocol = PROT_NEXA_L;
+	cmd->address  = val >> 5;
+	cmd->unit     = val & 0x10 ? 0 : (val & 0xF) + 1;
+	cmd->level    = level;
+
+	return i + 2;
+}
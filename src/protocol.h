@@ -23,6 +23,8 @@
 #ifndef RFCTL_PROTOCOL_H_
 #define RFCTL_PROTOCOL_H_
 
+#include "librfctl.h"
+
 #define DEFAULT_DEVICE "/dev/rfctl"
 
 #define RF_MAX_TX_BITS 4000	/* Max TX pulse/space elements in one message */
@@ -42,17 +44,17 @@ typedef enum {
 } rf_interface_t;
 
 typedef enum {
-	PROT_UNKNOWN,
-	PROT_RAW,
-	PROT_NEXA,
-	PROT_PROOVE,
-	PROT_NEXA_L,
-	PROT_SARTANO,
-	PROT_CONRAD,
-	PROT_WAVEMAN,
-	PROT_IKEA,
-	PROT_ESIC,
-	PROT_IMPULS
+	PROT_UNKNOWN = RFCTL_PROTO_UNKNOWN,
+	PROT_RAW     = RFCTL_PROTO_RAW,
+	PROT_NEXA    = RFCTL_PROTO_NEXA,
+	PROT_PROOVE  = RFCTL_PROTO_PROOVE,
+	PROT_NEXA_L  = RFCTL_PROTO_NEXA_L,
+	PROT_SARTANO = RFCTL_PROTO_SARTANO,
+	PROT_CONRAD  = RFCTL_PROTO_CONRAD,
+	PROT_WAVEMAN = RFCTL_PROTO_WAVEMAN,
+	PROT_IKEA    = RFCTL_PROTO_IKEA,
+	PROT_ESIC    = RFCTL_PROTO_ESIC,
+	PROT_IMPULS  = RFCTL_PROTO_IMPULS
 } rf_protocol_t;
 
 #define LIRC_MODE2_SPACE     0x00000000
@@ -73,23 +75,160 @@ typedef enum {
 #define LIRC_IS_PULSE(val)   (LIRC_MODE2(val) == LIRC_MODE2_PULSE)
 #define LIRC_IS_TIMEOUT(val) (LIRC_MODE2(val) == LIRC_MODE2_TIMEOUT)
 
+#define TELLSTICK_TICK         10	/* microseconds per byte value */
+#define TELLSTICK_MAX_TICK     255
+#define TELLSTICK_MAX_PULSES   255	/* Max pulse/space elements in one command */
+#define TELLSTICK_BUF_LEN      512	/* Max bytes in one serial transaction */
+#define TELLSTICK_ACK_TIMEOUT  5000	/* milliseconds */
+
 #define NEXA_SHORT_PERIOD    340	/* microseconds */
 #define NEXA_LONG_PERIOD     1020	/* microseconds */
 #define NEXA_SYNC_PERIOD     (32 * NEXA_SHORT_PERIOD)	/* between frames */
 #define NEXA_REPEAT          4
 
+#define NEXA_L_PERIOD        250	/* microseconds */
+#define NEXA_L_LONG_PERIOD   (5 * NEXA_L_PERIOD)
+#define NEXA_L_SYNC_PERIOD   (10 * NEXA_L_PERIOD)
+#define NEXA_L_PAUSE_PERIOD  (40 * NEXA_L_PERIOD)	/* between frames */
+#define NEXA_L_REPEAT        5
+#define NEXA_L_MAX_ID        0x3FFFFFF	/* 26 bits */
+#define NEXA_L_FRAME_LEN     132	/* Elements, without dim level */
+
 #define SARTANO_SHORT_PERIOD 320	/* microseconds */
 #define SARTANO_LONG_PERIOD  960	/* microseconds */
 #define SARTANO_SYNC_PERIOD  (32 * SARTANO_SHORT_PERIOD)	/* between frames */
 #define SARTANO_REPEAT       5
 
+#define IKEA_SHORT_PERIOD    840	/* microseconds */
+#define IKEA_LONG_PERIOD     1700	/* microseconds */
+#define IKEA_SYNC_PERIOD     (12 * IKEA_SHORT_PERIOD)	/* between frames */
+#define IKEA_REPEAT          5
+
+#define RF_MAX_FRAME_BITS    256	/* Max elements in one frame, without repeats */
+
+/*
+ * Pulse width classes, rf_classify() sets one bit in the code of each
+ * element for every protocol window its duration falls in, so windows
+ * of different protocols may overlap.  Decoders test the bits of their
+ * own protocol, e.g. RF_SYM(RF_CLASS_NEXA_L, RF_SYM_SHORT).
+ */
+enum {
+	RF_CLASS_NEXA,
+	RF_CLASS_NEXA_L,
+	RF_CLASS_SARTANO,
+	RF_CLASS_IKEA,
+	RF_CLASSES
+};
+
+#define RF_SYM_SHORT         0
+#define RF_SYM_LONG          1
+#define RF_SYM_SYNC          2
+#define RF_SYM(class, sym)   (1 << ((class) * 3 + (sym)))
+#define RF_SYM_PULSE         0x1000
+#define RF_SYM_SPACE         0x2000
+#define RF_WINDOWS           16	/* Room for all classes, unused never match */
+
+/* Duration windows, lo <= usec < hi, in RF_SYM() bit order */
+struct rf_windows {
+	int32_t lo[RF_WINDOWS];
+	int32_t hi[RF_WINDOWS];
+};
+
+rf_protocol_t  rf_protocol  (const char *name);
+const char    *rf_protocol_name (rf_protocol_t protocol);
+rf_interface_t rf_interface (const char *name);
+int rf_encode         (rf_protocol_t protocol, const char *group, const char *channel, const char *level,
+		       int32_t *bitstream, int *repeat);
+
+int rf_address        (rf_protocol_t protocol, const char *group, const char *channel,
+		       uint32_t *address, int *unit);
+int rf_frame          (rf_protocol_t protocol, uint32_t address, int unit, int level,
+		       int32_t *bitstream, int *repeat);
+
+/*
+ * Adaptive windows of one receiver.  A decaying histogram of durations
+ * in frames decoded as NEXA_L is clustered into short and long levels,
+ * and the NEXA_L windows moved to match, within RF_ADAPT_DRIFT of the
+ * nominal periods.  Only NEXA_L is decoded, so the other classes keep
+ * their nominal windows.
+ */
+#define RF_ADAPT_BIN         16	/* us per histogram bin */
+#define RF_ADAPT_BINS        256
+#define RF_ADAPT_MIN         32	/* Samples per level before it is trusted */
+#define RF_ADAPT_DECAY       4096	/* Samples between halving the histogram */
+#define RF_ADAPT_DRIFT       50	/* Max percent from nominal */
+
+struct rf_adapt {
+	uint32_t          hist[RF_ADAPT_BINS];
+	uint32_t          samples;
+	int32_t           level[2];	/* Learned short and long, 0 if not */
+	struct rf_windows win;
+};
+
+void rf_windows_init  (struct rf_windows *win);
+void rf_classify      (const struct rf_windows *win, const int32_t *edges, int len, uint16_t *sym);
+void rf_classify_scalar(const struct rf_windows *win, const int32_t *edges, int len, uint16_t *sym);
+
+void rf_adapt_init    (struct rf_adapt *ad);
+void rf_adapt_frame   (struct rf_adapt *ad, rf_protocol_t protocol, const int32_t *edges, int len);
+void rf_adapt_nominal (int32_t *s, int32_t *l);
+
+int rf_decode         (const int32_t *edges, int len, struct rfctl_cmd *cmd);
+int rf_decode_sym     (const int32_t *edges, const uint16_t *sym, int len, struct rfctl_cmd *cmd);
+bool rf_decodable     (rf_protocol_t protocol);
+
+int nexa_frame        (int house, int channel, int enable, bool waveman, int32_t *bitstream);
+int nexa_l_frame      (uint32_t id, bool group, int unit, int level, int32_t *bitstream);
+int nexa_l_decode     (const int32_t *edges, const uint16_t *sym, int len, struct rfctl_cmd *cmd);
+int sartano_frame     (int code, int enable, int32_t *bitstream);
+int impulse_frame     (int code, int enable, int32_t *bitstream);
+int ikea_frame        (int system, int channel, int level, bool smooth, int32_t *bitstream);
+int sartano_code      (const char *chan);
+int conrad_code       (int group, int channel);
+
 int nexa_bitstream    (const char *house, const char *chan, const char *onoff, int32_t *bitstream, int *repeat);
 int waveman_bitstream (const char *house, const char *chan, const char *onoff, int32_t *bitstream, int *repeat);
+int nexa_l_bitstream  (const char *serial, const char *chan, const char *level, int32_t *bitstream, int *repeat);
 int sartano_bitstream (                   const char *chan, const char *onoff, int32_t *bitstream, int *repeat);
 int conrad_bitstream  (const char *house, const char *chan, const char *onoff, int32_t *bitstream, int *repeat);
 int impulse_bitstream (                   const char *chan, const char *onoff, int32_t *bitstream, int *repeat);
 int ikea_bitstream    (const char *house, const char *chan, const char *level, const char *dim_style, int32_t *bitstream, int *repeat);
 
-int bitstream2cul443  (int32_t *bitstream, int len, int repeat, char *cul);
+int bitstream2cul443  (const int32_t *bitstream, int len, int repeat, char *cul);
+int bitstream2tellstick(const int32_t *bitstream, int len, int repeat, char *cmd);
+
+#define CUL_RX_LINE_MAX 512	/* Max length of one line of CUL RX output */
+
+struct cul_rx {
+	char   line[CUL_RX_LINE_MAX];
+	size_t len;
+	bool   overflow;
+};
+
+void cul443_rx_init   (struct cul_rx *rx);
+int  cul443_rx_parse  (struct cul_rx *rx, const char *buf, size_t len, int32_t *edges, int max, size_t *used);
+
+/*
+ * An open TX/RX interface, the Tellstick batches commands in buf[]
+ * until it is full or iface_flush() is called.
+ */
+struct iface {
+	rf_interface_t type;
+	const char    *device;
+	int            fd;
+
+	char           buf[TELLSTICK_BUF_LEN];
+	size_t         len;
+	int            queued;
+
+	int            count;	/* Number of commands sent */
+	long long      usec;	/* Total time spent sending them */
+};
+
+int  iface_open       (struct iface *ifc, rf_interface_t type, const char *device);
+int  iface_send       (struct iface *ifc, const int32_t *bitstream, int len, int repeat);
+int  iface_send_frames(struct iface *ifc, const int32_t *frames, int len, int repeat);
+int  iface_flush      (struct iface *ifc);
+int  iface_close      (struct iface *ifc);
 
 #endif /* RFCTL_PROTOCOL_H_ */
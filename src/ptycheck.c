@@ -0,0 +1,243 @@
+/* Control tool for NEXA and other RF remote receivers
+ *
+ * Copyright (C) 2010, 2012  Tord Andersson <tord.andersson@endian.se>
+ * Copyright (C) 2017        Joachim Nilsson <troglobit@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, visit the Free Software Foundation
+ * website at http://www.gnu.org/licenses/gpl-2.0.html or write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Check of the serial interfaces against pty stand-ins, run by 'make
+ * check'.  A burst of commands routed to a Tellstick must go out in as
+ * few serial transactions as its buffer allows, and every command must
+ * be acknowledged, and if the stick goes away every command must be
+ * counted as failed, none as sent.  Also prints the time spent per command on each
+ * interface.  A pty has no baud rate, so this is the software path
+ * only, the time on air is the same for all three.
+ */
+#include <errno.h>
+#include <pty.h>
+#include <termios.h>
+
+#include "common.h"
+#include "router.h"
+
+#define BURST    20
+#define COMMANDS 200
+
+bool verbose = false;
+
+struct standin {
+	rf_interface_t type;
+	int            master;
+	int            slave;	/* Held open, or reads fail until opened */
+	bool           hangup;	/* Gone after the first transaction */
+	char           device[64];
+	pthread_t      thread;
+
+	int            reads;	/* Serial transactions */
+	int            commands;	/* Tellstick commands acknowledged */
+};
+
+/*
+ * Tellstick stand-in, acknowledges each command in a transaction, the
+ * P and R arguments may be any byte so they are skipped.  The CUL and
+ * rfctl.ko stand-ins only drain what is written.
+ */
+static void *standin_thread(void *arg)
+{
+	struct standin *s = arg;
+	char buf[1024];
+	int skip = 0;
+	ssize_t len;
+	int i;
+
+	while ((len = read(s->master, buf, sizeof(buf))) > 0) {
+		int acks = 0;
+
+		s->reads++;
+		if (s->hangup) {
+			close(s->master);
+			s->master = -1;
+			return NULL;
+		}
+		if (s->type != IFC_TELLSTICK)
+			continue;
+
+		for (i = 0; i < len; i++) {
+			if (skip) {
+				skip = 0;
+				continue;
+			}
+			if (buf[i] == 'P' || buf[i] == 'R')
+				skip = 1;
+			else if (buf[i] == '+')
+				acks++;
+		}
+
+		s->commands += acks;
+		while (acks--) {
+			if (write(s->master, "+S\r\n", 4) != 4)
+				return NULL;
+		}
+	}
+
+	return NULL;
+}
+
+static int standin_open(struct standin *s, rf_interface_t type)
+{
+	struct termios tio;
+
+	memset(s, 0, sizeof(*s));
+	s->type = type;
+	if (openpty(&s->master, &s->slave, s->device, NULL, NULL))
+		return -1;
+
+	/* Raw both ways, the interface sets up its own end when opened */
+	tcgetattr(s->master, &tio);
+	cfmakeraw(&tio);
+	tcsetattr(s->master, TCSANOW, &tio);
+	tcsetattr(s->slave, TCSANOW, &tio);
+
+	errno = pthread_create(&s->thread, NULL, standin_thread, s);
+	if (errno) {
+		close(s->slave);
+		close(s->master);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Let the stand-in catch up, the interface is closed by then */
+static void standin_close(struct standin *s)
+{
+	usleep(100000);
+	pthread_cancel(s->thread);
+	pthread_join(s->thread, NULL);
+	close(s->slave);
+	if (s->master >= 0)
+		close(s->master);
+}
+
+/*
+ * A burst of commands routed to a Tellstick goes out batched, or with
+ * @hangup, a Tellstick that goes away, all fail.
+ */
+static int check_burst(const int32_t *frame, int len, int repeat, bool hangup)
+{
+	char cmd[RF_MAX_TX_BITS * 6];
+	struct standin s;
+	struct router r;
+	int i, max, sent, failed, rc = 0;
+
+	if (standin_open(&s, IFC_TELLSTICK))
+		return -1;
+	s.hangup = hangup;
+
+	router_init(&r);
+	if (router_default(&r, IFC_TELLSTICK, s.device) || router_start(&r)) {
+		router_exit(&r);
+		standin_close(&s);
+		return -1;
+	}
+
+	for (i = 0; i < BURST; i++)
+		router_send(&r, PROT_NEXA, "D", "1", i & 1 ? "1" : "0", NULL);
+	router_wait(&r);
+	pthread_mutex_lock(&r.worker[0].lock);
+	sent = r.worker[0].count;
+	pthread_mutex_unlock(&r.worker[0].lock);
+	failed = router_exit(&r);
+	standin_close(&s);
+
+	if (hangup) {
+		printf("tellstick hangup: %d commands, %d sent, %d failed\n", BURST, sent, failed);
+		return sent || failed != BURST ? -1 : 0;
+	}
+	if (sent != BURST || failed)
+		rc = -1;
+
+	/* The first command may go out alone, before the rest are queued */
+	max = 1 + (BURST * bitstream2tellstick(frame, len, repeat, cmd) + TELLSTICK_BUF_LEN - 1) / TELLSTICK_BUF_LEN;
+	printf("tellstick burst: %d commands, %d acknowledged, %d transactions, max %d\n",
+	       BURST, s.commands, s.reads, max);
+	if (s.commands != BURST || s.reads > max)
+		rc = -1;
+
+	return rc;
+}
+
+/* Time per command, sent one by one or, @batch, flushed at the end */
+static int check_latency(rf_interface_t type, const char *name, bool batch,
+			 const int32_t *frame, int len, int repeat)
+{
+	struct standin s;
+	struct iface ifc;
+	int i, rc = 0;
+
+	if (standin_open(&s, type))
+		return -1;
+
+	if (iface_open(&ifc, type, s.device)) {
+		standin_close(&s);
+		return -1;
+	}
+
+	for (i = 0; i < COMMANDS && !rc; i++) {
+		rc = iface_send(&ifc, frame, len, repeat);
+		if (!rc && !batch)
+			rc = iface_flush(&ifc);
+	}
+	if (iface_close(&ifc))
+		rc = -1;
+	standin_close(&s);
+
+	if (ifc.count)
+		printf("%-16s %d commands, avg %lld us per command\n", name,
+		       ifc.count, ifc.usec / ifc.count);
+	if (ifc.count != COMMANDS || (type == IFC_TELLSTICK && s.commands != COMMANDS))
+		rc = -1;
+
+	return rc;
+}
+
+int main(void)
+{
+	int32_t frame[RF_MAX_TX_BITS];
+	int len, repeat;
+	int rc = 0;
+
+	len = rf_encode(PROT_NEXA, "D", "1", "1", frame, &repeat);
+	if (len <= 0)
+		return 1;
+
+	if (check_latency(IFC_RFCTL, "rfctl.ko", false, frame, len, repeat) ||
+	    check_latency(IFC_CUL, "cul", false, frame, len, repeat) ||
+	    check_latency(IFC_TELLSTICK, "tellstick", false, frame, len, repeat) ||
+	    check_latency(IFC_TELLSTICK, "tellstick batch", true, frame, len, repeat))
+		rc = 1;
+
+	if (check_burst(frame, len, repeat, false) ||
+	    check_burst(frame, len, repeat, true))
+		rc = 1;
+
+	printf("%s\n", rc ? "FAIL" : "PASS");
+
+	return rc;
+}
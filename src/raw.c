@@ -0,0 +1,351 @@
+/* Control tool for NEXA and other RF remote receivers
+ *
+ * Copyright (C) 2010, 2012  Tord Andersson <tord.andersson@endian.se>
+ * Copyright (C) 2017        Joachim Nilsson <troglobit@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, visit the Free Software Foundation
+ * website at http://www.gnu.org/licenses/gpl-2.0.html or write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+
+#include "common.h"
+#include "raw.h"
+#include "sched.h"
+
+/* Two chunks, one is sent while the other is read from file */
+struct stream {
+	struct raw      raw;
+	int32_t         buf[2][RAW_CHUNK];
+	int             len[2];
+	int             head;		/* Next chunk to send */
+	int             ready;		/* Chunks ready to send, 0..2 */
+	bool            done;
+	bool            stop;
+	int             err;		/* errno from reader */
+
+	pthread_mutex_t lock;
+	pthread_cond_t  cond;
+};
+
+/*
+ * Binary files are native LIRC mode2 elements, as read from and written
+ * to rfctl.ko, where the most significant byte is 0, 1, or 3.  That is
+ * never the case for the fourth character of a text file.  Files in the
+ * capture format, from 'rfctl -r -o FILE', are memory mapped instead.
+ */
+int raw_open(struct raw *raw, const char *file)
+{
+	memset(raw, 0, sizeof(*raw));
+
+	if (!strcmp(file, "-"))
+		raw->fp = stdin;
+	else
+		raw->fp = fopen(file, "r");
+	if (!raw->fp)
+		return -1;
+
+	raw->npeek = fread(raw->peek, 1, sizeof(raw->peek), raw->fp);
+	if (raw->npeek == 4 && !memcmp(raw->peek, CAPTURE_MAGIC, 4)) {
+		if (raw->fp == stdin) {
+			errno = EINVAL;
+			return -1;
+		}
+		fclose(raw->fp);
+		raw->fp = NULL;
+		raw->indexed = true;
+
+		return capture_open(&raw->cap, file);
+	}
+
+	if (raw->npeek == 4 && (raw->peek[3] == 0 || raw->peek[3] == 1 || raw->peek[3] == 3))
+		raw->binary = true;
+
+	return 0;
+}
+
+/*
+ * Text lines are 'pulse USEC' and 'space USEC', as from mode2(1), or
+ * '1 - USEC us' and '0 - USEC us' as from 'rfctl -r'.  Anything else,
+ * e.g. timeouts and comments, is skipped.
+ */
+static int text_next(struct raw *raw, int32_t *val)
+{
+	char line[128], word[16];
+	int usec;
+
+	while (1) {
+		if (raw->npeek) {
+			memcpy(line, raw->peek, raw->npeek);
+			if (!fgets(&line[raw->npeek], sizeof(line) - raw->npeek, raw->fp))
+				line[raw->npeek] = 0;
+			raw->npeek = 0;
+		} else if (!fgets(line, sizeof(line), raw->fp)) {
+			return ferror(raw->fp) ? -1 : 0;
+		}
+		raw->lineno++;
+
+		if (sscanf(line, "%15s %d", word, &usec) == 2 && usec > 0) {
+			if (!strcmp(word, "pulse")) {
+				*val = LIRC_PULSE(usec);
+				return 1;
+			}
+			if (!strcmp(word, "space")) {
+				*val = LIRC_SPACE(usec);
+				return 1;
+			}
+		}
+
+		if (sscanf(line, "%15[01] - %d us", word, &usec) == 2 && !word[1] && usec > 0) {
+			*val = word[0] == '1' ? LIRC_PULSE(usec) : LIRC_SPACE(usec);
+			return 1;
+		}
+	}
+}
+
+static int binary_next(struct raw *raw, int32_t *val)
+{
+	while (1) {
+		if (raw->npeek) {
+			memcpy(val, raw->peek, sizeof(*val));
+			raw->npeek = 0;
+		} else if (fread(val, sizeof(*val), 1, raw->fp) != 1) {
+			return ferror(raw->fp) ? -1 : 0;
+		}
+
+		if (!LIRC_IS_TIMEOUT(*val) && LIRC_VALUE(*val))
+			return 1;
+	}
+}
+
+static int indexed_next(struct raw *raw, int32_t *val)
+{
+	int rc;
+
+	while ((rc = capture_next(&raw->cap, val)) > 0) {
+		if (!LIRC_IS_TIMEOUT(*val) && LIRC_VALUE(*val))
+			break;
+	}
+
+	return rc;
+}
+
+/*
+ * Read up to @max elements, merging pulses or spaces that follow each
+ * other.  Unless at end of file, the chunk ends on a pulse, a trailing
+ * space is held over to start the next chunk.  This way the gap between
+ * two writes, when the transmitter is off, is part of that space.
+ * Returns number of elements, 0 at end of file, or -1 on error.
+ */
+int raw_read(struct raw *raw, int32_t *buf, int max)
+{
+	int32_t val;
+	int num = 0;
+	int rc;
+
+	if (raw->carry) {
+		buf[num++] = raw->carry;
+		raw->carry = 0;
+	}
+
+	while (num < max) {
+		if (raw->indexed)
+			rc = indexed_next(raw, &val);
+		else if (raw->binary)
+			rc = binary_next(raw, &val);
+		else
+			rc = text_next(raw, &val);
+		if (rc < 0)
+			return -1;
+		if (rc == 0)
+			return num;
+
+		if (num && LIRC_MODE2(buf[num - 1]) == LIRC_MODE2(val)) {
+			int usec = LIRC_VALUE(buf[num - 1]) + LIRC_VALUE(val);
+
+			if (usec > LIRC_VALUE_MASK)
+				usec = LIRC_VALUE_MASK;
+			buf[num - 1] = LIRC_MODE2(val) | usec;
+			continue;
+		}
+
+		buf[num++] = val;
+	}
+
+	if (num > 1 && LIRC_IS_SPACE(buf[num - 1]))
+		raw->carry = buf[--num];
+
+	return num;
+}
+
+void raw_close(struct raw *raw)
+{
+	if (raw->fp && raw->fp != stdin)
+		fclose(raw->fp);
+	raw->fp = NULL;
+	capture_close(&raw->cap);
+}
+
+/* Fill chunks ahead of the sender, at most two in memory */
+static void *reader(void *arg)
+{
+	struct stream *s = arg;
+	int len, slot;
+
+	while (1) {
+		pthread_mutex_lock(&s->lock);
+		while (s->ready == 2 && !s->stop)
+			pthread_cond_wait(&s->cond, &s->lock);
+		if (s->stop) {
+			pthread_mutex_unlock(&s->lock);
+			break;
+		}
+		slot = (s->head + s->ready) % 2;
+		pthread_mutex_unlock(&s->lock);
+
+		/* The sender never touches a chunk that is not ready */
+		len = raw_read(&s->raw, s->buf[slot], RAW_CHUNK);
+
+		pthread_mutex_lock(&s->lock);
+		if (len > 0) {
+			s->len[slot] = len;
+			s->ready++;
+		} else {
+			s->err = len < 0 ? errno : 0;
+			s->done = true;
+		}
+		pthread_cond_signal(&s->cond);
+		pthread_mutex_unlock(&s->lock);
+
+		if (len <= 0)
+			break;
+	}
+
+	return NULL;
+}
+
+/*
+ * Stream a capture file of any length, in chunks, to the transmitter.
+ * The next chunk is read while the current one is sent.  A driver that
+ * buffers writes continues the waveform without gaps on its own, and
+ * fails a write with EPIPE after it has run dry, an underrun.  Drivers
+ * that send while in write() are detected by how long it takes.  With
+ * those, the space that starts the next chunk is shortened by the time
+ * the transmitter was off between the two writes, and when it cannot
+ * start in time it is counted as an underrun.  Only on rfctl.ko.
+ */
+int raw_send(struct iface *ifc, const char *file, struct raw_stats *st)
+{
+	struct stream *s;
+	pthread_t tid;
+	bool buffered = false;
+	long long end = 0;
+	int rc = 0;
+
+	memset(st, 0, sizeof(*st));
+	if (ifc->type != IFC_RFCTL) {
+		errno = EOPNOTSUPP;
+		return -1;
+	}
+
+	s = calloc(1, sizeof(*s));
+	if (!s)
+		return -1;
+
+	if (raw_open(&s->raw, file)) {
+		free(s);
+		return -1;
+	}
+
+	pthread_mutex_init(&s->lock, NULL);
+	pthread_cond_init(&s->cond, NULL);
+	errno = pthread_create(&tid, NULL, reader, s);
+	if (errno) {
+		raw_close(&s->raw);
+		free(s);
+		return -1;
+	}
+
+	while (1) {
+		int32_t *buf;
+		int len;
+
+		pthread_mutex_lock(&s->lock);
+		while (!s->ready && !s->done)
+			pthread_cond_wait(&s->cond, &s->lock);
+		if (!s->ready) {
+			if (s->err) {
+				errno = s->err;
+				rc = -1;
+			}
+			pthread_mutex_unlock(&s->lock);
+			break;
+		}
+		buf = s->buf[s->head];
+		len = s->len[s->head];
+		pthread_mutex_unlock(&s->lock);
+
+		/* Transmitter has been off since last write, that is space */
+		if (end && !buffered && LIRC_IS_SPACE(buf[0])) {
+			long long off = sched_now() - end;
+
+			if (off < LIRC_VALUE(buf[0])) {
+				buf[0] = LIRC_SPACE(LIRC_VALUE(buf[0]) - off);
+			} else {
+				st->underruns++;
+				st->slip += off - LIRC_VALUE(buf[0]);
+				buf++;
+				len--;
+			}
+		}
+
+		if (len > 0) {
+			long long start = sched_now();
+
+			rc = iface_send(ifc, buf, len, 1);
+			if (rc && errno == EPIPE) {
+				st->underruns++;
+				rc = iface_send(ifc, buf, len, 1);
+			}
+			if (rc)
+				break;
+
+			end = sched_now();
+			if (end - start < sched_airtime(buf, len, 1) / 2)
+				buffered = true;
+		}
+		st->elements += len;
+		st->chunks++;
+
+		pthread_mutex_lock(&s->lock);
+		s->head = (s->head + 1) % 2;
+		s->ready--;
+		pthread_cond_signal(&s->cond);
+		pthread_mutex_unlock(&s->lock);
+	}
+
+	pthread_mutex_lock(&s->lock);
+	s->stop = true;
+	pthread_cond_signal(&s->cond);
+	pthread_mutex_unlock(&s->lock);
+	pthread_join(tid, NULL);
+
+	raw_close(&s->raw);
+	free(s);
+
+	return rc;
+}
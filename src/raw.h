@@ -0,0 +1,56 @@
+/* Control tool for NEXA and other RF remote receivers
+ *
+ * Copyright (C) 2010, 2012  Tord Andersson <tord.andersson@endian.se>
+ * Copyright (C) 2017        Joachim Nilsson <troglobit@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, visit the Free Software Foundation
+ * website at http://www.gnu.org/licenses/gpl-2.0.html or write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef RFCTL_RAW_H_
+#define RFCTL_RAW_H_
+
+#include "capture.h"
+
+#define RAW_CHUNK 4096		/* Elements per write, max for rfctl.ko */
+
+/* Capture file, mode2 style text, binary LIRC mode2, or rfctl -o */
+struct raw {
+	FILE           *fp;
+	bool            binary;
+	bool            indexed;	/* Capture format, read from cap */
+	struct capture  cap;
+	char            peek[4];	/* Read when detecting format */
+	int             npeek;
+	int32_t         carry;		/* Element held over to next chunk */
+	int             lineno;		/* Of text file, for errors */
+};
+
+/* Result of raw_send() */
+struct raw_stats {
+	long long       elements;	/* Sent */
+	int             chunks;
+	int             underruns;	/* Chunks that started late */
+	long long       slip;		/* Total time late, us */
+};
+
+int  raw_open         (struct raw *raw, const char *file);
+int  raw_read         (struct raw *raw, int32_t *buf, int max);
+void raw_close        (struct raw *raw);
+
+int  raw_send         (struct iface *ifc, const char *file, struct raw_stats *st);
+
+#endif /* RFCTL_RAW_H_ */
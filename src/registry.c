@@ -0,0 +1,308 @@
+/* Control tool for NEXA and other RF remote receivers
+ *
+ * Copyright (C) 2010, 2012  Tord Andersson <tord.andersson@endian.se>
+ * Copyright (C) 2017        Joachim Nilsson <troglobit@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, visit the Free Software Foundation
+ * website at http://www.gnu.org/licenses/gpl-2.0.html or write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <errno.h>
+
+#include "common.h"
+#include "registry.h"
+
+static uint32_t hash(const char *name)
+{
+	uint32_t h = 2166136261u;
+
+	while (*name) {
+		h ^= (uint8_t)*name++;
+		h *= 16777619u;
+	}
+
+	return h;
+}
+
+static int *slot_find(const struct registry *reg, const char *name)
+{
+	uint32_t i, probe;
+
+	if (!reg->num_slots)
+		return NULL;
+
+	i = hash(name) & (reg->num_slots - 1);
+	for (probe = 0; probe < reg->num_slots; probe++) {
+		int *slot = &reg->slot[i];
+
+		if (*slot < 0 || !strcmp(reg->entry[*slot].name, name))
+			return slot;
+		i = (i + 1) & (reg->num_slots - 1);
+	}
+
+	return NULL;
+}
+
+/* Grow index to keep load below 50%, rehashing all entries */
+static int index_grow(struct registry *reg)
+{
+	uint32_t num = reg->num_slots ? reg->num_slots * 2 : 64;
+	int *old = reg->slot;
+	int i;
+
+	reg->slot = malloc(num * sizeof(int));
+	if (!reg->slot) {
+		reg->slot = old;
+		return -1;
+	}
+
+	free(old);
+	reg->num_slots = num;
+	memset(reg->slot, 0xff, num * sizeof(int));
+	for (i = 0; i < reg->num_entries; i++)
+		*slot_find(reg, reg->entry[i].name) = i;
+
+	return 0;
+}
+
+static void *grow(void *ptr, int num, size_t size)
+{
+	/* Start with 16, then double when num reaches a power of two */
+	if (num && (num < 16 || (num & (num - 1))))
+		return ptr;
+
+	return realloc(ptr, (num ? num * 2 : 16) * size);
+}
+
+static int member_add(struct registry *reg, int dev)
+{
+	int *ptr;
+
+	ptr = grow(reg->member, reg->num_members, sizeof(int));
+	if (!ptr)
+		return -1;
+
+	reg->member = ptr;
+	reg->member[reg->num_members++] = dev;
+
+	return 0;
+}
+
+static struct reg_entry *entry_add(struct registry *reg, const char *name)
+{
+	struct reg_entry *entry;
+	int *slot;
+
+	if (strlen(name) >= REGISTRY_NAME_MAX)
+		return NULL;
+
+	if ((uint32_t)(reg->num_entries + 1) * 2 > reg->num_slots && index_grow(reg))
+		return NULL;
+
+	slot = slot_find(reg, name);
+	if (!slot || *slot >= 0)
+		return NULL;	/* Duplicate name */
+
+	entry = grow(reg->entry, reg->num_entries, sizeof(*entry));
+	if (!entry)
+		return NULL;
+	reg->entry = entry;
+
+	*slot = reg->num_entries;
+	entry = &reg->entry[reg->num_entries++];
+	strcpy(entry->name, name);
+	entry->first = reg->num_members;
+	entry->num = 0;
+
+	return entry;
+}
+
+static int device_add(struct registry *reg, char *name, char *proto, char *ptr)
+{
+	struct reg_device *dev;
+	struct reg_entry *entry;
+	char *group, *channel, *target;
+
+	group   = strtok_r(NULL, " \t\r\n", &ptr);
+	channel = strtok_r(NULL, " \t\r\n", &ptr);
+	target  = strtok_r(NULL, " \t\r\n", &ptr);
+	if (!group || !channel || strlen(group) > 15 || strlen(channel) > 15)
+		return -1;
+
+	dev = grow(reg->dev, reg->num_devs, sizeof(*dev));
+	if (!dev)
+		return -1;
+	reg->dev = dev;
+
+	dev = &reg->dev[reg->num_devs];
+	memset(dev, 0, sizeof(*dev));
+	dev->protocol = rf_protocol(proto);
+	if (dev->protocol == PROT_UNKNOWN)
+		return -1;
+	strcpy(dev->group, group);
+	strcpy(dev->channel, channel);
+
+	if (target) {
+		char *device = strchr(target, ':');
+
+		if (!device)
+			return -1;
+		*device++ = 0;
+
+		dev->iface = rf_interface(target);
+		if (dev->iface == IFC_UNKNOWN)
+			return -1;
+		strncpy(dev->device, device, sizeof(dev->device) - 1);
+	}
+
+	entry = entry_add(reg, name);
+	if (!entry || member_add(reg, reg->num_devs))
+		return -1;
+	entry->num = 1;
+	reg->num_devs++;
+
+	return 0;
+}
+
+/* Members are devices or groups defined on earlier lines */
+static int group_add(struct registry *reg, char *ptr)
+{
+	struct reg_entry *entry;
+	char *name, *member;
+	int idx;
+
+	name = strtok_r(NULL, " \t\r\n", &ptr);
+	if (!name)
+		return -1;
+
+	entry = entry_add(reg, name);
+	if (!entry)
+		return -1;
+	idx = entry - reg->entry;
+
+	while ((member = strtok_r(NULL, " \t\r\n", &ptr))) {
+		const int *dev;
+		int i, num, first;
+
+		num = registry_lookup(reg, member, &dev);
+		if (num <= 0)
+			return -1;
+
+		/* Use offset, the pool may move when it grows */
+		first = dev - reg->member;
+		for (i = 0; i < num; i++) {
+			int d = reg->member[first + i];
+			int j;
+
+			/* Skip devices already in this group */
+			for (j = 0; j < reg->entry[idx].num; j++) {
+				if (reg->member[reg->entry[idx].first + j] == d)
+					break;
+			}
+			if (j < reg->entry[idx].num)
+				continue;
+
+			if (member_add(reg, d))
+				return -1;
+			reg->entry[idx].num++;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Load device registry, compiled into a hash index of all names.  One
+ * device or group per line:
+ *
+ *     # NAME            PROTO    GROUP  CHANNEL     [IFACE:DEVICE]
+ *     kitchen.ceiling   NEXA     D      1
+ *     hall.lamp         SARTANO  -      1000100000  CUL:/dev/ttyACM0
+ *     group floor2.all  kitchen.ceiling hall.lamp
+ *
+ * On error registry.lineno holds the offending line.
+ */
+int registry_load(struct registry *reg, const char *file)
+{
+	char buf[1024];
+	FILE *fp;
+
+	memset(reg, 0, sizeof(*reg));
+
+	fp = fopen(file, "r");
+	if (!fp)
+		return -1;
+
+	while (fgets(buf, sizeof(buf), fp)) {
+		char *first, *second, *ptr;
+		int rc;
+
+		reg->lineno++;
+		first = strtok_r(buf, " \t\r\n", &ptr);
+		if (!first || first[0] == '#')
+			continue;
+
+		if (!strcmp(first, "group")) {
+			rc = group_add(reg, ptr);
+		} else {
+			second = strtok_r(NULL, " \t\r\n", &ptr);
+			rc = second ? device_add(reg, first, second, ptr) : -1;
+		}
+
+		if (rc) {
+			fclose(fp);
+			registry_free(reg);
+			errno = EINVAL;
+			return -1;
+		}
+	}
+
+	fclose(fp);
+	reg->lineno = 0;
+
+	return 0;
+}
+
+/*
+ * Resolve device or group name, returns number of devices and sets
+ * @dev to their indexes in reg->dev[], or 0 if the name is unknown.
+ */
+int registry_lookup(const struct registry *reg, const char *name, const int **dev)
+{
+	const struct reg_entry *entry;
+	int *slot;
+
+	slot = slot_find(reg, name);
+	if (!slot || *slot < 0)
+		return 0;
+
+	entry = &reg->entry[*slot];
+	*dev = &reg->member[entry->first];
+
+	return entry->num;
+}
+
+void registry_free(struct registry *reg)
+{
+	int lineno = reg->lineno;
+
+	free(reg->dev);
+	free(reg->entry);
+	free(reg->member);
+	free(reg->slot);
+	memset(reg, 0, sizeof(*reg));
+	reg->lineno = lineno;
+}
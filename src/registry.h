@@ -0,0 +1,67 @@
+/* Control tool for NEXA and other RF remote receivers
+ *
+ * Copyright (C) 2010, 2012  Tord Andersson <tord.andersson@endian.se>
+ * Copyright (C) 2017        Joachim Nilsson <troglobit@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, visit the Free Software Foundation
+ * website at http://www.gnu.org/licenses/gpl-2.0.html or write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef RFCTL_REGISTRY_H_
+#define RFCTL_REGISTRY_H_
+
+#include "protocol.h"
+
+#define REGISTRY_FILE     "/etc/rfctl.conf"
+#define REGISTRY_NAME_MAX 64
+
+/* A named device, with optional interface to send on */
+struct reg_device {
+	rf_protocol_t  protocol;
+	char           group[16];
+	char           channel[16];
+	rf_interface_t iface;	/* IFC_UNKNOWN: use default */
+	char           device[64];
+};
+
+/* A device or group name, members are indexes into the device array */
+struct reg_entry {
+	char           name[REGISTRY_NAME_MAX];
+	int            first;	/* offset in member pool */
+	int            num;
+};
+
+struct registry {
+	struct reg_device *dev;
+	int                num_devs;
+
+	struct reg_entry  *entry;
+	int                num_entries;
+
+	int               *member;	/* pool of device indexes */
+	int                num_members;
+
+	int               *slot;	/* hash index into entry[], -1 empty */
+	uint32_t           num_slots;
+
+	int                lineno;	/* line of last error in registry_load() */
+};
+
+int  registry_load    (struct registry *reg, const char *file);
+int  registry_lookup  (const struct registry *reg, const char *name, const int **dev);
+void registry_free    (struct registry *reg);
+
+#endif /* RFCTL_REGISTRY_H_ */
@@ -20,19 +20,31 @@
  * Boston, MA 02110-1301, USA.
  */
 
-#include <fcntl.h>
+#include <errno.h>
 #include <unistd.h>
-#include <termios.h>
 #include <getopt.h>
 #include <time.h>
 #include <signal.h>
 
 #include "common.h"
 #include "protocol.h"
+#include "router.h"
+#include "store.h"
+#include "registry.h"
+#include "scene.h"
+#include "raw.h"
+#include "capture.h"
+#include "rx.h"
+#include "learn.h"
+#include "flight.h"
+#include "batch.h"
+#include "search.h"
+#include "export.h"
+#include "logic.h"
 
 /* Local variables */
 bool verbose = false;		/* -v option */
-bool running = true;
+atomic_bool running = true;
 
 /* Program name, derived from argv[0] */
 static char *prognm = NULL;
@@ -41,13 +53,63 @@ static char *prognm = NULL;
 static int usage(int code)
 {
 	printf("\n"
-	       "Usage: %s [rwVvh] [-d DEV] [-i IFACE] [-p PROTO] [-s NO]\n"
+	       "Usage: %s [rwDVvh] [-d DEV] [-i IFACE] [-p PROTO] [-s NO]\n"
 	       "                        [-g GROUP] [-c CHAN] [-l LEVEL]\n"
+	       "                        [-R FILE] [-f FILE] [-S PATH] [-m FILE] [-C FLEET]\n"
+	       "                        [-F FILE] [-n NAME] [-W SEC] [-A SEC] [-u PCT[/SEC]]\n"
+	       "                        [-t FILE] [-o FILE] [-x FILE] [-L FILE] [-b SEC]\n"
+	       "                        [-e FILE] [-a RATE[,BYTES]] [-k PROBE]\n"
+	       "                        [FILE]\n"
+	       "       %s [-V] [-j NUM] [-I INDEX] decode FILE...\n"
+	       "       %s [-V] -p PROTO [-g GROUP] [-c CHAN] search INDEX [FROM [TO]]\n"
 	       "\n"
 	       " -d, --device=DEV       Device to use, defaults to %s\n"
 	       " -i, --interface=IFACE  RFCTL*, CUL, or TELLSTICK.  Default uses rfctl.ko\n"
+	       " -R, --routes=FILE      Route map of device addresses to interfaces, one\n"
+	       "                        worker per interface sends in parallel\n"
+	       " -f, --file=FILE        Send commands from FILE, or stdin if '-', one per\n"
+	       "                        line: PROTO GROUP CHANNEL LEVEL\n"
+	       " -D, --daemon           Serve commands on a UNIX socket, same format as -f\n"
+	       " -S, --socket=PATH      Daemon socket, defaults to %s\n"
+	       " -t, --schedule=FILE    Daemon sends scenes at times in FILE, cron style or\n"
+	       "                        relative to sunrise/sunset\n"
+	       " -m, --store=FILE       Send precomputed frames from FILE, when available\n"
+	       " -C, --compile=FLEET    Precompute on/off frames of all devices in FLEET,\n"
+	       "                        one PROTO GROUP CHANNEL per line, to -m FILE\n"
+	       " -F, --registry=FILE    Device names and groups, default %s\n"
+	       " -n, --name=NAME        Device or group name from registry, use with -l\n"
+	       " -W, --window=SEC       Drop commands identical to the last one sent to the\n"
+	       "                        device within SEC seconds, unless ending in 'force'\n"
+	       " -A, --reassert=SEC     Daemon re-sends device states older than SEC when\n"
+	       "                        all transmitters are idle\n"
+	       " -u, --duty-cycle=PCT[/SEC]\n"
+	       "                        Limit airtime of each transmitter to PCT percent of\n"
+	       "                        a sliding window, default %d sec.  Commands may end\n"
+	       "                        in 'prio=high|normal|low' and 'deadline=SEC'\n"
 	       " -p, --protocol=PROTO   NEXA, NEXA_L, SARTANO, CONRAD, ELRO, WAVEMAN, IKEA, RAW\n"
-	       " -r, --read             Raw space/pulse read, only on supported interfaces\n"
+	       " -r, --read             Raw space/pulse read, only on supported interfaces,\n"
+	       "                        with decoded NEXA_L commands\n"
+	       " -o, --output=FILE      Record what is read to FILE, in compact capture\n"
+	       "                        format, instead of printing it\n"
+	       " -x, --dump=FILE        Print capture FILE from -o, as read with -r, from\n"
+	       "                        optional wall-clock FROM [TO], seconds since the\n"
+	       "                        epoch or 'YYYY-MM-DD HH:MM[:SS]'.  FILE may also be\n"
+	       "                        a sigrok session (*.sr) or a raw dump, see -a\n"
+	       " -a, --rate=RATE[,BYTES]\n"
+	       "                        -x FILE is a raw dump of logic analyzer samples at\n"
+	       "                        RATE, e.g. 24M, of BYTES each, default 1.  A sigrok\n"
+	       "                        session needs neither\n"
+	       " -k, --probe=PROBE      Logic analyzer probe with the receiver, default 1\n"
+	       " -L, --learn=FILE       Record %d presses of a remote button, with -r or\n"
+	       "                        from -x, and save a replay profile to FILE\n"
+	       " -b, --flight=SEC[,DIR] Keep what was read the last SEC seconds in memory,\n"
+	       "                        saved as a capture file to DIR, default %s,\n"
+	       "                        on SIGUSR1 or when reception overruns\n"
+	       " -e, --export=FILE      Dry run, write waveform of command, or of capture from\n"
+	       "                        -x, to FILE, sigrok session if *.sr, else VCD.  Shows\n"
+	       "                        airtime and bytes sent per interface\n"
+	       " -j, --jobs=NUM         Threads decoding capture files, default all cores\n"
+	       " -I, --index=INDEX      Save index of decoded commands, by device, to search\n"
 	       " -w, --write            Send command (default)\n"
 	       " -g, --group=GROUP      The group/house/system number or letter\n"
 	       " -c, --channel=CHAN     The channel/unit number\n"
@@ -63,6 +125,11 @@ static int usage(int code)
 	       "  channel : 1..16\n"
 	       "  level   : 0..1   (OFF/ON)\n"
 	       "\n"
+	       "NEXA_L protocol arguments:\n"
+	       "  serial  : 0..67108863, or 0x hex (remote ID, -s or -g)\n"
+	       "  channel : 1..16, or 'all' for every unit learned to the remote ID\n"
+	       "  level   : 0..100 (0 OFF, 1 ON, 2..100 dim)\n"
+	       "\n"
 	       "SARTANO protocol arguments:\n"
 	       "  channel : 0000000000..1111111111\n"
 	       "  level   : 0..1   (OFF/ON)\n"
@@ -75,18 +142,43 @@ static int usage(int code)
 	       "IKEA protocol arguments:\n"
 	       "  group   : 1..16   (system)\n"
 	       "  channel : 1..10   (device)\n"
-	       "  level   : 0..100\n"
-	       "  dimstyle: 0..1    (N/A)\n"
+	       "  level   : 0..1 (OFF/ON), or 10..100[:smooth|:instant]  (dim, fade\n"
+	       "            by default)\n"
+	       "\n"
+	       "RAW protocol arguments:\n"
+	       "  FILE    : Capture to stream, '-' for stdin, mode2 style text with\n"
+	       "            'pulse USEC' and 'space USEC' lines, the output of %s -r,\n"
+	       "            binary LIRC mode2 elements, or a capture file from -o.  Only\n"
+	       "            on rfctl.ko.  A profile from -L is sent on any interface\n"
+	       "\n"
+	       "decode:\n"
+	       "  FILE    : Capture files from -o, decoded in parallel, split at gaps\n"
+	       "            in the air.  Commands are printed in time order, once per\n"
+	       "            press, with edges decoded per second on stderr\n"
+	       "\n"
+	       "search:\n"
+	       "  INDEX   : From decode -I, commands to the device given with -p, -g,\n"
+	       "            and -c if only to one unit, from optional FROM [TO] as -x\n"
 	       "\n"
 	       "Example:\n"
 	       "  %s -p NEXA -g D -c 1 -l 1      (NEXA D1 on)\n"
+	       "  %s -p NEXA_L -s 4711 -c all -l 0  (NEXA L group off)\n"
 	       "\n"
 	       "Bug report address: https://github.com/troglobit/rfctl/issues\n"
-	       "\n", prognm, DEFAULT_DEVICE, prognm);
+	       "\n", prognm, prognm, prognm, DEFAULT_DEVICE, RFCTL_SOCKET, REGISTRY_FILE, DUTY_WINDOW, LEARN_PRESSES, FLIGHT_DIR, prognm, prognm, prognm);
 
 	return code;
 }
 
+/* Flight recorder, -b option */
+static struct flight *flight;
+
+static void sigusr1_cb(int signo)
+{
+	if (flight)
+		flight_request(flight);
+}
+
 static void sigterm_cb(int signo)
 {
 	/*
@@ -96,6 +188,464 @@ static void sigterm_cb(int signo)
 	running = false;
 }
 
+/* Turn frames recorded while learning into a replay profile in @file */
+static int learned(struct learn *ln, const char *file)
+{
+	struct profile prof;
+	int i;
+
+	if (learn_profile(ln, &prof)) {
+		fprintf(stderr, "%s - No repeated frame found in %d frames, try again\n", prognm, ln->num);
+		return 1;
+	}
+
+	if (profile_save(&prof, file)) {
+		fprintf(stderr, "%s - Failed writing %s: %s\n", prognm, file, strerror(errno));
+		return 1;
+	}
+
+	printf("Learned %zu element frame, %d of %d frames intact, send %d times\n",
+	       strlen(prof.pattern) * 2, prof.intact, prof.frames, prof.repeat);
+	for (i = 0; i < prof.num; i++)
+		PRINT("  %d: pulse %5d us, space %5d us\n", i, prof.pulse[i], prof.space[i]);
+	PRINT("  pattern %s\n", prof.pattern);
+
+	return 0;
+}
+
+/* Waveform of what is left of a source, for comparing with -e of a command */
+static int export_source(rx_source_t *source, void *arg, const char *wave)
+{
+	struct export ex = { 0 };
+	int32_t buf[RX_BATCH];
+	long long num = 0;
+	bool err = false;
+	int64_t time;
+	int len;
+
+	while (!err && (len = source(arg, buf, NELEMS(buf), &time)) > 0) {
+		if (!ex.fp && export_open(&ex, wave, "rx", time))
+			err = true;
+		else if (export_edges(&ex, buf, len))
+			err = true;
+		num += len;
+	}
+	if (!ex.fp && !err && export_open(&ex, wave, "rx", 0))
+		err = true;
+
+	if (err || export_close(&ex)) {
+		fprintf(stderr, "%s - Failed writing %s: %s\n", prognm, wave, strerror(errno));
+		export_close(&ex);
+		return 1;
+	}
+
+	printf("%lld edges, %lld.%03lld ms\n", num, (long long)ex.time / 1000, (long long)ex.time % 1000);
+
+	return 0;
+}
+
+/*
+ * Logic analyzer capture, through the same pipeline as a capture file,
+ * printed, learned from, or exported as a waveform.
+ */
+static int dump_logic(const char *file, uint64_t rate, int width, int probe,
+		      struct learn *ln, const char *wave)
+{
+	struct logic *lg;
+	struct rx rx;
+	int rc = 0;
+
+	lg = malloc(sizeof(*lg));
+	if (!lg || logic_open(lg, file, rate, width, probe)) {
+		fprintf(stderr, "%s - Failed opening %s: %s\n", prognm, file, strerror(errno));
+		free(lg);
+		return 1;
+	}
+
+	PRINT("Logic capture at %llu Hz, probe %d of %d\n", (unsigned long long)lg->rate, probe,
+	      lg->unitsize * 8);
+	if (wave) {
+		rc = export_source(rx_from_logic, lg, wave);
+	} else if (rx_init(&rx, rx_from_logic, lg, false)) {
+		fprintf(stderr, "%s - Failed allocating RX buffers\n", prognm);
+		rc = 1;
+	} else {
+		rx.learn = ln;
+		rc = rx_run(&rx, &running);
+		rx_report(&rx);
+		rx_exit(&rx);
+	}
+	PRINT("%llu samples, %.3f s\n", (unsigned long long)lg->sample, lg->sample / (double)lg->rate);
+
+	if (lg->error) {
+		fprintf(stderr, "%s - Failed reading %s: %s\n", prognm, file, strerror(errno));
+		rc = 1;
+	}
+	logic_close(lg);
+	free(lg);
+
+	return rc ? 1 : 0;
+}
+
+/*
+ * Print capture file in the same format as 'rfctl -r', starting at
+ * the wall-clock time @from, if given, and ending at @to.  With @ln,
+ * learn a remote from it instead, and with @wave export its waveform.
+ * Logic analyzer captures are read with dump_logic().
+ */
+static int dump(const char *file, const char *from, const char *to, struct learn *ln,
+		const char *wave, uint64_t rate, int width, int probe)
+{
+	struct rx_capture src = { 0 };
+	int64_t start = 0;
+	struct rx rx;
+	int rc;
+
+	if (rate || logic_session(file)) {
+		if (from) {
+			fprintf(stderr, "%s - FROM and TO are only for capture files from -o\n", prognm);
+			return 1;
+		}
+
+		return dump_logic(file, rate, width, probe, ln, wave);
+	}
+
+	if ((from && capture_time(from, &start)) || (to && capture_time(to, &src.end))) {
+		fprintf(stderr, "%s - Invalid time, use seconds since the epoch or 'YYYY-MM-DD HH:MM:SS'\n",
+			prognm);
+		return 1;
+	}
+
+	if (capture_open(&src.cap, file)) {
+		fprintf(stderr, "%s - Failed opening %s: %s\n", prognm, file, strerror(errno));
+		return 1;
+	}
+
+	PRINT("Capture of %s, %u blocks\n", src.cap.hdr->device, src.cap.num);
+	if (from && capture_seek(&src.cap, start))
+		src.corrupt = true;
+
+	if (wave && !src.corrupt) {
+		rc = export_source(rx_from_capture, &src, wave);
+		capture_close(&src.cap);
+		if (src.corrupt) {
+			fprintf(stderr, "%s - Corrupt capture file %s\n", prognm, file);
+			return 1;
+		}
+
+		return rc;
+	}
+
+	if (rx_init(&rx, rx_from_capture, &src, false)) {
+		fprintf(stderr, "%s - Failed allocating RX buffers\n", prognm);
+		capture_close(&src.cap);
+		return 1;
+	}
+
+	rx.learn = ln;
+	rc = src.corrupt ? 0 : rx_run(&rx, &running);
+	rx_report(&rx);
+	rx_exit(&rx);
+	capture_close(&src.cap);
+
+	if (src.corrupt) {
+		fprintf(stderr, "%s - Corrupt capture file %s\n", prognm, file);
+		return 1;
+	}
+
+	return rc ? 1 : 0;
+}
+
+/* Command from an archive, same format for decode and search */
+static void print_cmd(const struct rx_event *ev, const char *file)
+{
+	time_t sec = ev->time / 1000000;
+	char tm[32], str[64];
+
+	strftime(tm, sizeof(tm), "%Y-%m-%d %H:%M:%S", localtime(&sec));
+	rx_cmd_str(&ev->cmd, str, sizeof(str));
+	printf("%s.%03d %s", tm, (int)(ev->time % 1000000) / 1000, str);
+	PRINT("  # %d frames in %lld ms, %s", ev->count, (long long)(ev->last - ev->time) / 1000, file);
+	printf("\n");
+}
+
+/*
+ * Decode capture files on all cores, or @jobs threads, and print the
+ * commands in time order, one per press.  The summary goes to stderr
+ * so the commands can be piped on.  With @index, also save a sidecar
+ * index of the commands for search().
+ */
+static int decode_files(char **files, int num, int jobs, const char *index)
+{
+	struct batch b;
+	size_t i;
+	int rc;
+
+	if (batch_open(&b, files, num, jobs))
+		return 1;
+
+	if (batch_run(&b)) {
+		fprintf(stderr, "%s - Failed decoding: %s\n", prognm, strerror(errno));
+		batch_close(&b);
+		return 1;
+	}
+
+	for (i = 0; i < b.num; i++)
+		print_cmd(&b.hit[i].ev, b.name[b.hit[i].file]);
+
+	fprintf(stderr, "Decoded %lu edges in %.3f s, %.1f M edges/s, %d threads\n", b.edges,
+		b.usec / 1e6, b.usec ? b.edges / (double)b.usec : 0.0, b.jobs);
+	if (verbose)
+		fprintf(stderr, "%d files, %zu segments, %lu stolen, %lu frames, %lu commands, %lu repeats\n",
+			b.files, b.segs, atomic_load(&b.steals), b.frames, b.commands, b.repeats);
+	if (b.undecoded)
+		fprintf(stderr, "%s - %lu frames not decoded, only NEXA_L is decoded\n", prognm,
+			b.undecoded);
+	if (b.corrupt)
+		fprintf(stderr, "%s - %d segments with corrupt blocks skipped in part\n", prognm, b.corrupt);
+	rc = b.corrupt ? 1 : 0;
+
+	if (index && search_save(&b, index)) {
+		fprintf(stderr, "%s - Failed writing %s: %s\n", prognm, index, strerror(errno));
+		rc = 1;
+	}
+	batch_close(&b);
+
+	return rc;
+}
+
+/*
+ * Look up commands to a device in an @index from 'decode', optionally
+ * between wall-clock @from and @to, and without -c to any unit.  Each
+ * press is verified by decoding only the capture blocks it is in.
+ */
+static int search(const char *index, rf_protocol_t protocol, const char *group,
+		  const char *channel, const char *from, const char *to)
+{
+	int64_t start = INT64_MIN, end = INT64_MAX;
+	struct rx_event ev;
+	struct search *s;
+	size_t i, last;
+	uint32_t address;
+	int unit, found = 0, stale = 0;
+
+	if (!rf_decodable(protocol)) {
+		fprintf(stderr, "%s - Protocol cannot be searched, only NEXA_L is decoded\n", prognm);
+		return 1;
+	}
+
+	if (rf_address(protocol, group, channel ? channel : "all", &address, &unit)) {
+		fprintf(stderr, "Invalid group or channel\n");
+		return usage(1);
+	}
+
+	if ((from && capture_time(from, &start)) || (to && capture_time(to, &end))) {
+		fprintf(stderr, "%s - Invalid time, use seconds since the epoch or 'YYYY-MM-DD HH:MM:SS'\n",
+			prognm);
+		return 1;
+	}
+
+	s = malloc(sizeof(*s));
+	if (!s || search_open(s, index)) {
+		fprintf(stderr, "%s - Failed opening %s: %s\n", prognm, index, strerror(errno));
+		free(s);
+		return 1;
+	}
+
+	for (i = search_find(s, protocol, address, &last); i < last; i++) {
+		const struct search_ent *e = &s->ent[i];
+		const char *file = search_name(s, e->file);
+
+		if ((channel && e->unit != unit) || e->last < start || e->time >= end)
+			continue;
+
+		switch (search_verify(s, e, &ev)) {
+		case 1:
+			print_cmd(&ev, file);
+			found++;
+			break;
+
+		case 0:
+			fprintf(stderr, "%s - Press at %lld not in %s, changed since indexed?\n",
+				prognm, (long long)e->time, file);
+			stale++;
+			break;
+
+		default:
+			fprintf(stderr, "%s - Failed reading %s: %s\n", prognm, file, strerror(errno));
+			stale++;
+			break;
+		}
+	}
+
+	PRINT("%d presses found, %u commands in index\n", found, s->hdr->num);
+	search_close(s);
+	free(s);
+
+	return stale ? 1 : 0;
+}
+
+/*
+ * Dry run of a command, its waveform with all repeats is written to
+ * @wave, and for each interface what it would be sent and how long it
+ * is on air.  Tellstick timing is rounded to its 10 us ticks.  With
+ * @frames the repeats are already back-to-back, as from the store.
+ */
+static int preview(const char *wave, const int32_t *frames, const int32_t *bitstream, int len,
+		   int repeat)
+{
+	const int32_t *frame = frames ? frames : bitstream;
+	char cmd[RF_MAX_TX_BITS * 6];
+	struct export ex;
+	long long air = 0, ts = 0;
+	int i, num;
+
+	if (export_open(&ex, wave, "tx", 0)) {
+		fprintf(stderr, "%s - Failed creating %s: %s\n", prognm, wave, strerror(errno));
+		return 1;
+	}
+	for (i = 0; i < repeat; i++) {
+		if (export_edges(&ex, frames ? &frames[i * len] : bitstream, len))
+			break;
+	}
+	if (export_close(&ex)) {
+		fprintf(stderr, "%s - Failed writing %s: %s\n", prognm, wave, strerror(errno));
+		return 1;
+	}
+
+	for (i = 0; i < len; i++)
+		air += LIRC_VALUE(frame[i]);
+	air *= repeat;
+
+	printf("%d edges, %d frames of %d, %lld.%03lld ms on air\n", len * repeat, repeat, len,
+	       air / 1000, air % 1000);
+	printf("  rfctl.ko   %6d bytes in %d writes, %lld.%03lld ms\n", len * 4 * repeat,
+	       frames ? 1 : repeat, air / 1000, air % 1000);
+
+	num = bitstream2cul443(frame, len, repeat, cmd);
+	if (num)
+		printf("  CUL        %6d bytes of text, %lld.%03lld ms\n", num, air / 1000, air % 1000);
+	else
+		printf("  CUL        cannot send this frame\n");
+
+	/* 'P' pause 'R' repeat 'S' ticks... '+' */
+	num = bitstream2tellstick(frame, len, repeat, cmd);
+	if (num) {
+		i = 0;
+		if (cmd[i] == 'P') {
+			ts += (uint8_t)cmd[i + 1] * 1000;
+			i += 2;
+		}
+		for (i += 3; i < num - 1; i++)
+			ts += (uint8_t)cmd[i] * TELLSTICK_TICK;
+		ts *= repeat;
+		printf("  Tellstick  %6d bytes, %lld.%03lld ms\n", num, ts / 1000, ts % 1000);
+	} else {
+		printf("  Tellstick  cannot send this frame\n");
+	}
+
+	return 0;
+}
+
+/*
+ * Send commands from file, or serve them on a socket, using the router
+ * to spread them across all transmitters.  Without a route map all
+ * commands go to the interface given with -i and -d.
+ */
+static int route(const char *routes, const char *file, const char *sock, char *cmd,
+		 rf_interface_t iface, const char *device, const struct store *st,
+		 const struct registry *reg, struct cache *cache, double duty, int duty_window,
+		 const char *schedule)
+{
+	struct schedule sched;
+	struct router r;
+	char buf[1024];
+	int rc = 0;
+
+	router_init(&r);
+	r.store = st;
+	r.cache = cache;
+	r.duty = duty;
+	r.duty_window = duty_window;
+	if (reg->num_entries && router_registry(&r, reg)) {
+		fprintf(stderr, "%s - Too many interfaces in registry\n", prognm);
+		return 1;
+	}
+
+	if (routes) {
+		if (router_load(&r, routes)) {
+			fprintf(stderr, "%s - Failed loading %s: %s\n", prognm, routes, strerror(errno));
+			return 1;
+		}
+	} else if (router_default(&r, iface, device)) {
+		return 1;
+	}
+
+	if (router_start(&r)) {
+		router_exit(&r);
+		return 1;
+	}
+
+	if (schedule) {
+		if (schedule_load(&sched, &r, schedule)) {
+			if (sched.lineno)
+				fprintf(stderr, "%s:%d: invalid scene or event: %s\n", schedule,
+					sched.lineno, strerror(errno));
+			else
+				fprintf(stderr, "%s - Failed opening %s: %s\n", prognm, schedule, strerror(errno));
+			router_exit(&r);
+			return 1;
+		}
+		r.schedule = &sched;
+	}
+
+	if (cmd) {
+		if (router_cmd(&r, cmd)) {
+			fprintf(stderr, "%s - Failed sending %s: %s\n", prognm, cmd, strerror(errno));
+			rc = 1;
+		}
+		router_wait(&r);
+	}
+
+	if (file) {
+		FILE *fp = stdin;
+
+		if (strcmp(file, "-")) {
+			fp = fopen(file, "r");
+			if (!fp) {
+				fprintf(stderr, "%s - Error opening %s\n", prognm, file);
+				router_exit(&r);
+				return 1;
+			}
+		}
+
+		if (router_file(&r, fp))
+			rc = 1;
+		router_wait(&r);
+
+		if (fp != stdin)
+			fclose(fp);
+	}
+
+	if (sock) {
+		signal(SIGINT, sigterm_cb);
+		signal(SIGTERM, sigterm_cb);
+		if (daemon_run(&r, sock, &running)) {
+			fprintf(stderr, "%s - Failed opening socket %s: %s\n", prognm, sock, strerror(errno));
+			rc = 1;
+		}
+	}
+
+	router_stats(&r, buf, sizeof(buf));
+	PRINT("%s", buf);
+	if (router_exit(&r))
+		rc = 1;
+	if (schedule)
+		schedule_free(&sched);
+
+	return rc;
+}
+
 static char *progname(char *arg0)
 {
        char *nm;
@@ -111,31 +661,80 @@ static char *progname(char *arg0)
 
 int main(int argc, char **argv)
 {
-	struct termios tio;
-	int fd = -1;
+	struct iface ifc;
 	rf_interface_t iface = IFC_RFCTL;
 	char default_dev[255] = DEFAULT_DEVICE;
 	char *device = default_dev;	/* -d option */
 	rf_mode_t mode = MODE_WRITE;	/* read/write */
 	char *proto = NULL;
+	char *routes = NULL;		/* -R option */
+	char *file = NULL;		/* -f option */
+	char *sock = NULL;		/* -S option */
+	char *schedule = NULL;		/* -t option */
+	char *output = NULL;		/* -o option */
+	char *capture = NULL;		/* -x option */
+	char *profile = NULL;		/* -L option */
+	int keep = 0;			/* -b option */
+	char *keep_dir = NULL;
+	int jobs = 0;			/* -j option */
+	char *index = NULL;		/* -I option */
+	char *wave = NULL;		/* -e option */
+	uint64_t rate = 0;		/* -a option */
+	int width = 1;
+	int probe = 1;			/* -k option */
+	struct flight fl;
+	struct learn *ln = NULL;
+	bool daemon = false;		/* -D option */
+	char *store = NULL;		/* -m option */
+	char *fleet = NULL;		/* -C option */
+	char *registry = NULL;		/* -F option */
+	char *name = NULL;		/* -n option */
+	int window = 0;			/* -W option */
+	int reassert = 0;		/* -A option */
+	double duty = 0;		/* -u option */
+	int duty_window = DUTY_WINDOW;
+	struct capture_out out;
+	struct cache cache;
+	const int32_t *frames = NULL;
+	struct registry reg;
+	struct store st;
 	rf_protocol_t protocol = PROT_NEXA;	/* protocol */
 	const char *group = NULL;	/* house/group/system option */
 	const char *channel = NULL;	/* -c (channel/unit) option */
 	const char *level = NULL;	/* level 0 - 100 % or on/off */
+	const char *serial = NULL;	/* -s NEXA_L remote ID */
 	int32_t tx_bitstream[RF_MAX_TX_BITS];
-	int32_t rx_bitstream[RF_MAX_RX_BITS];
-	int32_t rx_val = 0;
-	int rx_len = 0;
+	struct rx_iface rx_src;
+	struct rx rx;
 	int tx_len = 0;
 	int repeat = 0;
-	int i, c;
-	char cmd[RF_MAX_TX_BITS * 6]; /* hex/ASCII representation is longer than bitstream */
-	int cmd_len = 0;
+	int i, c, rc;
 	const struct option opt[] = {
 		{ "device",       required_argument, NULL, 'd' },
 		{ "interface",    required_argument, NULL, 'i' },
 		{ "protocol",     required_argument, NULL, 'p' },
 		{ "read",         no_argument,       NULL, 'r' },
+		{ "output",       required_argument, NULL, 'o' },
+		{ "dump",         required_argument, NULL, 'x' },
+		{ "learn",        required_argument, NULL, 'L' },
+		{ "flight",       required_argument, NULL, 'b' },
+		{ "jobs",         required_argument, NULL, 'j' },
+		{ "index",        required_argument, NULL, 'I' },
+		{ "export",       required_argument, NULL, 'e' },
+		{ "rate",         required_argument, NULL, 'a' },
+		{ "probe",        required_argument, NULL, 'k' },
+		{ "routes",       required_argument, NULL, 'R' },
+		{ "file",         required_argument, NULL, 'f' },
+		{ "daemon",       no_argument,       NULL, 'D' },
+		{ "socket",       required_argument, NULL, 'S' },
+		{ "schedule",     required_argument, NULL, 't' },
+		{ "store",        required_argument, NULL, 'm' },
+		{ "compile",      required_argument, NULL, 'C' },
+		{ "registry",     required_argument, NULL, 'F' },
+		{ "name",         required_argument, NULL, 'n' },
+		{ "window",       required_argument, NULL, 'W' },
+		{ "reassert",     required_argument, NULL, 'A' },
+		{ "duty-cycle",   required_argument, NULL, 'u' },
 		{ "write",        no_argument,       NULL, 'w' },
 		{ "group",        required_argument, NULL, 'g' },
 		{ "channel",      required_argument, NULL, 'c' },
@@ -148,7 +747,7 @@ int main(int argc, char **argv)
 	};
 
 	prognm = progname(argv[0]);
-	while ((c = getopt_long(argc, argv, "d:i:p:rwg:c:l:vVh?", opt, &i)) != EOF) {
+	while ((c = getopt_long(argc, argv, "d:i:p:ro:x:L:b:j:I:e:a:k:wR:f:DS:t:m:C:F:n:W:A:u:g:c:s:l:vVh?", opt, &i)) != EOF) {
 		switch (c) {
 		case 'd':
 			if (optarg) {
@@ -161,14 +760,8 @@ int main(int argc, char **argv)
 
 		case 'i':
 			if (optarg) {
-				if (strcmp("RFCTL", optarg) == 0) {
-					iface = IFC_RFCTL;
-				} else if (strcmp("CUL", optarg) == 0) {
-					iface = IFC_CUL;
-				} else if (strcmp("TELLSTICK", optarg) == 0) {
-					iface = IFC_TELLSTICK;
-				} else {
-					iface = IFC_UNKNOWN;
+				iface = rf_interface(optarg);
+				if (iface == IFC_UNKNOWN) {
 					fprintf(stderr, "Error. Unknown interface type: %s\n", optarg);
 					return usage(1);
 				}
@@ -182,32 +775,132 @@ int main(int argc, char **argv)
 			mode = MODE_READ;
 			break;
 
+		case 'o':
+			output = optarg;
+			break;
+
+		case 'x':
+			capture = optarg;
+			break;
+
+		case 'L':
+			profile = optarg;
+			mode = MODE_READ;
+			break;
+
+		case 'b':
+			keep = atoi(optarg);
+			if (strchr(optarg, ','))
+				keep_dir = strchr(optarg, ',') + 1;
+			if (keep <= 0) {
+				fprintf(stderr, "Error. Invalid flight recorder window: %s\n", optarg);
+				return usage(1);
+			}
+			break;
+
+		case 'j':
+			jobs = atoi(optarg);
+			if (jobs <= 0) {
+				fprintf(stderr, "Error. Invalid number of jobs: %s\n", optarg);
+				return usage(1);
+			}
+			break;
+
+		case 'I':
+			index = optarg;
+			break;
+
+		case 'e':
+			wave = optarg;
+			break;
+
+		case 'a':
+			if (strchr(optarg, ',')) {
+				width = atoi(strchr(optarg, ',') + 1);
+				if (width < 1 || width > 8) {
+					fprintf(stderr, "Error. Invalid sample size: %s\n", optarg);
+					return usage(1);
+				}
+				*strchr(optarg, ',') = 0;
+			}
+			rate = logic_rate(optarg);
+			if (!rate) {
+				fprintf(stderr, "Error. Invalid sample rate: %s\n", optarg);
+				return usage(1);
+			}
+			break;
+
+		case 'k':
+			probe = atoi(optarg);
+			if (probe < 1) {
+				fprintf(stderr, "Error. Invalid probe: %s\n", optarg);
+				return usage(1);
+			}
+			break;
+
 		case 'w':
 			mode = MODE_WRITE;
 			break;
 
+		case 'R':
+			routes = optarg;
+			break;
+
+		case 'f':
+			file = optarg;
+			break;
+
+		case 'D':
+			daemon = true;
+			break;
+
+		case 'S':
+			sock = optarg;
+			break;
+
+		case 't':
+			schedule = optarg;
+			break;
+
+		case 'm':
+			store = optarg;
+			break;
+
+		case 'C':
+			fleet = optarg;
+			break;
+
+		case 'F':
+			registry = optarg;
+			break;
+
+		case 'n':
+			name = optarg;
+			break;
+
+		case 'W':
+			window = atoi(optarg);
+			break;
+
+		case 'A':
+			reassert = atoi(optarg);
+			break;
+
+		case 'u':
+			duty = atof(optarg);
+			if (strchr(optarg, '/'))
+				duty_window = atoi(strchr(optarg, '/') + 1);
+			if (duty <= 0 || duty > 100 || duty_window <= 0) {
+				fprintf(stderr, "Error. Invalid duty cycle: %s\n", optarg);
+				return usage(1);
+			}
+			break;
+
 		case 'p':
 			if (optarg) {
 				proto = optarg;
-				if (strcmp("NEXA", proto) == 0) {
-					protocol = PROT_NEXA;
-				} else if (strcmp("PROOVE", proto) == 0) {
-					protocol = PROT_NEXA;
-				} else if (strcmp("WAVEMAN", proto) == 0) {
-					protocol = PROT_WAVEMAN;
-				} else if (strcmp("SARTANO", proto) == 0) {
-					protocol = PROT_SARTANO;
-				} else if (strcmp("ELRO", proto) == 0) {
-					protocol = PROT_SARTANO;
-				} else if (strcmp("IMPULS", proto) == 0) {
-					protocol = PROT_IMPULS;
-				} else if (strcmp("NEXA_L", proto) == 0) {
-					protocol = PROT_NEXA_L;
-				} else if (strcmp("CONRAD", proto) == 0) {
-					protocol = PROT_CONRAD;
-				} else if (strcmp("RAW", proto) == 0) {
-					protocol = PROT_RAW;
-				} else {
+				protocol = rf_protocol(proto);
+				if (protocol == PROT_UNKNOWN) {
 					fprintf(stderr, "Error. Unknown protocol: %s\n", proto);
 					return usage(1);
 				}
@@ -235,6 +928,10 @@ int main(int argc, char **argv)
 			}
 			break;
 
+		case 's':
+			serial = optarg;
+			break;
+
 		case 'l':
 			if (optarg) {
 				level = optarg;
@@ -271,223 +968,315 @@ int main(int argc, char **argv)
 		}
 	}
 
-	/* Build generic transmit bitstream for the selected protocol */
-	if (mode == MODE_WRITE) {
-		if ((protocol != PROT_SARTANO && !group) || !channel || !level)
+	/* The remote ID is the group of self-learning devices */
+	if (serial)
+		group = serial;
+
+	if (fleet) {
+		if (!store) {
+			fprintf(stderr, "Error. Missing store file (-m) to compile to\n");
 			return usage(1);
+		}
 
-		switch (protocol) {
-		case PROT_NEXA:
-			PRINT("NEXA protocol selected\n");
-			tx_len = nexa_bitstream(group, channel, level, tx_bitstream, &repeat);
-			if (tx_len == 0)
-				return usage(1);
-			break;
+		if (store_compile(fleet, store)) {
+			fprintf(stderr, "%s - Failed compiling %s: %s\n", prognm, fleet, strerror(errno));
+			return 1;
+		}
 
-		case PROT_WAVEMAN:
-			PRINT("WAVEMAN protocol selected\n");
-			tx_len = waveman_bitstream(group, channel, level, tx_bitstream, &repeat);
-			if (tx_len == 0)
-				return usage(1);
-			break;
+		return 0;
+	}
 
-		case PROT_SARTANO:
-			PRINT("SARTANO protocol selected\n");
-			tx_len = sartano_bitstream(channel, level, tx_bitstream, &repeat);
-			if (tx_len == 0)
-				return usage(1);
-			break;
+	if (profile) {
+		ln = malloc(sizeof(*ln));
+		if (!ln) {
+			fprintf(stderr, "%s - Failed allocating learn buffers\n", prognm);
+			return 1;
+		}
+		learn_init(ln, LEARN_PRESSES);
+	}
 
-		case PROT_CONRAD:
-			PRINT("CONRAD protocol selected\n");
-			tx_len = conrad_bitstream(group, channel, level, tx_bitstream, &repeat);
-			if (tx_len == 0)
-				return usage(1);
-			break;
+	if (optind < argc && !strcmp(argv[optind], "decode")) {
+		if (optind + 1 >= argc)
+			return usage(1);
 
-		case PROT_IMPULS:
-			PRINT("IMPULS protocol selected\n");
-			tx_len = impulse_bitstream(channel, level, tx_bitstream, &repeat);
-			if (tx_len == 0)
-				return usage(1);
-			break;
+		return decode_files(&argv[optind + 1], argc - optind - 1, jobs, index);
+	}
+
+	if (optind < argc && !strcmp(argv[optind], "search")) {
+		if (optind + 1 >= argc || (protocol != PROT_SARTANO && protocol != PROT_IMPULS && !group))
+			return usage(1);
+
+		return search(argv[optind + 1], protocol, group, channel,
+			      optind + 2 < argc ? argv[optind + 2] : NULL,
+			      optind + 3 < argc ? argv[optind + 3] : NULL);
+	}
+
+	if (capture) {
+		rc = dump(capture, optind < argc ? argv[optind] : NULL,
+			  optind + 1 < argc ? argv[optind + 1] : NULL, ln, wave, rate, width, probe);
+		if (!rc && ln)
+			rc = learned(ln, profile);
+		free(ln);
 
-		case PROT_IKEA:
-			PRINT("IKEA protocol selected\n");
-			tx_len = ikea_bitstream(group, channel, level, "1", tx_bitstream, &repeat);
-			if (tx_len == 0)
+		return rc;
+	}
+
+	if (wave && (mode != MODE_WRITE || routes || file || daemon || name)) {
+		fprintf(stderr, "Error. Export (-e) is only for one command (-p), or a capture (-x)\n");
+		return usage(1);
+	}
+
+	if ((output || keep) && mode != MODE_READ) {
+		fprintf(stderr, "Error. Output (-o) and flight recorder (-b) are only used when reading (-r)\n");
+		return usage(1);
+	}
+
+	if (schedule && !daemon) {
+		fprintf(stderr, "Error. Schedule (-t) is only used by the daemon (-D)\n");
+		return usage(1);
+	}
+
+	memset(&st, 0, sizeof(st));
+	if (store && store_open(&st, store)) {
+		fprintf(stderr, "%s - Failed opening %s: %s\n", prognm, store, strerror(errno));
+		return 1;
+	}
+
+	/* The default registry is optional */
+	memset(&reg, 0, sizeof(reg));
+	if (!registry && !access(REGISTRY_FILE, R_OK))
+		registry = REGISTRY_FILE;
+	if (registry && registry_load(&reg, registry)) {
+		if (reg.lineno)
+			fprintf(stderr, "%s:%d: invalid device or group\n", registry, reg.lineno);
+		else
+			fprintf(stderr, "%s - Failed opening %s: %s\n", prognm, registry, strerror(errno));
+		return 1;
+	}
+
+	if (mode == MODE_WRITE && (routes || file || daemon || name)) {
+		char cmd[REGISTRY_NAME_MAX + 16];
+		int rc;
+
+		if (daemon && !sock)
+			sock = RFCTL_SOCKET;
+		else if (!daemon)
+			sock = NULL;
+
+		if (name) {
+			if (!level)
 				return usage(1);
-			break;
+			snprintf(cmd, sizeof(cmd), "%s %s", name, level);
+		}
 
-		default:
-			fprintf(stderr, "Protocol: %s is currently not supported\n", proto);
-			return usage(1);
+		memset(&cache, 0, sizeof(cache));
+		if ((window || reassert) && cache_init(&cache, window, reassert)) {
+			fprintf(stderr, "%s - Failed allocating state cache\n", prognm);
+			return 1;
 		}
+
+		rc = route(routes, file, sock, name ? cmd : NULL, iface, device, &st, &reg,
+			   window || reassert ? &cache : NULL, duty, duty_window,
+			   schedule);
+		cache_exit(&cache);
+		registry_free(&reg);
+		store_close(&st);
+
+		return rc;
 	}
 
-	/* Transmit/read handling for each interface type */
-	switch (iface) {
-	case IFC_RFCTL:
-		PRINT("Selected /dev/rfctl interface\n");
+	/* Learned profile, sent as any other protocol, see below */
+	if (mode == MODE_WRITE && protocol == PROT_RAW && optind < argc) {
+		struct profile prof;
 
-		if (0 > (fd = open(device, O_RDWR))) {
-			fprintf(stderr, "%s - Error opening %s\n", prognm, device);
+		if (!profile_load(&prof, argv[optind])) {
+			PRINT("Using learned profile %s\n", argv[optind]);
+			tx_len = profile_frame(&prof, tx_bitstream);
+			repeat = prof.repeat;
+		} else if (errno != ENOEXEC) {
+			fprintf(stderr, "%s - Invalid profile %s: %s\n", prognm, argv[optind], strerror(errno));
 			return 1;
 		}
+	}
 
-		if (mode == MODE_WRITE) {
-			PRINT("Writing %d pulse_space_items, (%d bytes) to %s\n", tx_len * repeat,
-			      tx_len * 4 * repeat, device);
-			for (i = 0; i < repeat; i++) {
-				if (write(fd, tx_bitstream, tx_len * 4) < 0) {
-					perror("Error writing to /dev/rfctl");
-					break;
-				}
-			}
-			sleep(1);
-		} else if (mode == MODE_READ) {
-			running = true;
-			PRINT("Reading pulse_space_items\n");
-
-			/*
-			 * Set up signal handlers to act on CTRL-C events
-			 */
-			if (signal(SIGINT, sigterm_cb) == SIG_ERR) {
-				perror("Can't register signal handler for CTRL-C et al: ");
-				return -1;
-			}
+	if (wave && protocol == PROT_RAW && !tx_len) {
+		fprintf(stderr, "Error. Export (-e) of a capture is done with -x\n");
+		return usage(1);
+	}
 
-			while (running == true) {	/* repeat until CTRL-C */
-				rx_len = read(fd, rx_bitstream, 4);
-				if (rx_len == 4) {
-					rx_val = (uint32_t)*&rx_bitstream[0];
-					if (LIRC_IS_TIMEOUT(rx_val))
-						printf("\nRX Timeout");
-					else if (LIRC_IS_PULSE(rx_val))
-						printf("\n1 - %05d us", LIRC_VALUE(rx_val));
-					else if (LIRC_IS_SPACE(rx_val))
-						printf("\n0 - %05d us", LIRC_VALUE(rx_val));
-				} else {
-					if (rx_len == 0) {
-						usleep(100 * 1000);	/* 100 ms */
-						printf(".");
-						fflush(stdout);
-					} else {
-						printf("Read %d bytes\n", rx_len);
-						fflush(stdout);
-					}
-				}
-			}
+	/* Stream capture file, of any length, in chunks */
+	if (mode == MODE_WRITE && protocol == PROT_RAW && !tx_len) {
+		struct raw_stats rs;
+		int rc;
+
+		if (optind >= argc)
+			return usage(1);
+
+		if (iface_open(&ifc, iface, device)) {
+			fprintf(stderr, "%s - Error opening %s\n", prognm, device);
+			return 1;
+		}
+
+		rc = raw_send(&ifc, argv[optind], &rs);
+		if (iface_close(&ifc))
+			rc = -1;
+		if (rc) {
+			fprintf(stderr, "%s - Failed sending %s: %s\n", prognm, argv[optind], strerror(errno));
+			return 1;
 		}
-		close(fd);
+
+		PRINT("Sent %lld elements in %d chunks\n", rs.elements, rs.chunks);
+		if (rs.underruns)
+			fprintf(stderr, "%s - %d underrun(s), waveform %lld us late\n", prognm,
+				rs.underruns, rs.slip);
+
+		return 0;
+	}
+
+	/* Build generic transmit bitstream for the selected protocol */
+	if (mode == MODE_WRITE && protocol != PROT_RAW) {
+		if ((protocol != PROT_SARTANO && !group) || !channel || !level)
+			return usage(1);
+
+		PRINT("%s protocol selected\n", proto ? proto : "NEXA");
+		frames = store_lookup(&st, protocol, group, channel, level, &tx_len, &repeat);
+		if (!frames)
+			tx_len = rf_encode(protocol, group, channel, level, tx_bitstream, &repeat);
+		else
+			PRINT("Using precomputed frames from %s\n", store);
+		if (tx_len < 0)
+			fprintf(stderr, "Protocol: %s is currently not supported\n", proto);
+		else if (tx_len == 0)
+			fprintf(stderr, "Invalid group, channel or level\n");
+		if (tx_len <= 0)
+			return usage(1);
+	}
+
+	if (wave)
+		return preview(wave, frames, tx_bitstream, tx_len, repeat);
+
+	/* Transmit/read handling for each interface type */
+	switch (iface) {
+	case IFC_RFCTL:
+		PRINT("Selected /dev/rfctl interface\n");
 		break;
 
 	case IFC_TELLSTICK:
-#if 0
 		PRINT("Selected Tellstick interface\n");
-		if (0 > (fd = open(*(argv + 1), O_RDWR))) {
-			fprintf(stderr, "%s - Error opening %s\n", prognm, *(argv + 1));
+		if (mode == MODE_READ) {
+			fprintf(stderr, "%s - Tellstick does not support reading\n", prognm);
 			return 1;
 		}
-
-		/* adjust serial port parameters */
-		bzero(&tio, sizeof(tio));	/* clear struct for new port settings */
-		tio.c_cflag = B4800 | CS8 | CLOCAL | CREAD;	/* CREAD not used yet */
-		tio.c_iflag = IGNPAR;
-		tio.c_oflag = 0;
-		tio.c_ispeed = 4800;
-		tio.c_ospeed = 4800;
-		tcflush(fd, TCIFLUSH);
-		tcsetattr(fd, TCSANOW, &tio);
-		if (write(fd, txStr, strlen(txStr)) < 0)
-			perror("Error writing to Tellstick device");
-
-		sleep(1);	/* one second sleep to avoid device 'choking' */
-		close(fd);
-#else
-		fprintf(stderr, "Tellstick interface currently not available.\n");
-#endif
 		break;
 
 	case IFC_CUL:
 		PRINT("Selected CUL433 interface\n");
+		break;
 
-		if (0 > (fd = open(device, O_RDWR))) {
-			fprintf(stderr, "%s - Error opening %s\n", prognm, device);
+	default:
+		fprintf(stderr, "%s - Illegal interface type (%d)\n", prognm, iface);
+		return 1;
+	}
+
+	if (iface_open(&ifc, iface, device)) {
+		fprintf(stderr, "%s - Error opening %s\n", prognm, device);
+		return 1;
+	}
+
+	if (mode == MODE_WRITE) {
+		int rc;
+
+		PRINT("Writing %d pulse_space_items, (%d bytes) to %s\n", tx_len * repeat,
+		      tx_len * 4 * repeat, device);
+		if (frames)
+			rc = iface_send_frames(&ifc, frames, tx_len, repeat);
+		else
+			rc = iface_send(&ifc, tx_bitstream, tx_len, repeat);
+		if (iface_close(&ifc))
+			rc = -1;
+		if (rc)
+			perror("Error writing to device");
+		else
+			PRINT("Sent in %lld us\n", ifc.usec);
+
+		return 0;
+	}
+
+	running = true;
+	PRINT("Reading pulse_space_items\n");
+
+	/*
+	 * Set up signal handlers to act on CTRL-C events
+	 */
+	if (signal(SIGINT, sigterm_cb) == SIG_ERR) {
+		perror("Can't register signal handler for CTRL-C et al: ");
+		return -1;
+	}
+
+	if (rx_init(&rx, rx_from_iface, &rx_src, true)) {
+		fprintf(stderr, "%s - Failed allocating RX buffers\n", prognm);
+		iface_close(&ifc);
+		return 1;
+	}
+
+	if (output) {
+		if (capture_create(&out, output, device, iface, 0)) {
+			fprintf(stderr, "%s - Failed creating %s: %s\n", prognm, output, strerror(errno));
+			rx_exit(&rx);
+			iface_close(&ifc);
 			return 1;
 		}
+		rx.out = &out;
+	}
 
-		/* adjust serial port parameters */
-		bzero(&tio, sizeof(tio));	/* clear struct for new port settings */
-		tio.c_cflag = B115200 | CS8 | CLOCAL | CREAD;	/* CREAD not used yet */
-		tio.c_iflag = IGNPAR;
-		tio.c_oflag = 0;
-		tio.c_ispeed = 115200;
-		tio.c_ospeed = 115200;
-		tcflush(fd, TCIFLUSH);
-		tcsetattr(fd, TCSANOW, &tio);
-
-		printf("Mode : %d\n", mode);
-
-		if (mode == MODE_WRITE) {
-			/* CUL433 nethome format */
-			cmd_len = bitstream2cul443(tx_bitstream, tx_len, repeat, cmd);
-
-			printf("CUL cmd: %s\n", cmd);
-
-			if (write(fd, cmd, cmd_len) < 0)
-				perror("Error writing to CUL device");
-			sleep(1);
-		} else if (mode == MODE_READ) {
-			running = true;
-			PRINT("Reading pulse_space_items\n");
-
-			/*
-			 * Set up signal handlers to act on CTRL-C events
-			 */
-			if (signal(SIGINT, sigterm_cb) == SIG_ERR) {
-				perror("Can't register signal handler for CTRL-C et al: ");
-				return -1;
-			}
+	if (keep) {
+		if (flight_init(&fl, keep, keep_dir)) {
+			fprintf(stderr, "%s - Failed starting flight recorder\n", prognm);
+			rx_exit(&rx);
+			iface_close(&ifc);
+			return 1;
+		}
+		rx.flight = flight = &fl;
+		signal(SIGUSR1, sigusr1_cb);
+	}
 
-			/* start rx */
-			if (write(fd, "\r\nX01\r\n", 7) < 0) {
-				perror("Error issuing RX cmd to CUL device");
-				running = false;
-			}
+	if (ln) {
+		printf("Press and hold the button, release, and repeat %d times", ln->max);
+		fflush(stdout);
+		rx.learn = ln;
+	}
 
-			while (running) {	/* repeat until CTRL-C */
-				rx_len = read(fd, rx_bitstream, 5);
-				if (rx_len == 5) {
-					rx_val = (uint32_t)*&rx_bitstream[0];
-					printf("\n%08X: ", rx_val);
-					if (rx_val & 0x8000)
-						printf("1 - %05d us", rx_val & 0x7FFF);
-					else
-						printf("0 - %05d us", rx_val & 0x7FFF);
-
-					if ((rx_val & 0x7FFF) == 0x7FFF)
-						printf(" - Timeout");
-				} else {
-					if (rx_len == 0) {
-						usleep(100 * 1000);	/* 100 ms */
-						printf(".");
-						fflush(stdout);
-					} else {
-						printf("Read %d bytes\n", rx_len);
-						fflush(stdout);
-					}
-				}
-			}
-		}
-		close(fd);
-		break;
+	/* start rx */
+	if (iface == IFC_CUL && write(ifc.fd, "\r\nX01\r\n", 7) < 0) {
+		perror("Error issuing RX cmd to CUL device");
+		running = false;
+	}
 
+	/* Reader, decoder and output threads, until CTRL-C */
+	memset(&rx_src, 0, sizeof(rx_src));
+	rx_src.ifc = &ifc;
+	cul443_rx_init(&rx_src.cul);
+	rc = rx_run(&rx, &running);
+	iface_close(&ifc);
 
-	default:
-		fprintf(stderr, "%s - Illegal interface type (%d)\n", prognm, iface);
-		break;
+	rx_report(&rx);
+	if (rx_src.errors)
+		fprintf(stderr, "%s - %lu failed reads from %s\n", prognm, rx_src.errors, device);
+	if (flight) {
+		signal(SIGUSR1, SIG_IGN);
+		flight = NULL;
+		flight_exit(&fl);
 	}
+	rx_exit(&rx);
 
-	return 0;
+	if (output && capture_finish(&out)) {
+		fprintf(stderr, "%s - Failed writing %s: %s\n", prognm, output, strerror(errno));
+		return 1;
+	}
+
+	if (!rc && ln)
+		rc = learned(ln, profile);
+	free(ln);
+
+	return rc ? 1 : 0;
 }
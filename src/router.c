@@ -0,0 +1,800 @@
+/* Control tool for NEXA and other RF remote receivers
+ *
+ * Copyright (C) 2010, 2012  Tord Andersson <tord.andersson@endian.se>
+ * Copyright (C) 2017        Joachim Nilsson <troglobit@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, visit the Free Software Foundation
+ * website at http://www.gnu.org/licenses/gpl-2.0.html or write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <errno.h>
+
+#include "common.h"
+#include "router.h"
+#include "scene.h"
+
+static void jobs_done(struct router *r, int num)
+{
+	pthread_mutex_lock(&r->lock);
+	r->pending -= num;
+	if (r->pending == 0)
+		pthread_cond_broadcast(&r->idle);
+	pthread_mutex_unlock(&r->lock);
+}
+
+static void job_done(struct router *r, struct job *job)
+{
+	free(job);
+	jobs_done(r, 1);
+}
+
+/* Batched commands are only counted as sent once they are written */
+static void worker_batch_done(struct worker *w, int rc)
+{
+	if (rc) {
+		w->failed += w->batched;
+	} else {
+		w->count   += w->batched;
+		w->airtime += w->batched_air;
+	}
+	w->batched     = 0;
+	w->batched_air = 0;
+}
+
+/*
+ * Send commands the interface has batched, e.g. Tellstick, called with
+ * the worker locked when there is nothing more to send right now.
+ */
+static void worker_flush(struct worker *w)
+{
+	int num = w->batched;
+	int rc;
+
+	pthread_mutex_unlock(&w->lock);
+	rc = iface_flush(&w->ifc);
+	if (rc)
+		fprintf(stderr, "Error writing to %s: %s\n", w->device, strerror(errno));
+
+	/* Counted before router_wait() can return */
+	pthread_mutex_lock(&w->lock);
+	worker_batch_done(w, rc);
+	pthread_mutex_unlock(&w->lock);
+
+	jobs_done(w->router, num);
+	pthread_mutex_lock(&w->lock);
+}
+
+/*
+ * Take next job off the queue, in priority and deadline order, waiting
+ * for the airtime budget if needed.  Jobs whose deadline pass while
+ * waiting are dropped, as are jobs still over budget at exit.  Batched
+ * commands are flushed before waiting, so a burst of jobs goes out in
+ * as few writes as the interface allows.  Called and returns with the
+ * worker locked, NULL when stopped.
+ */
+static struct job *worker_next(struct worker *w)
+{
+	struct job *job;
+	long long now, wait;
+
+	while (1) {
+		job = w->head;
+		if (!job) {
+			if (w->batched) {
+				worker_flush(w);
+				continue;
+			}
+			if (w->stop)
+				return NULL;
+			pthread_cond_wait(&w->cond, &w->lock);
+			continue;
+		}
+
+		now  = sched_now();
+		wait = duty_wait(&w->duty, now, job->airtime, job->prio);
+		if (job->deadline && now + wait > job->deadline)
+			wait = -1;
+		else if (wait > 0 && w->stop)
+			wait = -1;
+
+		if (wait == 0 || wait < 0) {
+			w->head = job->next;
+			w->queued--;
+			if (wait == 0) {
+				/* Reserve airtime before we let go of the lock */
+				duty_add(&w->duty, now, job->airtime);
+				return job;
+			}
+
+			w->expired++;
+			pthread_mutex_unlock(&w->lock);
+			job_done(w->router, job);
+			pthread_mutex_lock(&w->lock);
+			continue;
+		}
+
+		if (w->batched) {
+			worker_flush(w);
+			continue;
+		}
+
+		/* Wake up when budget is available, or new work arrives */
+		now += wait;
+		{
+			struct timespec ts = {
+				.tv_sec  = now / 1000000,
+				.tv_nsec = (now % 1000000) * 1000
+			};
+
+			pthread_cond_timedwait(&w->cond, &w->lock, &ts);
+		}
+	}
+}
+
+/*
+ * Transmitters are opened on first use, so an absent one only fails the
+ * commands routed to it.  Retried on every command until it opens.
+ */
+static int worker_open(struct worker *w)
+{
+	if (w->open)
+		return 0;
+
+	if (iface_open(&w->ifc, w->type, w->device)) {
+		fprintf(stderr, "Error opening %s: %s\n", w->device, strerror(errno));
+		return -1;
+	}
+	w->open = true;
+
+	return 0;
+}
+
+static void *worker_thread(void *arg)
+{
+	struct worker *w = arg;
+	struct job *job;
+	int queued, num, rc;
+
+	while (1) {
+		pthread_mutex_lock(&w->lock);
+		job = worker_next(w);
+		pthread_mutex_unlock(&w->lock);
+		if (!job)
+			break;
+
+		if (worker_open(w)) {
+			pthread_mutex_lock(&w->lock);
+			w->failed++;
+			pthread_mutex_unlock(&w->lock);
+			job_done(w->router, job);
+			continue;
+		}
+
+		queued = w->ifc.queued;
+		if (job->frames)
+			rc = iface_send_frames(&w->ifc, job->bitstream, job->len, job->repeat);
+		else
+			rc = iface_send(&w->ifc, job->bitstream, job->len, job->repeat);
+		if (rc) {
+			fprintf(stderr, "Error writing to %s: %s\n", w->device, strerror(errno));
+			rc = -1;
+		}
+
+		pthread_mutex_lock(&w->lock);
+		num = 0;
+		if (queued && (rc ? !w->ifc.queued : w->ifc.queued != queued + 1)) {
+			/* The interface flushed the batch to make room */
+			num = w->batched;
+			worker_batch_done(w, rc);
+		}
+
+		if (rc)
+			w->failed++;
+		else if (w->ifc.queued) {
+			/* Done when flushed, see worker_next() */
+			w->batched++;
+			w->batched_air += job->airtime;
+			free(job);
+			job = NULL;
+		} else {
+			w->count++;
+			w->airtime += job->airtime;
+		}
+		pthread_mutex_unlock(&w->lock);
+
+		if (num)
+			jobs_done(w->router, num);
+		if (job)
+			job_done(w->router, job);
+	}
+
+	return NULL;
+}
+
+static int worker_find(struct router *r, rf_interface_t type, const char *device)
+{
+	pthread_condattr_t attr;
+	struct worker *w;
+	int i;
+
+	for (i = 0; i < r->num_workers; i++) {
+		w = &r->worker[i];
+		if (w->type == type && !strcmp(w->device, device))
+			return i;
+	}
+
+	if (r->num_workers >= ROUTER_MAX_IFACES) {
+		errno = ENOSPC;
+		return -1;
+	}
+
+	w = &r->worker[r->num_workers];
+	memset(w, 0, sizeof(*w));
+	w->type = type;
+	strncpy(w->device, device, sizeof(w->device) - 1);
+	pthread_mutex_init(&w->lock, NULL);
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&w->cond, &attr);
+	pthread_condattr_destroy(&attr);
+
+	return r->num_workers++;
+}
+
+static struct route *route_add(struct router *r)
+{
+	struct route *route;
+
+	route = realloc(r->route, (r->num_routes + 1) * sizeof(*route));
+	if (!route)
+		return NULL;
+
+	r->route = route;
+	route = &r->route[r->num_routes++];
+	memset(route, 0, sizeof(*route));
+
+	return route;
+}
+
+/* First matching route wins, so more specific routes go first */
+static struct route *route_find(struct router *r, rf_protocol_t protocol,
+				const char *group, const char *channel)
+{
+	int i;
+
+	for (i = 0; i < r->num_routes; i++) {
+		struct route *route = &r->route[i];
+
+		if (route->protocol != PROT_UNKNOWN && route->protocol != protocol)
+			continue;
+		if (strcmp(route->group, "*") && (!group || strcmp(route->group, group)))
+			continue;
+		if (strcmp(route->channel, "*") && (!channel || strcmp(route->channel, channel)))
+			continue;
+
+		return route;
+	}
+
+	return NULL;
+}
+
+int router_init(struct router *r)
+{
+	memset(r, 0, sizeof(*r));
+	pthread_mutex_init(&r->lock, NULL);
+	pthread_cond_init(&r->idle, NULL);
+
+	return 0;
+}
+
+/*
+ * Load route map, one device address per line followed by one or more
+ * transmitters to send on:
+ *
+ *     # PROTO  GROUP  CHANNEL      IFACE:DEVICE ...
+ *     NEXA     D      1            RFCTL:/dev/rfctl CUL:/dev/ttyACM0
+ *     SARTANO  -      1000100000   CUL:/dev/ttyACM0
+ *     *        *      *            RFCTL:/dev/rfctl
+ */
+int router_load(struct router *r, const char *file)
+{
+	char buf[256];
+	int lineno = 0;
+	FILE *fp;
+
+	fp = fopen(file, "r");
+	if (!fp)
+		return -1;
+
+	while (fgets(buf, sizeof(buf), fp)) {
+		char *proto, *group, *channel, *target, *ptr;
+		struct route *route;
+
+		lineno++;
+		proto = strtok_r(buf, " \t\n", &ptr);
+		if (!proto || proto[0] == '#')
+			continue;
+
+		group   = strtok_r(NULL, " \t\n", &ptr);
+		channel = strtok_r(NULL, " \t\n", &ptr);
+		if (!group || !channel)
+			goto error;
+
+		route = route_add(r);
+		if (!route)
+			goto fail;
+
+		if (strcmp(proto, "*")) {
+			route->protocol = rf_protocol(proto);
+			if (route->protocol == PROT_UNKNOWN)
+				goto error;
+		}
+		strncpy(route->group, group, sizeof(route->group) - 1);
+		strncpy(route->channel, channel, sizeof(route->channel) - 1);
+
+		while ((target = strtok_r(NULL, " \t\n", &ptr))) {
+			char *device = strchr(target, ':');
+			rf_interface_t type;
+			int i;
+
+			if (!device || route->num >= ROUTER_MAX_IFACES)
+				goto error;
+			*device++ = 0;
+
+			type = rf_interface(target);
+			if (type == IFC_UNKNOWN)
+				goto error;
+
+			i = worker_find(r, type, device);
+			if (i < 0)
+				goto fail;
+			route->target[route->num++] = i;
+		}
+
+		if (!route->num)
+			goto error;
+	}
+
+	fclose(fp);
+	return 0;
+
+error:
+	fprintf(stderr, "%s:%d: invalid route\n", file, lineno);
+	errno = EINVAL;
+fail:
+	fclose(fp);
+	return -1;
+}
+
+/* Add catch-all route for addresses not in the route map */
+int router_default(struct router *r, rf_interface_t type, const char *device)
+{
+	struct route *route;
+	int i;
+
+	i = worker_find(r, type, device);
+	if (i < 0)
+		return -1;
+
+	route = route_add(r);
+	if (!route)
+		return -1;
+
+	strcpy(route->group, "*");
+	strcpy(route->channel, "*");
+	route->target[route->num++] = i;
+
+	return 0;
+}
+
+/*
+ * Use device names from registry, devices with their own interface get
+ * a route ahead of all others to that interface.
+ */
+int router_registry(struct router *r, const struct registry *reg)
+{
+	int i;
+
+	r->reg = reg;
+	for (i = 0; i < reg->num_devs; i++) {
+		const struct reg_device *dev = &reg->dev[i];
+		struct route *route;
+		int w;
+
+		if (dev->iface == IFC_UNKNOWN)
+			continue;
+
+		w = worker_find(r, dev->iface, dev->device);
+		if (w < 0 || !route_add(r))
+			return -1;
+
+		memmove(&r->route[1], &r->route[0], (r->num_routes - 1) * sizeof(*route));
+		route = &r->route[0];
+		memset(route, 0, sizeof(*route));
+		route->protocol = dev->protocol;
+		strcpy(route->group, dev->group);
+		strcpy(route->channel, dev->channel);
+		route->target[route->num++] = w;
+	}
+
+	return 0;
+}
+
+/* Start one worker thread for each transmitter, see worker_open() */
+int router_start(struct router *r)
+{
+	int i;
+
+	for (i = 0; i < r->num_workers; i++) {
+		struct worker *w = &r->worker[i];
+
+		duty_init(&w->duty, r->duty, r->duty_window);
+		w->router = r;
+		errno = pthread_create(&w->thread, NULL, worker_thread, w);
+		if (errno)
+			return -1;
+		w->started = true;
+	}
+
+	return 0;
+}
+
+/*
+ * Find the transmitters for a command and encode it, or look it up in
+ * the frame store.  The bitstream is encoded to @buf, which must fit
+ * RF_MAX_TX_BITS elements, and must outlive @f.
+ */
+int router_prepare(struct router *r, rf_protocol_t protocol, const char *group,
+		   const char *channel, const char *level, struct txframe *f, int32_t *buf)
+{
+	const int32_t *frames = NULL;
+
+	memset(f, 0, sizeof(*f));
+	if (strlen(group) >= sizeof(f->group) || strlen(channel) >= sizeof(f->channel) ||
+	    strlen(level) >= sizeof(f->level)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	f->route = route_find(r, protocol, group, channel);
+	if (!f->route) {
+		errno = ENOENT;
+		return -1;
+	}
+
+	if (r->store)
+		frames = store_lookup(r->store, protocol, group, channel, level, &f->len, &f->repeat);
+	if (frames) {
+		f->bitstream = frames;
+		f->frames = true;
+	} else {
+		f->len = rf_encode(protocol, group, channel, level, buf, &f->repeat);
+		if (f->len <= 0) {
+			errno = f->len < 0 ? EPROTONOSUPPORT : EINVAL;
+			return -1;
+		}
+		f->bitstream = buf;
+	}
+
+	f->protocol = protocol;
+	strcpy(f->group, group);
+	strcpy(f->channel, channel);
+	strcpy(f->level, level);
+	f->airtime = sched_airtime(f->bitstream, f->len, f->repeat);
+
+	return 0;
+}
+
+/*
+ * Queue a prepared command on every transmitter that covers the device.
+ * Returns as soon as it is queued, commands for different transmitters
+ * are sent in parallel.  With the state cache, a command identical to
+ * the last one sent to the device within the window is dropped, unless
+ * forced in @opt.
+ */
+int router_queue(struct router *r, const struct txframe *f, const struct txopt *opt)
+{
+	struct txopt defopt = { .prio = PRIO_NORMAL };
+	long long deadline = 0;
+	int i;
+
+	if (!opt)
+		opt = &defopt;
+	if (r->cache && !cache_check(r->cache, f->protocol, f->group, f->channel, f->level, opt->force))
+		return 0;
+
+	if (opt->deadline)
+		deadline = sched_now() + (long long)opt->deadline * 1000;
+
+	for (i = 0; i < f->route->num; i++) {
+		struct worker *w = &r->worker[f->route->target[i]];
+		struct job *job;
+
+		job = malloc(sizeof(*job) + (f->frames ? 0 : f->len * sizeof(int32_t)));
+		if (!job)
+			return -1;
+
+		job->next = NULL;
+		job->prio = opt->prio;
+		job->deadline = deadline;
+		job->airtime = f->airtime;
+		job->len = f->len;
+		job->repeat = f->repeat;
+		job->frames = f->frames;
+		if (f->frames) {
+			job->bitstream = f->bitstream;
+		} else {
+			memcpy(job->buf, f->bitstream, f->len * sizeof(int32_t));
+			job->bitstream = job->buf;
+		}
+
+		pthread_mutex_lock(&r->lock);
+		r->pending++;
+		pthread_mutex_unlock(&r->lock);
+
+		pthread_mutex_lock(&w->lock);
+		sched_insert(&w->head, job);
+		w->queued++;
+		pthread_cond_signal(&w->cond);
+		pthread_mutex_unlock(&w->lock);
+	}
+
+	return 0;
+}
+
+/* Encode, or look up, a command and queue it, see router_queue() */
+int router_send(struct router *r, rf_protocol_t protocol, const char *group,
+		const char *channel, const char *level, const struct txopt *opt)
+{
+	int32_t bitstream[RF_MAX_TX_BITS];
+	struct txframe f;
+
+	if (router_prepare(r, protocol, group, channel, level, &f, bitstream))
+		return -1;
+
+	return router_queue(r, &f, opt);
+}
+
+/* Send to all devices of a registry name */
+static int router_name(struct router *r, const char *name, const char *level,
+		       const struct txopt *opt)
+{
+	const int *dev;
+	int i, num;
+
+	num = r->reg ? registry_lookup(r->reg, name, &dev) : 0;
+	if (!num) {
+		errno = ENOENT;
+		return -1;
+	}
+
+	for (i = 0; i < num; i++) {
+		const struct reg_device *d = &r->reg->dev[dev[i]];
+
+		if (router_send(r, d->protocol, d->group, d->channel, level, opt))
+			return -1;
+	}
+
+	return 0;
+}
+
+/* Parse trailing options: force, prio=high|normal|low, deadline=SEC */
+static int txopt(char *ptr, struct txopt *opt)
+{
+	char *arg;
+
+	memset(opt, 0, sizeof(*opt));
+	opt->prio = PRIO_NORMAL;
+
+	while ((arg = strtok_r(NULL, " \t\r\n", &ptr))) {
+		if (!strcmp(arg, "force"))
+			opt->force = true;
+		else if (!strcmp(arg, "prio=high"))
+			opt->prio = PRIO_HIGH;
+		else if (!strcmp(arg, "prio=normal"))
+			opt->prio = PRIO_NORMAL;
+		else if (!strcmp(arg, "prio=low"))
+			opt->prio = PRIO_LOW;
+		else if (!strncmp(arg, "deadline=", 9))
+			opt->deadline = atof(&arg[9]) * 1000;
+		else
+			return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Parse and send one command line: PROTO GROUP CHANNEL LEVEL [OPTS]
+ * Protocols without group, e.g. SARTANO, use '-' as placeholder.
+ * Devices and groups in the registry can also be used: NAME LEVEL
+ * Options: 'force' bypasses the state cache, 'prio=high|normal|low'
+ * and 'deadline=SEC' control when the command is sent.
+ */
+int router_cmd(struct router *r, char *line)
+{
+	char *proto, *group, *channel, *level, *ptr;
+	rf_protocol_t protocol;
+	struct txopt opt;
+
+	proto = strtok_r(line, " \t\r\n", &ptr);
+	if (!proto || proto[0] == '#')
+		return 0;
+
+	group   = strtok_r(NULL, " \t\r\n", &ptr);
+	if (group && rf_protocol(proto) == PROT_UNKNOWN && r->reg) {
+		if (txopt(ptr, &opt)) {
+			errno = EINVAL;
+			return -1;
+		}
+		return router_name(r, proto, group, &opt);
+	}
+
+	channel = strtok_r(NULL, " \t\r\n", &ptr);
+	level   = strtok_r(NULL, " \t\r\n", &ptr);
+	if (!group || !channel || !level) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	protocol = rf_protocol(proto);
+	if (protocol == PROT_UNKNOWN) {
+		errno = EPROTONOSUPPORT;
+		return -1;
+	}
+
+	if (txopt(ptr, &opt)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	return router_send(r, protocol, group, channel, level, &opt);
+}
+
+/* Send all commands in file, returns number of failed commands */
+int router_file(struct router *r, FILE *fp)
+{
+	char buf[256];
+	int lineno = 0;
+	int err = 0;
+
+	while (fgets(buf, sizeof(buf), fp)) {
+		lineno++;
+		if (router_cmd(r, buf)) {
+			fprintf(stderr, "line %d: %s\n", lineno, strerror(errno));
+			err++;
+		}
+	}
+
+	return err;
+}
+
+/*
+ * Called by the daemon when there is nothing else to do.  When all
+ * transmitters are idle, re-send one device state that has not been
+ * sent for a while, so devices that missed a frame converge.
+ */
+void router_idle(struct router *r)
+{
+	struct cache_entry *e;
+	int pending;
+
+	if (!r->cache)
+		return;
+
+	pthread_mutex_lock(&r->lock);
+	pending = r->pending;
+	pthread_mutex_unlock(&r->lock);
+	if (pending)
+		return;
+
+	e = cache_stale(r->cache);
+	if (e) {
+		struct txopt opt = { .force = true, .prio = PRIO_LOW };
+
+		router_send(r, e->protocol, e->group, e->channel, e->value, &opt);
+	}
+}
+
+/*
+ * Format statistics for the daemon's stats command, one line for the
+ * state cache and one per transmitter with its channel utilization in
+ * the current duty cycle window.
+ */
+int router_stats(struct router *r, char *buf, size_t len)
+{
+	struct cache *c = r->cache;
+	long long now = sched_now();
+	size_t pos;
+	int i;
+
+	if (c)
+		pos = snprintf(buf, len, "devices %u sent %lu suppressed %lu reasserted %lu\n",
+			       c->num, c->sent, c->suppressed, c->reasserted);
+	else
+		pos = snprintf(buf, len, "cache disabled\n");
+
+	if (r->schedule && pos < len)
+		pos += snprintf(&buf[pos], len - pos, "scenes %d events %d fired %lu\n",
+				r->schedule->num_scenes, r->schedule->num_events,
+				r->schedule->fired);
+
+	for (i = 0; i < r->num_workers && pos < len; i++) {
+		struct worker *w = &r->worker[i];
+		long long used;
+
+		pthread_mutex_lock(&w->lock);
+		used = duty_used(&w->duty, now);
+		pos += snprintf(&buf[pos], len - pos,
+				"%s queued %d sent %d expired %d util %.2f%% budget %.2f%%\n",
+				w->device, w->queued, w->count, w->expired,
+				100.0 * used / w->duty.window,
+				w->duty.budget ? 100.0 * w->duty.budget / w->duty.window : 100.0);
+		pthread_mutex_unlock(&w->lock);
+	}
+
+	return pos < len ? pos : len - 1;
+}
+
+/* Wait for all queued commands to be sent */
+void router_wait(struct router *r)
+{
+	pthread_mutex_lock(&r->lock);
+	while (r->pending > 0)
+		pthread_cond_wait(&r->idle, &r->lock);
+	pthread_mutex_unlock(&r->lock);
+}
+
+/*
+ * Drain all queues, stop workers and close all transmitters.  Returns
+ * the number of commands that failed, e.g. on a transmitter missing.
+ */
+int router_exit(struct router *r)
+{
+	int i, failed = 0;
+
+	for (i = 0; i < r->num_workers; i++) {
+		struct worker *w = &r->worker[i];
+
+		pthread_mutex_lock(&w->lock);
+		w->stop = true;
+		pthread_cond_signal(&w->cond);
+		pthread_mutex_unlock(&w->lock);
+	}
+
+	for (i = 0; i < r->num_workers; i++) {
+		struct worker *w = &r->worker[i];
+
+		if (w->started)
+			pthread_join(w->thread, NULL);
+		if (w->open && iface_close(&w->ifc)) {
+			fprintf(stderr, "Error writing to %s: %s\n", w->device, strerror(errno));
+			w->failed++;
+		}
+		if (w->count)
+			PRINT("%s: %d command(s), avg %lld us per command, %lld ms airtime\n",
+			      w->device, w->count, w->ifc.usec / w->count, w->airtime / 1000);
+		if (w->expired)
+			PRINT("%s: %d command(s) dropped, deadline passed\n", w->device, w->expired);
+		failed += w->failed;
+	}
+
+	free(r->route);
+	r->route = NULL;
+	r->num_routes = 0;
+
+	return failed;
+}
@@ -0,0 +1,134 @@
+/* Control tool for NEXA and other RF remote receivers
+ *
+ * Copyright (C) 2010, 2012  Tord Andersson <tord.andersson@endian.se>
+ * Copyright (C) 2017        Joachim Nilsson <troglobit@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, visit the Free Software Foundation
+ * website at http://www.gnu.org/licenses/gpl-2.0.html or write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef RFCTL_ROUTER_H_
+#define RFCTL_ROUTER_H_
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include "protocol.h"
+#include "store.h"
+#include "registry.h"
+#include "cache.h"
+#include "sched.h"
+
+#define ROUTER_MAX_IFACES 8	/* Max number of transmitters, one worker each */
+#define RFCTL_SOCKET      "/run/rfctl.sock"
+
+/* Per command options, trailing words of a command line */
+struct txopt {
+	bool            force;	/* Bypass state cache */
+	int             prio;	/* PRIO_HIGH, PRIO_NORMAL, PRIO_LOW */
+	int             deadline;	/* Drop if not sent within, ms, 0: none */
+};
+
+/* One command encoded ahead of time, see router_prepare() */
+struct txframe {
+	rf_protocol_t   protocol;
+	char            group[16];
+	char            channel[16];
+	char            level[16];
+
+	const struct route *route;
+	const int32_t  *bitstream;	/* Caller's buffer, or frame store */
+	bool            frames;		/* All repeats back-to-back */
+	int             len;
+	int             repeat;
+	long long       airtime;
+};
+
+struct router;
+struct schedule;
+
+/* One worker thread per transmitter */
+struct worker {
+	struct router  *router;
+	struct iface    ifc;
+	rf_interface_t  type;
+	char            device[64];
+
+	pthread_t       thread;
+	pthread_mutex_t lock;
+	pthread_cond_t  cond;
+	struct job     *head;	/* Sorted, see sched_insert() */
+	int             queued;
+	int             batched;	/* Sent, but held by interface */
+	long long       batched_air;	/* Airtime of batched commands */
+	bool            started;
+	bool            open;	/* Opened on first command */
+	bool            stop;
+
+	struct duty     duty;	/* Airtime budget */
+	int             count;	/* Commands sent */
+	int             expired;	/* Commands dropped, deadline passed */
+	int             failed;		/* Commands not sent, open or write error */
+	long long       airtime;	/* Total airtime sent, in us */
+};
+
+/* Device address to transmitter(s), '*' matches any group/channel */
+struct route {
+	rf_protocol_t   protocol;	/* PROT_UNKNOWN matches any */
+	char            group[16];
+	char            channel[16];
+	int             num;
+	int             target[ROUTER_MAX_IFACES];
+};
+
+struct router {
+	struct worker   worker[ROUTER_MAX_IFACES];
+	int             num_workers;
+
+	struct route   *route;
+	int             num_routes;
+
+	const struct store *store;	/* Optional precomputed frames */
+	const struct registry *reg;	/* Optional device names */
+	struct cache   *cache;		/* Optional state cache */
+	struct schedule *schedule;	/* Optional timed scenes */
+	double          duty;		/* Duty cycle budget, percent, 0: none */
+	int             duty_window;	/* Sliding window, seconds */
+
+	pthread_mutex_t lock;
+	pthread_cond_t  idle;
+	int             pending;	/* Jobs queued or in flight */
+};
+
+int  router_init      (struct router *r);
+int  router_load      (struct router *r, const char *file);
+int  router_default   (struct router *r, rf_interface_t type, const char *device);
+int  router_registry  (struct router *r, const struct registry *reg);
+int  router_start     (struct router *r);
+int  router_prepare   (struct router *r, rf_protocol_t protocol, const char *group,
+		       const char *channel, const char *level, struct txframe *f, int32_t *buf);
+int  router_queue     (struct router *r, const struct txframe *f, const struct txopt *opt);
+int  router_send      (struct router *r, rf_protocol_t protocol, const char *group,
+		       const char *channel, const char *level, const struct txopt *opt);
+int  router_cmd       (struct router *r, char *line);
+int  router_file      (struct router *r, FILE *fp);
+void router_idle      (struct router *r);
+int  router_stats     (struct router *r, char *buf, size_t len);
+void router_wait      (struct router *r);
+int  router_exit      (struct router *r);
+
+int  daemon_run       (struct router *r, const char *path, atomic_bool *running);
+
+#endif /* RFCTL_ROUTER_H_ */
@@ -0,0 +1,636 @@
+/* Control tool for NEXA and other RF remote receivers
+ *
+ * Copyright (C) 2010, 2012  Tord Andersson <tord.andersson@endian.se>
+ * Copyright (C) 2017        Joachim Nilsson <troglobit@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, visit the Free Software Foundation
+ * website at http://www.gnu.org/licenses/gpl-2.0.html or write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "common.h"
+#include "rx.h"
+#include "learn.h"
+#include "flight.h"
+
+static void pause_ms(int ms)
+{
+	struct timespec ts = { .tv_sec = ms / 1000, .tv_nsec = (ms % 1000) * 1000000L };
+
+	nanosleep(&ts, NULL);
+}
+
+static int ring_init(struct rx_ring *ring)
+{
+	pthread_condattr_t attr;
+
+	memset(ring, 0, sizeof(*ring));
+	ring->buf = malloc(RX_RING * sizeof(*ring->buf));
+	if (!ring->buf)
+		return -1;
+
+	atomic_init(&ring->head, 0);
+	atomic_init(&ring->tail, 0);
+	atomic_init(&ring->sleeping, 0);
+	pthread_mutex_init(&ring->lock, NULL);
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&ring->cond, &attr);
+	pthread_condattr_destroy(&attr);
+
+	return 0;
+}
+
+static void ring_exit(struct rx_ring *ring)
+{
+	if (!ring->buf)
+		return;
+
+	pthread_cond_destroy(&ring->cond);
+	pthread_mutex_destroy(&ring->lock);
+	free(ring->buf);
+	ring->buf = NULL;
+}
+
+static unsigned int ring_used(struct rx_ring *ring)
+{
+	return atomic_load(&ring->head) - atomic_load(&ring->tail);
+}
+
+/*
+ * Wake up the other side if it sleeps on the ring, after head or tail
+ * has moved.  Paired with the fence in ring_sleep(), either this sees
+ * the sleeper or the sleeper sees the move.  The lock is held by the
+ * sleeper until it waits, so the signal cannot be lost.  Both sides
+ * may briefly be counted as sleeping, so all are woken.
+ */
+static void ring_wake(struct rx_ring *ring)
+{
+	atomic_thread_fence(memory_order_seq_cst);
+	if (!atomic_load_explicit(&ring->sleeping, memory_order_relaxed))
+		return;
+
+	pthread_mutex_lock(&ring->lock);
+	pthread_cond_broadcast(&ring->cond);
+	pthread_mutex_unlock(&ring->lock);
+}
+
+/*
+ * Sleep until the other side moves head or tail, or at most @ms, if
+ * the ring is still empty, or with @full still full.  Returns ETIMEDOUT
+ * if nothing happened, otherwise 0.
+ */
+static int ring_sleep(struct rx_ring *ring, bool full, int ms)
+{
+	struct timespec ts;
+	unsigned int used;
+	int rc = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	ts.tv_sec  += ms / 1000;
+	ts.tv_nsec += (ms % 1000) * 1000000L;
+	if (ts.tv_nsec >= 1000000000L) {
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000000000L;
+	}
+
+	pthread_mutex_lock(&ring->lock);
+	atomic_fetch_add_explicit(&ring->sleeping, 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_seq_cst);
+	used = ring_used(ring);
+	if (full ? used == RX_RING : used == 0)
+		rc = pthread_cond_timedwait(&ring->cond, &ring->lock, &ts);
+	atomic_fetch_sub_explicit(&ring->sleeping, 1, memory_order_relaxed);
+	pthread_mutex_unlock(&ring->lock);
+
+	return rc;
+}
+
+/* Producer side, returns -1 if the ring is full */
+static int ring_put(struct rx_ring *ring, const struct rx_event *ev)
+{
+	unsigned int head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+	if (head - tail == RX_RING) {
+		ring->full++;
+		return -1;
+	}
+	if (head - tail + 1 > ring->peak)
+		ring->peak = head - tail + 1;
+
+	ring->buf[head & (RX_RING - 1)] = *ev;
+	atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+
+	/* Wake consumer for a batch, or when the producer is done for now */
+	if (head + 1 - tail >= RX_RING / 4)
+		ring_wake(ring);
+
+	return 0;
+}
+
+/* Consumer side, returns -1 if the ring is empty */
+static int ring_get(struct rx_ring *ring, struct rx_event *ev)
+{
+	unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+	unsigned int head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+	if (head == tail)
+		return -1;
+
+	*ev = ring->buf[tail & (RX_RING - 1)];
+	atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+
+	/* Producer waiting for room sleeps until half of it is free */
+	if (head - (tail + 1) == RX_RING / 2)
+		ring_wake(ring);
+
+	return 0;
+}
+
+/* Downstream of the reader it is fine to wait for room */
+static void ring_wait(struct rx_ring *ring, const struct rx_event *ev)
+{
+	while (ring_put(ring, ev)) {
+		ring_wake(ring);
+		ring_sleep(ring, true, RX_IDLE);
+	}
+}
+
+/*
+ * Only moves elements from the source to the edges ring.  With a lossy
+ * source it never waits for the decoder, what does not fit is dropped.
+ */
+static void *reader(void *arg)
+{
+	struct rx *rx = arg;
+	struct rx_event ev = { .type = RX_EDGE };
+	int32_t buf[RX_BATCH];
+	int64_t time;
+	int i, num;
+
+	while (*rx->running) {
+		num = rx->source(rx->arg, buf, NELEMS(buf), &time);
+		if (num < 0)
+			break;
+		if (num == 0) {
+			pause_ms(10);
+			continue;
+		}
+
+		rx->reads++;
+		rx->elements += num;
+		for (i = 0; i < num; i++) {
+			ev.val  = buf[i];
+			ev.time = time;
+			time   += LIRC_VALUE(buf[i]);
+
+			if (!rx->lossy)
+				ring_wait(&rx->edges, &ev);
+			else if (ring_put(&rx->edges, &ev))
+				atomic_fetch_add(&rx->dropped, 1);
+		}
+		ring_wake(&rx->edges);
+	}
+
+	atomic_store(&rx->read_done, true);
+	ring_wake(&rx->edges);
+
+	return NULL;
+}
+
+/* Max silence between repeats of a held button, longer is a new press */
+int64_t rx_repeat_gap(int protocol)
+{
+	switch (protocol) {
+	case PROT_NEXA_L:
+		return 4 * NEXA_L_PAUSE_PERIOD;
+
+	case PROT_SARTANO:
+	case PROT_IMPULS:
+		return 4 * SARTANO_SYNC_PERIOD;
+
+	case PROT_IKEA:
+		return 4 * IKEA_SYNC_PERIOD;
+
+	default:
+		return 4 * NEXA_SYNC_PERIOD;
+	}
+}
+
+/* Hand over held command, it is not repeated anymore */
+static void release(struct rx_decoder *dec)
+{
+	if (!dec->held.count)
+		return;
+
+	dec->emit(dec->arg, &dec->held);
+	dec->held.count = 0;
+}
+
+/* Hold on to a command while it repeats, only emit it when it stops */
+static void hold(struct rx_decoder *dec, const struct rfctl_cmd *cmd, int64_t start, int64_t end)
+{
+	struct rx_event *ev = &dec->held;
+
+	if (ev->count && !memcmp(&ev->cmd, cmd, sizeof(*cmd)) &&
+	    start - ev->end <= rx_repeat_gap(cmd->protocol)) {
+		ev->last = start;
+		ev->end  = end;
+		ev->count++;
+		dec->repeats++;
+		return;
+	}
+
+	release(dec);
+	ev->type  = RX_CMD;
+	ev->cmd   = *cmd;
+	ev->time  = start;
+	ev->last  = start;
+	ev->end   = end;
+	ev->count = 1;
+}
+
+/*
+ * Decode all commands in elements since the last gap, using windows
+ * adapted to this source.  Each decoded frame is learned from, as the
+ * protocol it decoded as.
+ */
+static void decode(struct rx_decoder *dec)
+{
+	uint16_t sym[RF_MAX_FRAME_BITS];
+	struct rfctl_cmd cmd;
+	int64_t end = dec->start;
+	size_t pos = 0, i;
+	int num;
+
+	if (!dec->num)
+		return;
+
+	/* Up to the gap that ended the frame */
+	for (i = 0; i + 1 < dec->num; i++)
+		end += LIRC_VALUE(dec->frame[i]);
+
+	dec->frames++;
+	rf_classify(&dec->adapt.win, dec->frame, dec->num, sym);
+	while ((num = rf_decode_sym(&dec->frame[pos], &sym[pos], dec->num - pos, &cmd)) > 0) {
+		rf_adapt_frame(&dec->adapt, cmd.protocol, &dec->frame[pos], num);
+		pos += num;
+		dec->commands++;
+		hold(dec, &cmd, dec->start, end);
+	}
+
+	/* Likely a protocol without a decoder, rather than noise */
+	if (!pos && dec->num >= RX_FRAME)
+		dec->undecoded++;
+	dec->num = 0;
+}
+
+void rx_decoder_init(struct rx_decoder *dec, void (*emit)(void *, const struct rx_event *),
+		     void *arg)
+{
+	memset(dec, 0, sizeof(*dec));
+	rf_adapt_init(&dec->adapt);
+	dec->emit = emit;
+	dec->arg  = arg;
+}
+
+/* Add element starting at wall-clock @time, returns true if it was a gap */
+bool rx_decoder_edge(struct rx_decoder *dec, int32_t val, int64_t time)
+{
+	if (!dec->num)
+		dec->start = time;
+	if (dec->num < NELEMS(dec->frame))
+		dec->frame[dec->num++] = val;
+	if (LIRC_IS_TIMEOUT(val) || (LIRC_IS_SPACE(val) && LIRC_VALUE(val) >= RX_GAP)) {
+		decode(dec);
+		return true;
+	}
+
+	return false;
+}
+
+/* Live, a command held long enough is not repeated */
+void rx_decoder_idle(struct rx_decoder *dec, int64_t now)
+{
+	if (dec->held.count && now - dec->held.end > rx_repeat_gap(dec->held.cmd.protocol))
+		release(dec);
+}
+
+/* End of source, decode what is left and emit the held command */
+void rx_decoder_flush(struct rx_decoder *dec)
+{
+	decode(dec);
+	release(dec);
+}
+
+/*
+ * The flight recorder is fed here, where it costs the reader nothing.
+ * It dumps on request, and when the reader has had to drop elements.
+ */
+static void flight(struct rx *rx, unsigned long *dropped)
+{
+	unsigned long num = atomic_load_explicit(&rx->dropped, memory_order_relaxed);
+
+	flight_poll(rx->flight);
+	if (num != *dropped) {
+		*dropped = num;
+		flight_anomaly(rx->flight, "overrun");
+	}
+}
+
+static void queue(void *arg, const struct rx_event *ev)
+{
+	struct rx *rx = arg;
+
+	ring_wait(&rx->events, ev);
+}
+
+static void *decoder(void *arg)
+{
+	struct rx *rx = arg;
+	unsigned long dropped = 0;
+	struct rx_event ev;
+
+	while (1) {
+		if (rx->flight)
+			flight(rx, &dropped);
+
+		if (ring_get(&rx->edges, &ev)) {
+			if (atomic_load(&rx->read_done) && !ring_used(&rx->edges))
+				break;
+
+			if (rx->lossy)
+				rx_decoder_idle(&rx->dec, capture_now());
+			ring_wake(&rx->events);
+			ring_sleep(&rx->edges, false, RX_WAKE);
+			continue;
+		}
+
+		ring_wait(&rx->events, &ev);
+		if (rx->flight)
+			flight_add(rx->flight, ev.val, ev.time);
+
+		rx_decoder_edge(&rx->dec, ev.val, ev.time);
+	}
+	rx_decoder_flush(&rx->dec);
+
+	atomic_store(&rx->decode_done, true);
+	ring_wake(&rx->events);
+
+	return NULL;
+}
+
+/* Same text for a command in live and offline output */
+int rx_cmd_str(const struct rfctl_cmd *cmd, char *buf, size_t len)
+{
+	const char *name = rf_protocol_name(cmd->protocol);
+
+	switch (cmd->protocol) {
+	case PROT_NEXA:
+	case PROT_PROOVE:
+	case PROT_WAVEMAN:
+		return snprintf(buf, len, "%s %c %d %d", name, 'A' + cmd->address,
+				cmd->unit, cmd->level);
+
+	case PROT_NEXA_L:
+		if (!cmd->unit)
+			return snprintf(buf, len, "%s %u all %d", name, cmd->address, cmd->level);
+		break;
+
+	default:
+		break;
+	}
+
+	return snprintf(buf, len, "%s %u %d %d", name, cmd->address, cmd->unit, cmd->level);
+}
+
+/*
+ * Same output regardless of the interface it was read from.  When
+ * recording to a capture file only decoded commands are printed, and
+ * when learning only progress.
+ */
+static int output(struct rx *rx, const struct rx_event *ev)
+{
+	char str[64];
+
+	switch (ev->type) {
+	case RX_EDGE:
+		if (rx->learn) {
+			int presses = rx->learn->presses;
+
+			if (learn_edge(rx->learn, ev->val))
+				*rx->running = false;
+			if (rx->learn->presses > presses)
+				printf("\nPress %d of %d", rx->learn->presses, rx->learn->max);
+			break;
+		}
+		if (rx->out)
+			return capture_write(rx->out, &ev->val, 1, ev->time + LIRC_VALUE(ev->val));
+
+		if (LIRC_IS_TIMEOUT(ev->val))
+			printf("\nRX Timeout");
+		else if (LIRC_IS_PULSE(ev->val))
+			printf("\n1 - %05d us", LIRC_VALUE(ev->val));
+		else if (LIRC_IS_SPACE(ev->val))
+			printf("\n0 - %05d us", LIRC_VALUE(ev->val));
+		break;
+
+	case RX_CMD:
+		if (rx->learn)
+			break;
+		rx_cmd_str(&ev->cmd, str, sizeof(str));
+		printf("\n%s", str);
+		PRINT("  # %d frames in %lld ms", ev->count, (long long)(ev->last - ev->time) / 1000);
+		break;
+	}
+
+	return 0;
+}
+
+int rx_init(struct rx *rx, rx_source_t *source, void *arg, bool lossy)
+{
+	memset(rx, 0, sizeof(*rx));
+	rx->source = source;
+	rx->arg    = arg;
+	rx->lossy  = lossy;
+	rx_decoder_init(&rx->dec, queue, rx);
+	atomic_init(&rx->read_done, false);
+	atomic_init(&rx->decode_done, false);
+	atomic_init(&rx->dropped, 0);
+
+	if (ring_init(&rx->edges) || ring_init(&rx->events)) {
+		rx_exit(rx);
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Run reader and decoder threads, output runs in the calling thread,
+ * until the source ends or *running is cleared.  Output is flushed,
+ * and a dot printed, after RX_IDLE ms without events.
+ */
+int rx_run(struct rx *rx, atomic_bool *running)
+{
+	pthread_t rd, dec;
+	struct rx_event ev;
+	int rc = 0;
+
+	rx->running = running;
+	if (pthread_create(&rd, NULL, reader, rx))
+		return -1;
+	if (pthread_create(&dec, NULL, decoder, rx)) {
+		*running = false;
+		pthread_join(rd, NULL);
+		return -1;
+	}
+
+	while (1) {
+		if (!ring_get(&rx->events, &ev)) {
+			if (!rc && output(rx, &ev)) {
+				perror("Error writing capture file");
+				*running = false;
+				rc = -1;
+			}
+			continue;
+		}
+
+		if (atomic_load(&rx->decode_done) && !ring_used(&rx->events))
+			break;
+
+		if (ring_sleep(&rx->events, false, RX_IDLE) != ETIMEDOUT)
+			continue;
+
+		if (!rc && rx->out && capture_flush(rx->out)) {
+			perror("Error writing capture file");
+			*running = false;
+			rc = -1;
+		}
+		if (!rx->out && !rx->learn && rx->lossy)
+			printf(".");
+		fflush(stdout);
+	}
+
+	pthread_join(rd, NULL);
+	pthread_join(dec, NULL);
+	printf("\n");
+
+	return rc;
+}
+
+void rx_report(const struct rx *rx)
+{
+	int32_t s, l;
+
+	PRINT("Read %lu elements in %lu reads, %lu frames, %lu commands, %lu repeats, %lu undecoded\n",
+	      rx->elements, rx->reads, rx->dec.frames, rx->dec.commands, rx->dec.repeats,
+	      rx->dec.undecoded);
+	PRINT("Edges ring  peak %u/%d, %lu times full\n", rx->edges.peak, RX_RING, rx->edges.full);
+	PRINT("Events ring peak %u/%d, %lu times full\n", rx->events.peak, RX_RING, rx->events.full);
+	if (rx->dec.adapt.level[0]) {
+		rf_adapt_nominal(&s, &l);
+		PRINT("NEXA_L timing short %d long %d us, nominal %d/%d\n",
+		      rx->dec.adapt.level[0], rx->dec.adapt.level[1], s, l);
+	}
+	if (rx->flight)
+		PRINT("Flight recorder %lu dumps, %lu missed while busy\n", rx->flight->dumps,
+		      rx->flight->missed);
+	if (atomic_load(&rx->dropped))
+		fprintf(stderr, "Dropped %lu elements, decoder or output too slow\n",
+			atomic_load(&rx->dropped));
+}
+
+void rx_exit(struct rx *rx)
+{
+	ring_exit(&rx->edges);
+	ring_exit(&rx->events);
+}
+
+/*
+ * Read what is available from a live interface, rfctl.ko returns LIRC
+ * mode2 elements and CUL sticks text that is parsed here.  The time of
+ * the first element is derived from when the read returned.
+ */
+int rx_from_iface(void *arg, int32_t *buf, int max, int64_t *time)
+{
+	struct rx_iface *ri = arg;
+	size_t used;
+	int num = 0, i, len;
+
+	if (ri->ifc->type == IFC_CUL) {
+		if (!ri->len) {
+			len = read(ri->ifc->fd, ri->buf, sizeof(ri->buf));
+			if (len <= 0)
+				goto idle;
+			ri->pos = ri->buf;
+			ri->len = len;
+		}
+
+		/* Partial lines are kept in cul until next read */
+		while (ri->len > 0 && num < max) {
+			num += cul443_rx_parse(&ri->cul, ri->pos, ri->len, &buf[num], max - num, &used);
+			ri->pos += used;
+			ri->len -= used;
+			if (!used)
+				break;
+		}
+	} else {
+		len = read(ri->ifc->fd, buf, max * sizeof(*buf));
+		if (len <= 0 || len % sizeof(*buf))
+			goto idle;
+		num = len / sizeof(*buf);
+	}
+
+	*time = capture_now();
+	for (i = 0; i < num; i++)
+		*time -= LIRC_VALUE(buf[i]);
+
+	return num;
+idle:
+	if (len < 0 && errno != EAGAIN && errno != EINTR)
+		ri->errors++;
+
+	return 0;
+}
+
+int rx_from_capture(void *arg, int32_t *buf, int max, int64_t *time)
+{
+	struct rx_capture *rc = arg;
+	int num, i;
+
+	num = capture_read(&rc->cap, buf, max, time);
+	if (num < 0)
+		rc->corrupt = true;
+	if (num <= 0)
+		return -1;
+
+	if (rc->end) {
+		int64_t t = *time;
+
+		for (i = 0; i < num; i++) {
+			if (t >= rc->end)
+				return i ? i : -1;
+			t += LIRC_VALUE(buf[i]);
+		}
+	}
+
+	return num;
+}
@@ -0,0 +1,164 @@
+/* Control tool for NEXA and other RF remote receivers
+ *
+ * Copyright (C) 2010, 2012  Tord Andersson <tord.andersson@endian.se>
+ * Copyright (C) 2017        Joachim Nilsson <troglobit@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, visit the Free Software Foundation
+ * website at http://www.gnu.org/licenses/gpl-2.0.html or write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef RFCTL_RX_H_
+#define RFCTL_RX_H_
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "protocol.h"
+#include "capture.h"
+
+#define RX_GAP   5000		/* Space, in us, that ends a received frame */
+#define RX_FRAME 48		/* Elements in shortest frame of any protocol */
+#define RX_RING  16384		/* Events per ring, power of two */
+#define RX_BATCH 512		/* Max elements per read from source */
+#define RX_IDLE  100		/* ms without events before output is flushed */
+#define RX_WAKE  10		/* Max ms decoder sleeps, to release held commands */
+
+enum {
+	RX_EDGE,
+	RX_CMD,
+};
+
+/*
+ * Repeats of a command, as long as a button is held, are one RX_CMD
+ * event.  It has the start of the first and of the last frame, the end
+ * of the last frame, and the number of frames.
+ */
+struct rx_event {
+	int              type;
+	int32_t          val;		/* RX_EDGE, LIRC mode2 element */
+	int64_t          time;		/* Wall-clock start, us */
+	struct rfctl_cmd cmd;		/* RX_CMD */
+	int64_t          last;		/* RX_CMD, start of last repeat */
+	int64_t          end;		/* RX_CMD, end of last repeat */
+	int              count;		/* RX_CMD, frames */
+};
+
+/*
+ * Splits elements into frames at gaps, decodes them with windows adapted
+ * to the source, and holds on to a command until it stops repeating.
+ * Commands are handed to @emit, used both by the live pipeline and by
+ * offline decoding.
+ */
+struct rx_decoder {
+	int32_t          frame[RF_MAX_FRAME_BITS];
+	size_t           num;
+	int64_t          start;		/* Of frame */
+	struct rf_adapt  adapt;		/* Timing learned from this source */
+	struct rx_event  held;		/* Command, until it stops repeating */
+
+	void           (*emit)(void *arg, const struct rx_event *ev);
+	void            *arg;
+
+	unsigned long    frames, commands, repeats;
+	unsigned long    undecoded;	/* Frames long enough, but no command */
+};
+
+/*
+ * Single producer, single consumer ring.  Only the producer moves head
+ * and only the consumer moves tail, so no locks are needed.  They are
+ * on separate cache lines to not bounce between the two threads.  The
+ * lock is only taken to sleep on an empty, or full, ring, and by the
+ * other side to wake it up.
+ */
+struct rx_ring {
+	struct rx_event          *buf;
+	_Alignas(64) atomic_uint  head;
+	_Alignas(64) atomic_uint  tail;
+	unsigned int              peak;		/* Highest occupancy, producer */
+	unsigned long             full;		/* Times producer found it full */
+
+	_Alignas(64) atomic_int   sleeping;	/* Threads waiting, at most two */
+	pthread_mutex_t           lock;
+	pthread_cond_t            cond;
+};
+
+struct learn;
+struct flight;
+
+/* Source of elements, returns number read, 0 when idle, -1 at the end */
+typedef int (rx_source_t)(void *arg, int32_t *buf, int max, int64_t *time);
+
+/* Live interface source */
+struct rx_iface {
+	struct iface  *ifc;
+	struct cul_rx  cul;
+	char           buf[RF_MAX_RX_BITS];	/* CUL text not yet parsed */
+	char          *pos;
+	int            len;
+	unsigned long  errors;			/* Failed reads */
+};
+
+/* Capture file source, ends at wall-clock @end, unless 0 */
+struct rx_capture {
+	struct capture cap;
+	int64_t        end;
+	bool           corrupt;
+};
+
+/*
+ * Reception pipeline, a reader thread moves elements from the source
+ * to the edges ring, a decoder thread moves them on to the events ring
+ * along with decoded commands, and the caller prints or records them.
+ * With a lossy source, e.g. a live interface, the reader never waits,
+ * elements that do not fit are dropped and counted.
+ */
+struct rx {
+	rx_source_t        *source;
+	void               *arg;
+	bool                lossy;
+	struct capture_out *out;		/* Record edges instead of printing */
+	struct learn       *learn;		/* Learn a remote instead of printing */
+	struct flight      *flight;		/* Recent elements, for dumps */
+
+	struct rx_ring      edges;
+	struct rx_ring      events;
+	atomic_bool         read_done;
+	atomic_bool         decode_done;
+	atomic_bool        *running;
+
+	struct rx_decoder   dec;
+
+	unsigned long       reads, elements;
+	atomic_ulong        dropped;
+};
+
+void rx_decoder_init  (struct rx_decoder *dec, void (*emit)(void *, const struct rx_event *),
+		       void *arg);
+bool rx_decoder_edge  (struct rx_decoder *dec, int32_t val, int64_t time);
+void rx_decoder_idle  (struct rx_decoder *dec, int64_t now);
+void rx_decoder_flush (struct rx_decoder *dec);
+int  rx_cmd_str       (const struct rfctl_cmd *cmd, char *buf, size_t len);
+int64_t rx_repeat_gap (int protocol);
+
+int  rx_init          (struct rx *rx, rx_source_t *source, void *arg, bool lossy);
+int  rx_run           (struct rx *rx, atomic_bool *running);
+void rx_report        (const struct rx *rx);
+void rx_exit          (struct rx *rx);
+
+int  rx_from_iface    (void *arg, int32_t *buf, int max, int64_t *time);
+int  rx_from_capture  (void *arg, int32_t *buf, int max, int64_t *time);
+
+#endif /* RFCTL_RX_H_ */
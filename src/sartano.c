@@ -23,13 +23,14 @@
 #include "common.h"
 #include "protocol.h"
 
-static int manchester(const char *bitstring, int32_t bitstream[])
+/* Encode the lowest @num bits of @code, most significant bit first */
+static int manchester(unsigned int code, int num, int32_t bitstream[])
 {
 	int i = 0;
-	const char *bit = bitstring;
+	int bit;
 
-	while (*bit) {
-		if (*bit == '1') {
+	for (bit = num - 1; bit >= 0; bit--) {
+		if (code & (1 << bit)) {
 			bitstream[i++] = LIRC_PULSE(SARTANO_SHORT_PERIOD);
 			bitstream[i++] = LIRC_SPACE(SARTANO_LONG_PERIOD);
 			bitstream[i++] = LIRC_PULSE(SARTANO_SHORT_PERIOD);
@@ -40,32 +41,41 @@ static int manchester(const char *bitstring, int32_t bitstream[])
 			bitstream[i++] = LIRC_PULSE(SARTANO_LONG_PERIOD);
 			bitstream[i++] = LIRC_SPACE(SARTANO_SHORT_PERIOD);
 		}
-
-		bit++;
 	}
 
 	return i;
 }
 
-int sartano_bitstream(const char *chan, const char *onoff, int32_t *bitstream, int *repeat)
+/* Convert a string of ten '0' and '1' to a 10-bit code, first is MSB */
+int sartano_code(const char *chan)
 {
-	int i = 0;
-	int enable;
+	int code = 0;
+	int i;
 
-	enable = atoi(onoff);	/* ON/OFF 0..1 */
-	*repeat = SARTANO_REPEAT;
+	if (strlen(chan) != 10)
+		return -1;
+
+	for (i = 0; i < 10; i++)
+		code = (code << 1) | (chan[i] == '1');
+
+	return code;
+}
 
-	PRINT("Channel: %s, onoff: %d\n", chan, enable);
+/*
+ * Encode one frame from an already parsed 10-bit channel code and
+ * on/off, returns number of elements, or 0 on invalid arguments.
+ */
+int sartano_frame(int code, int enable, int32_t *bitstream)
+{
+	int i = 0;
 
 	/* Validate converted parameters */
-	if ((strlen(chan) != 10) || (enable < 0) || (enable > 1)) {
-		fprintf(stderr, "Invalid channel or on/off code\n");
+	if ((code < 0) || (code > 0x3FF) || (enable < 0) || (enable > 1))
 		return 0;
-	}
 
 	/* Convert channel and onoff to bitstream */
-	i  = manchester(chan, &bitstream[i]);
-	i += manchester(enable ? "10" : "01", &bitstream[i]);
+	i  = manchester(code, 10, &bitstream[i]);
+	i += manchester(enable ? 2 : 1, 2, &bitstream[i]);
 
 	/* Add stop/sync bit and command termination char '+' */
 	bitstream[i++] = LIRC_PULSE(SARTANO_SHORT_PERIOD);
@@ -74,6 +84,22 @@ int sartano_bitstream(const char *chan, const char *onoff, int32_t *bitstream, i
 	return i;
 }
 
+int sartano_bitstream(const char *chan, const char *onoff, int32_t *bitstream, int *repeat)
+{
+	*repeat = SARTANO_REPEAT;
+
+	return sartano_frame(sartano_code(chan), atoi(onoff), bitstream);
+}
+
+/* Convert CONRAD group 1..4 and channel 1..4 to SARTANO code, or -1 */
+int conrad_code(int group, int channel)
+{
+	if (group < 1 || group > 4 || channel < 1 || channel > 4)
+		return -1;
+
+	return (1 << (10 - group)) | (1 << (6 - channel));
+}
+
 /*
  * Encode the following pattern into a house(I..IV) and channel (1..4):
  *
@@ -101,34 +127,7 @@ int sartano_bitstream(const char *chan, const char *onoff, int32_t *bitstream, i
  */
 int conrad_bitstream(const char *house, const char *chan, const char *onoff, int32_t *bitstream, int *repeat)
 {
-	int i;
-	int group;
-	int channel;
-	char magic[20];
-
-	group   = atoi(house);
-	channel = atoi(chan);
-
-	if (group < 1 || group > 4 || channel < 1 || channel > 4) {
-		fprintf(stderr, "Invalid group(%d) or channel (%d).\nUse group 1..4, channel 1..4\n", group, channel);
-		return 0;
-	}
-
-	for (i = 0; i < 4; i++) {
-		if (i + 1 == group)
-			magic[i] = '1';
-		else
-			magic[i] = '0';
-	}
-	for (i = 0; i < 4; i++) {
-		if (i + 1 == channel)
-			magic[4 + i] = '1';
-		else
-			magic[4 + i] = '0';
-	}
-	magic[8] = '0';
-	magic[9] = '0';
-	magic[10] = 0;
+	*repeat = SARTANO_REPEAT;
 
-	return sartano_bitstream((const char *)magic, onoff, bitstream, repeat);
+	return sartano_frame(conrad_code(atoi(house), atoi(chan)), atoi(onoff), bitstream);
 }
@@ -0,0 +1,691 @@
+/* Control tool for NEXA and other RF remote receivers
+ *
+ * Copyright (C) 2010, 2012  Tord Andersson <tord.andersson@endian.se>
+ * Copyright (C) 2017        Joachim Nilsson <troglobit@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, visit the Free Software Foundation
+ * website at http://www.gnu.org/licenses/gpl-2.0.html or write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+
+#include "common.h"
+#include "scene.h"
+
+#define DEG2RAD(x)  ((x) * M_PI / 180.0)
+#define RAD2DEG(x)  ((x) * 180.0 / M_PI)
+
+static void *grow(void *ptr, int num, size_t size)
+{
+	/* Start with 16, then double when num reaches a power of two */
+	if (num && (num < 16 || (num & (num - 1))))
+		return ptr;
+
+	return realloc(ptr, (num ? num * 2 : 16) * size);
+}
+
+static double wrap(double val, double max)
+{
+	val = fmod(val, max);
+
+	return val < 0 ? val + max : val;
+}
+
+/*
+ * Sunrise or sunset, in UTC, for the local date in @tm.  Uses the
+ * algorithm from the Almanac for Computers, 1990, good to a minute or
+ * so, which is plenty for switching lights.  Returns -1 on days the sun
+ * does not rise or set at the given latitude.
+ */
+static int sun_time(const struct schedule *s, const struct tm *tm, int sun, time_t *t)
+{
+	double lng = s->lon / 15;
+	double base, noon, M, L, RA, sindec, cosdec, cosH, H, T, UT;
+	struct tm day = { .tm_year = tm->tm_year, .tm_mon = tm->tm_mon, .tm_mday = tm->tm_mday };
+
+	T  = tm->tm_yday + 1 + ((sun == SUN_RISE ? 6 : 18) - lng) / 24;
+	M  = 0.9856 * T - 3.289;
+	L  = wrap(M + 1.916 * sin(DEG2RAD(M)) + 0.020 * sin(DEG2RAD(2 * M)) + 282.634, 360);
+	RA = wrap(RAD2DEG(atan(0.91764 * tan(DEG2RAD(L)))), 360);
+	RA = (RA + floor(L / 90) * 90 - floor(RA / 90) * 90) / 15;
+
+	sindec = 0.39782 * sin(DEG2RAD(L));
+	cosdec = cos(asin(sindec));
+	cosH   = (cos(DEG2RAD(90.833)) - sindec * sin(DEG2RAD(s->lat))) /
+		 (cosdec * cos(DEG2RAD(s->lat)));
+	if (cosH > 1 || cosH < -1)
+		return -1;
+
+	H = RAD2DEG(acos(cosH));
+	if (sun == SUN_RISE)
+		H = 360 - H;
+	UT = wrap(H / 15 + RA - 0.06571 * T - 6.622 - lng, 24);
+
+	/* Keep within 12h of local solar noon, UT wraps at midnight */
+	base = timegm(&day);
+	noon = base + (12 - lng) * 3600;
+	*t = base + UT * 3600;
+	if (*t < noon - 43200)
+		*t += 86400;
+	else if (*t > noon + 43200)
+		*t -= 86400;
+
+	return 0;
+}
+
+/* Like cron, when both day fields are restricted either may match */
+static bool day_match(const struct event *ev, const struct tm *tm)
+{
+	bool dom = ev->dom & (1u << tm->tm_mday);
+	bool dow = ev->dow & (1u << tm->tm_wday);
+
+	if (!(ev->mon & (1u << (tm->tm_mon + 1))))
+		return false;
+	if (ev->dom_all || ev->dow_all)
+		return dom && dow;
+
+	return dom || dow;
+}
+
+static time_t cron_next(const struct event *ev, time_t after)
+{
+	struct tm tm;
+	time_t t;
+	int i;
+
+	localtime_r(&after, &tm);
+	tm.tm_sec = 0;
+	tm.tm_min++;
+
+	/* Skip whole days and hours that do not match, then minutes */
+	for (i = 0; i < 100000; i++) {
+		tm.tm_isdst = -1;
+		t = mktime(&tm);
+
+		if (!day_match(ev, &tm)) {
+			tm.tm_mday++;
+			tm.tm_hour = 0;
+			tm.tm_min = 0;
+		} else if (!(ev->hour & (1u << tm.tm_hour))) {
+			tm.tm_hour++;
+			tm.tm_min = 0;
+		} else if (!(ev->min & (1ull << tm.tm_min))) {
+			tm.tm_min++;
+		} else {
+			return t;
+		}
+	}
+
+	return 0;
+}
+
+static time_t sun_next(const struct schedule *s, const struct event *ev, time_t after)
+{
+	struct tm tm;
+	time_t t;
+	int i;
+
+	/* Start from yesterday, a negative offset may reach past midnight */
+	localtime_r(&after, &tm);
+	tm.tm_mday--;
+	for (i = 0; i < 1000; i++, tm.tm_mday++) {
+		tm.tm_hour = 12;
+		tm.tm_min = tm.tm_sec = 0;
+		tm.tm_isdst = -1;
+		mktime(&tm);
+
+		if (!day_match(ev, &tm) || sun_time(s, &tm, ev->sun, &t))
+			continue;
+
+		t += ev->offset * 60;
+		if (t > after)
+			return t;
+	}
+
+	return 0;
+}
+
+static time_t event_next(const struct schedule *s, const struct event *ev, time_t after)
+{
+	if (ev->sun != SUN_NONE)
+		return sun_next(s, ev, after);
+
+	return cron_next(ev, after);
+}
+
+static void wheel_add(struct schedule *s, struct event *ev)
+{
+	struct event **slot;
+
+	if (!ev->due)
+		return;
+
+	slot = &s->wheel[ev->due % SCHEDULE_SLOTS];
+	ev->next = *slot;
+	*slot = ev;
+}
+
+/* Cron field: '*', N, or N-M, with optional /STEP, comma separated */
+static int field(char *str, int lo, int hi, uint64_t *bits, bool *all)
+{
+	char *tok, *ptr;
+
+	*bits = 0;
+	if (all)
+		*all = !strcmp(str, "*");
+
+	for (tok = strtok_r(str, ",", &ptr); tok; tok = strtok_r(NULL, ",", &ptr)) {
+		int first, last, step = 1;
+		char *end;
+		int i;
+
+		if (*tok == '*') {
+			first = lo;
+			last = hi;
+			end = tok + 1;
+		} else {
+			first = last = strtol(tok, &end, 10);
+			if (end == tok)
+				return -1;
+			if (*end == '-') {
+				tok = end + 1;
+				last = strtol(tok, &end, 10);
+				if (end == tok)
+					return -1;
+			}
+		}
+
+		if (*end == '/') {
+			tok = end + 1;
+			step = strtol(tok, &end, 10);
+			if (end == tok || step <= 0)
+				return -1;
+		}
+
+		if (*end || first < lo || last > hi || first > last)
+			return -1;
+
+		for (i = first; i <= last; i += step)
+			*bits |= 1ull << i;
+	}
+
+	return 0;
+}
+
+static int scene_find(const struct schedule *s, const char *name)
+{
+	int i;
+
+	for (i = 0; i < s->num_scenes; i++) {
+		if (!strcmp(s->scene[i].name, name))
+			return i;
+	}
+
+	return -1;
+}
+
+/* Keep a copy of an encoded bitstream, frames from the store are kept */
+static int frame_keep(struct txframe *f)
+{
+	int32_t *copy;
+
+	if (f->frames)
+		return 0;
+
+	copy = malloc(f->len * sizeof(int32_t));
+	if (!copy)
+		return -1;
+	memcpy(copy, f->bitstream, f->len * sizeof(int32_t));
+	f->bitstream = copy;
+
+	return 0;
+}
+
+static void frame_free(struct txframe *f)
+{
+	if (!f->frames)
+		free((int32_t *)f->bitstream);
+}
+
+/* Encode one command, keeping a copy of the bitstream */
+static int frame_add(struct scene *sc, struct router *r, rf_protocol_t protocol,
+		     const char *group, const char *channel, const char *level)
+{
+	int32_t buf[RF_MAX_TX_BITS];
+	struct txframe *f;
+
+	f = grow(sc->frame, sc->num, sizeof(*f));
+	if (!f)
+		return -1;
+	sc->frame = f;
+
+	f = &sc->frame[sc->num];
+	if (router_prepare(r, protocol, group, channel, level, f, buf) || frame_keep(f))
+		return -1;
+	sc->num++;
+
+	return 0;
+}
+
+/* NEXA_L remote ID and unit of a frame, unit 0 is all units (group) */
+static int nexa_l_unit(const struct txframe *f, uint32_t *id)
+{
+	int unit;
+
+	if (f->protocol != PROT_NEXA_L || rf_address(f->protocol, f->group, f->channel, id, &unit))
+		return 0;
+
+	return unit;
+}
+
+/* Units learned to a NEXA_L remote ID, as a bit mask, from the registry */
+static uint32_t nexa_l_units(const struct registry *reg, uint32_t id)
+{
+	uint32_t mask = 0;
+	int i;
+
+	for (i = 0; i < reg->num_devs; i++) {
+		const struct reg_device *d = &reg->dev[i];
+		uint32_t addr;
+		int unit;
+
+		if (d->protocol != PROT_NEXA_L ||
+		    rf_address(d->protocol, d->group, d->channel, &addr, &unit) || addr != id)
+			continue;
+		mask |= 1u << unit;
+	}
+
+	return mask;
+}
+
+/*
+ * Replace commands to every unit registered on a NEXA_L remote ID, all
+ * with the same level, with one group frame.  All units act on it, so
+ * one transmission replaces one per unit.  Only when the group frame
+ * is routed to the same transmitters as the commands it replaces.
+ */
+static int scene_collapse(struct scene *sc, struct router *r)
+{
+	int i, j, k;
+
+	if (!r->reg)
+		return 0;
+
+	for (i = 0; i < sc->num; i++) {
+		struct txframe *f = &sc->frame[i];
+		int32_t buf[RF_MAX_TX_BITS];
+		uint32_t id, mask = 0;
+		struct txframe g;
+
+		if (!nexa_l_unit(f, &id))
+			continue;
+
+		for (j = i; j < sc->num; j++) {
+			struct txframe *m = &sc->frame[j];
+			uint32_t mid;
+			int unit;
+
+			unit = nexa_l_unit(m, &mid);
+			if (unit && mid == id && m->route == f->route && !strcmp(m->level, f->level))
+				mask |= 1u << unit;
+		}
+
+		if (!(mask & (mask - 1)) || mask != nexa_l_units(r->reg, id))
+			continue;
+
+		if (router_prepare(r, PROT_NEXA_L, f->group, "all", f->level, &g, buf) ||
+		    g.route != f->route)
+			continue;
+		if (frame_keep(&g))
+			return -1;
+
+		/* Drop the others, keep the order of remaining commands */
+		for (j = k = i + 1; j < sc->num; j++) {
+			struct txframe *m = &sc->frame[j];
+			uint32_t mid;
+
+			if (nexa_l_unit(m, &mid) && mid == id && m->route == f->route &&
+			    !strcmp(m->level, f->level)) {
+				frame_free(m);
+				continue;
+			}
+			sc->frame[k++] = *m;
+		}
+		sc->num = k;
+
+		PRINT("Scene %s, NEXA_L %s units collapsed to one group frame\n", sc->name, f->group);
+		frame_free(f);
+		*f = g;
+	}
+
+	return 0;
+}
+
+/* PROTO GROUP CHANNEL LEVEL, or NAME LEVEL from the registry */
+static int cmd_add(struct scene *sc, struct router *r, char *cmd)
+{
+	char *proto, *group, *channel, *level, *ptr;
+
+	proto = strtok_r(cmd, " \t\r\n", &ptr);
+	group = strtok_r(NULL, " \t\r\n", &ptr);
+	if (!proto || !group)
+		return -1;
+
+	if (rf_protocol(proto) == PROT_UNKNOWN && r->reg) {
+		const int *dev;
+		int i, num;
+
+		num = registry_lookup(r->reg, proto, &dev);
+		if (!num)
+			return -1;
+
+		for (i = 0; i < num; i++) {
+			const struct reg_device *d = &r->reg->dev[dev[i]];
+
+			if (frame_add(sc, r, d->protocol, d->group, d->channel, group))
+				return -1;
+		}
+
+		return 0;
+	}
+
+	channel = strtok_r(NULL, " \t\r\n", &ptr);
+	level   = strtok_r(NULL, " \t\r\n", &ptr);
+	if (!channel || !level)
+		return -1;
+
+	return frame_add(sc, r, rf_protocol(proto), group, channel, level);
+}
+
+/* Commands separated by ';', returns index of new scene */
+static int scene_add(struct schedule *s, struct router *r, const char *name, char *cmds)
+{
+	struct scene *sc;
+	char *cmd, *ptr;
+
+	if (scene_find(s, name) >= 0)
+		return -1;
+
+	sc = grow(s->scene, s->num_scenes, sizeof(*sc));
+	if (!sc)
+		return -1;
+	s->scene = sc;
+
+	sc = &s->scene[s->num_scenes++];
+	memset(sc, 0, sizeof(*sc));
+	strncpy(sc->name, name, SCENE_NAME_MAX - 1);
+
+	for (cmd = strtok_r(cmds, ";", &ptr); cmd; cmd = strtok_r(NULL, ";", &ptr)) {
+		if (cmd_add(sc, r, cmd))
+			return -1;
+	}
+
+	if (!sc->num || scene_collapse(sc, r))
+		return -1;
+
+	return s->num_scenes - 1;
+}
+
+/*
+ * MIN HOUR DOM MON DOW, or sunrise|sunset[+-MIN] DOM MON DOW, followed
+ * by a scene name, or the commands of an unnamed scene.
+ */
+static int event_add(struct schedule *s, struct router *r, char *first, char *ptr)
+{
+	char *tok[5] = { first };
+	struct event *ev;
+	uint64_t bits;
+	int i, num;
+
+	ev = grow(s->event, s->num_events, sizeof(*ev));
+	if (!ev)
+		return -1;
+	s->event = ev;
+
+	ev = &s->event[s->num_events];
+	memset(ev, 0, sizeof(*ev));
+	if (!strncmp(first, "sunrise", 7) || !strncmp(first, "sunset", 6)) {
+		char *end;
+
+		if (!s->located)
+			return -1;
+
+		ev->sun = first[3] == 'r' ? SUN_RISE : SUN_SET;
+		first += ev->sun == SUN_RISE ? 7 : 6;
+		ev->offset = strtol(first, &end, 10);
+		if (*end)
+			return -1;
+
+		num = 3;
+	} else {
+		num = 5;
+	}
+
+	for (i = num == 5 ? 1 : 0; i < num; i++) {
+		tok[i] = strtok_r(NULL, " \t\r\n", &ptr);
+		if (!tok[i])
+			return -1;
+	}
+
+	i = 0;
+	if (num == 5) {
+		if (field(tok[i++], 0, 59, &ev->min, NULL) ||
+		    field(tok[i++], 0, 23, &bits, NULL))
+			return -1;
+		ev->hour = bits;
+	}
+	if (field(tok[i++], 1, 31, &bits, &ev->dom_all))
+		return -1;
+	ev->dom = bits;
+	if (field(tok[i++], 1, 12, &bits, NULL))
+		return -1;
+	ev->mon = bits;
+	if (field(tok[i++], 0, 7, &bits, &ev->dow_all))
+		return -1;
+	ev->dow = bits | ((bits >> 7) & 1);	/* Sunday is 0 or 7 */
+
+	while (*ptr == ' ' || *ptr == '\t')
+		ptr++;
+	ptr[strcspn(ptr, "\r\n")] = 0;
+	if (!*ptr)
+		return -1;
+
+	ev->scene = scene_find(s, ptr);
+	if (ev->scene < 0)
+		ev->scene = scene_add(s, r, ptr, ptr);
+	if (ev->scene < 0)
+		return -1;
+
+	s->num_events++;
+
+	return 0;
+}
+
+/*
+ * Load schedule of scenes and when to send them.  All commands are
+ * encoded up front, so a scene goes on air on the second, without any
+ * process startup or encoding delay.  The router must be set up with
+ * the registry and routes first.
+ *
+ *     location  59.33 18.07
+ *     scene     evening  lights 1; NEXA A 3 1
+ *     # MIN HOUR DOM MON DOW, or sunrise|sunset[+-MIN] DOM MON DOW
+ *     sunset-30 *  * *       evening
+ *     30 23     *  * 1-5     lights 0
+ *
+ * On error schedule.lineno holds the offending line.
+ */
+int schedule_load(struct schedule *s, struct router *r, const char *file)
+{
+	char buf[1024];
+	FILE *fp;
+	int i;
+
+	memset(s, 0, sizeof(*s));
+
+	fp = fopen(file, "r");
+	if (!fp)
+		return -1;
+
+	while (fgets(buf, sizeof(buf), fp)) {
+		char *first, *name, *ptr;
+		int rc = -1;
+
+		s->lineno++;
+		first = strtok_r(buf, " \t\r\n", &ptr);
+		if (!first || first[0] == '#')
+			continue;
+
+		if (!strcmp(first, "location")) {
+			char *lat = strtok_r(NULL, " \t\r\n", &ptr);
+			char *lon = strtok_r(NULL, " \t\r\n", &ptr);
+
+			if (lat && lon) {
+				s->lat = atof(lat);
+				s->lon = atof(lon);
+				s->located = true;
+				rc = 0;
+			}
+		} else if (!strcmp(first, "scene")) {
+			name = strtok_r(NULL, " \t\r\n", &ptr);
+			if (name && scene_add(s, r, name, ptr) >= 0)
+				rc = 0;
+		} else {
+			rc = event_add(s, r, first, ptr);
+		}
+
+		if (rc) {
+			fclose(fp);
+			schedule_free(s);
+			errno = EINVAL;
+			return -1;
+		}
+	}
+
+	fclose(fp);
+	s->lineno = 0;
+
+	/* Events do not move anymore, safe to link them on the wheel */
+	s->now = time(NULL);
+	for (i = 0; i < s->num_events; i++) {
+		struct event *ev = &s->event[i];
+
+		ev->due = event_next(s, ev, s->now);
+		wheel_add(s, ev);
+	}
+
+	return 0;
+}
+
+static void scene_send(struct schedule *s, struct router *r, const struct scene *sc)
+{
+	int i;
+
+	PRINT("Scene %s, %d command(s)\n", sc->name, sc->num);
+	for (i = 0; i < sc->num; i++) {
+		if (router_queue(r, &sc->frame[i], NULL))
+			PRINT("Failed sending scene %s: %s\n", sc->name, strerror(errno));
+	}
+	s->fired++;
+}
+
+/*
+ * Fire all events due, called by the daemon at least once a second.
+ * Visits each wheel slot passed since the last call once, so a jump in
+ * time costs at most one round of the wheel.  Events more than the
+ * grace period late are skipped, only rescheduled.
+ */
+void schedule_run(struct schedule *s, struct router *r)
+{
+	struct timespec ts;
+	time_t now, t;
+
+	/* Not time(), it may lag behind and miss the exact second */
+	clock_gettime(CLOCK_REALTIME, &ts);
+	now = ts.tv_sec;
+
+	if (now <= s->now) {
+		s->now = now;
+		return;
+	}
+
+	t = now - s->now > SCHEDULE_SLOTS ? now - SCHEDULE_SLOTS : s->now;
+	while (t++ < now) {
+		struct event **pp = &s->wheel[t % SCHEDULE_SLOTS];
+		struct event *ev;
+
+		while ((ev = *pp)) {
+			if (ev->due > now) {
+				pp = &ev->next;
+				continue;
+			}
+
+			*pp = ev->next;
+			if (now - ev->due <= SCHEDULE_GRACE)
+				scene_send(s, r, &s->scene[ev->scene]);
+
+			ev->due = event_next(s, ev, now);
+			wheel_add(s, ev);
+		}
+	}
+
+	s->now = now;
+}
+
+/* Milliseconds to next event, at most @max, for the daemon's poll() */
+int schedule_timeout(const struct schedule *s, int max)
+{
+	struct timespec ts;
+	long long now;
+	time_t t;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	now = (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+
+	for (t = ts.tv_sec; t <= ts.tv_sec + max / 1000 + 1; t++) {
+		const struct event *ev;
+
+		for (ev = s->wheel[t % SCHEDULE_SLOTS]; ev; ev = ev->next) {
+			if (ev->due == t) {
+				if (t * 1000 - now < max)
+					max = t * 1000 - now;
+				return max < 0 ? 0 : max;
+			}
+		}
+	}
+
+	return max;
+}
+
+void schedule_free(struct schedule *s)
+{
+	int lineno = s->lineno;
+	int i, j;
+
+	for (i = 0; i < s->num_scenes; i++) {
+		struct scene *sc = &s->scene[i];
+
+		for (j = 0; j < sc->num; j++)
+			frame_free(&sc->frame[j]);
+		free(sc->frame);
+	}
+	free(s->scene);
+	free(s->event);
+	memset(s, 0, sizeof(*s));
+	s->lineno = lineno;
+}
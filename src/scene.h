@@ -0,0 +1,84 @@
+/* Control tool for NEXA and other RF remote receivers
+ *
+ * Copyright (C) 2010, 2012  Tord Andersson <tord.andersson@endian.se>
+ * Copyright (C) 2017        Joachim Nilsson <troglobit@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, visit the Free Software Foundation
+ * website at http://www.gnu.org/licenses/gpl-2.0.html or write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef RFCTL_SCENE_H_
+#define RFCTL_SCENE_H_
+
+#include <time.h>
+#include "router.h"
+
+#define SCENE_NAME_MAX   64
+#define SCHEDULE_SLOTS   64	/* Timer wheel, one slot per second */
+#define SCHEDULE_GRACE   60	/* Max seconds late, e.g. after clock change */
+
+#define SUN_NONE         0
+#define SUN_RISE         1
+#define SUN_SET          2
+
+/* Named list of commands, all encoded when the schedule is loaded */
+struct scene {
+	char            name[SCENE_NAME_MAX];
+	struct txframe *frame;
+	int             num;
+};
+
+/* Cron style, or sunrise/sunset, timed scene */
+struct event {
+	struct event   *next;	/* Timer wheel slot */
+	time_t          due;	/* Next time to fire, 0: never */
+
+	int             sun;	/* SUN_NONE, SUN_RISE, SUN_SET */
+	int             offset;	/* Minutes from sunrise/sunset */
+	uint64_t        min;	/* Bit masks of matching values */
+	uint32_t        hour;
+	uint32_t        dom;
+	uint16_t        mon;
+	uint8_t         dow;
+	bool            dom_all;
+	bool            dow_all;
+
+	int             scene;	/* Index in scene[] */
+};
+
+struct schedule {
+	double          lat, lon;	/* For sunrise/sunset */
+	bool            located;
+
+	struct scene   *scene;
+	int             num_scenes;
+
+	struct event   *event;
+	int             num_events;
+
+	struct event   *wheel[SCHEDULE_SLOTS];
+	time_t          now;		/* Last second run */
+	unsigned long   fired;
+
+	int             lineno;		/* line of last error in schedule_load() */
+};
+
+int  schedule_load    (struct schedule *s, struct router *r, const char *file);
+void schedule_run     (struct schedule *s, struct router *r);
+int  schedule_timeout (const struct schedule *s, int max);
+void schedule_free    (struct schedule *s);
+
+#endif /* RFCTL_SCENE_H_ */
@@ -0,0 +1,141 @@
+/* Control tool for NEXA and other RF remote receivers
+ *
+ * Copyright (C) 2010, 2012  Tord Andersson <tord.andersson@endian.se>
+ * Copyright (C) 2017        Joachim Nilsson <troglobit@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, visit the Free Software Foundation
+ * website at http://www.gnu.org/licenses/gpl-2.0.html or write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <time.h>
+
+#include "common.h"
+#include "sched.h"
+
+/* Exact time on air for one command, including all repeats */
+long long sched_airtime(const int32_t *bitstream, int len, int repeat)
+{
+	long long usec = 0;
+	int i;
+
+	for (i = 0; i < len; i++)
+		usec += LIRC_VALUE(bitstream[i]);
+
+	return usec * repeat;
+}
+
+long long sched_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* Jobs without deadline go after those with, same priority is FIFO */
+static bool before(struct job *a, struct job *b)
+{
+	if (a->prio != b->prio)
+		return a->prio < b->prio;
+	if (a->deadline && b->deadline)
+		return a->deadline < b->deadline;
+
+	return a->deadline && !b->deadline;
+}
+
+void sched_insert(struct job **head, struct job *job)
+{
+	struct job **pp = head;
+
+	while (*pp && !before(job, *pp))
+		pp = &(*pp)->next;
+
+	job->next = *pp;
+	*pp = job;
+}
+
+void duty_init(struct duty *d, double percent, int window)
+{
+	memset(d, 0, sizeof(*d));
+	if (window <= 0)
+		window = DUTY_WINDOW;
+
+	d->window = (long long)window * 1000000;
+	if (percent > 0 && percent < 100)
+		d->budget = d->window * percent / 100;
+}
+
+/* Slide window forward, clearing buckets that fell out of it */
+static void slide(struct duty *d, long long now)
+{
+	long long width = d->window / DUTY_BUCKETS;
+	long long idx = now / width;
+
+	if (idx - d->current >= DUTY_BUCKETS)
+		memset(d->bucket, 0, sizeof(d->bucket));
+	else
+		while (d->current < idx)
+			d->bucket[++d->current % DUTY_BUCKETS] = 0;
+
+	d->current = idx;
+}
+
+/* Airtime used in the current window */
+long long duty_used(struct duty *d, long long now)
+{
+	long long used = 0;
+	int i;
+
+	slide(d, now);
+	for (i = 0; i < DUTY_BUCKETS; i++)
+		used += d->bucket[i];
+
+	return used;
+}
+
+/*
+ * Returns 0 if @airtime fits in what is left of the budget, otherwise
+ * how long to wait, in us, until the oldest bucket leaves the window.
+ * Low priority work may only use part of the budget, leaving room for
+ * more urgent commands.
+ */
+long long duty_wait(struct duty *d, long long now, long long airtime, int prio)
+{
+	long long width = d->window / DUTY_BUCKETS;
+	long long budget = d->budget;
+
+	if (!budget)
+		return 0;
+
+	if (prio >= PRIO_LOW)
+		budget = budget * DUTY_LOW_SHARE / 100;
+
+	if (duty_used(d, now) + airtime <= budget)
+		return 0;
+
+	/* Will never fit, send anyway when the window is empty */
+	if (airtime > budget && duty_used(d, now) == 0)
+		return 0;
+
+	return (d->current + 1) * width - now;
+}
+
+void duty_add(struct duty *d, long long now, long long airtime)
+{
+	slide(d, now);
+	d->bucket[d->current % DUTY_BUCKETS] += airtime;
+}
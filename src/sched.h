@@ -0,0 +1,71 @@
+/* Control tool for NEXA and other RF remote receivers
+ *
+ * Copyright (C) 2010, 2012  Tord Andersson <tord.andersson@endian.se>
+ * Copyright (C) 2017        Joachim Nilsson <troglobit@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, visit the Free Software Foundation
+ * website at http://www.gnu.org/licenses/gpl-2.0.html or write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef RFCTL_SCHED_H_
+#define RFCTL_SCHED_H_
+
+#include "protocol.h"
+
+#define PRIO_HIGH        0
+#define PRIO_NORMAL      1
+#define PRIO_LOW         2	/* Bulk work, e.g. re-asserting state */
+
+#define DUTY_BUCKETS     60	/* Sliding window resolution */
+#define DUTY_WINDOW      3600	/* Default window, seconds */
+#define DUTY_LOW_SHARE   75	/* Percent of budget low priority may use */
+
+/*
+ * One encoded command queued on a worker, the bitstream is either in
+ * buf[] or points to all repeats back-to-back in the frame store.
+ * Queues are kept sorted on priority, then deadline, then arrival.
+ */
+struct job {
+	struct job     *next;
+	int             prio;
+	long long       deadline;	/* Monotonic us, 0: none */
+	long long       airtime;	/* Exact time on air, us */
+
+	const int32_t  *bitstream;
+	int             len;
+	int             repeat;
+	bool            frames;
+	int32_t         buf[];
+};
+
+/* Airtime budget over a sliding window, kept in buckets */
+struct duty {
+	long long       window;	/* us */
+	long long       budget;	/* us per window, 0: unlimited */
+	long long       bucket[DUTY_BUCKETS];
+	long long       current;	/* Absolute index of newest bucket */
+};
+
+long long sched_airtime (const int32_t *bitstream, int len, int repeat);
+long long sched_now     (void);
+void      sched_insert  (struct job **head, struct job *job);
+
+void      duty_init     (struct duty *d, double percent, int window);
+long long duty_used     (struct duty *d, long long now);
+long long duty_wait     (struct duty *d, long long now, long long airtime, int prio);
+void      duty_add      (struct duty *d, long long now, long long airtime);
+
+#endif /* RFCTL_SCHED_H_ */
@@ -0,0 +1,300 @@
+/* Control tool for NEXA and other RF remote receivers
+ *
+ * Copyright (C) 2010, 2012  Tord Andersson <tord.andersson@endian.se>
+ * Copyright (C) 2017        Joachim Nilsson <troglobit@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, visit the Free Software Foundation
+ * website at http://www.gnu.org/licenses/gpl-2.0.html or write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "common.h"
+#include "batch.h"
+#include "search.h"
+
+static int by_key(const void *a, const void *b)
+{
+	const struct search_ent *x = a, *y = b;
+
+	if (x->protocol != y->protocol)
+		return x->protocol < y->protocol ? -1 : 1;
+	if (x->address != y->address)
+		return x->address < y->address ? -1 : 1;
+	if (x->time != y->time)
+		return x->time < y->time ? -1 : 1;
+
+	return 0;
+}
+
+/* Entry sorts before the first of @protocol and @address */
+static int before(const struct search_ent *e, int protocol, uint32_t address)
+{
+	if (e->protocol != protocol)
+		return e->protocol < protocol;
+
+	return e->address < address;
+}
+
+/*
+ * Write index of all commands from a decoded batch, with absolute paths
+ * of its files so it can be searched from anywhere.
+ */
+int search_save(const struct batch *b, const char *path)
+{
+	struct search_hdr hdr = { .magic = SEARCH_MAGIC, .version = SEARCH_VERSION,
+				  .hdr_size = sizeof(hdr) };
+	struct search_file *file;
+	struct search_ent *ent;
+	char **name;
+	uint32_t len = 0;
+	size_t i;
+	FILE *fp;
+	int rc = -1;
+
+	file = calloc(b->files, sizeof(*file));
+	name = calloc(b->files, sizeof(*name));
+	ent  = calloc(b->num ? b->num : 1, sizeof(*ent));
+	if (!file || !name || !ent)
+		goto done;
+
+	for (i = 0; i < (size_t)b->files; i++) {
+		name[i] = realpath(b->name[i], NULL);
+		if (!name[i])
+			name[i] = strdup(b->name[i]);
+		if (!name[i])
+			goto done;
+
+		file[i].name   = len;
+		file[i].blocks = b->cap[i].num;
+		file[i].start  = b->cap[i].hdr->start;
+		len += strlen(name[i]) + 1;
+	}
+
+	for (i = 0; i < b->num; i++) {
+		const struct batch_hit *hit = &b->hit[i];
+		const struct capture *cap = &b->cap[hit->file];
+
+		ent[i].protocol = hit->ev.cmd.protocol;
+		ent[i].address  = hit->ev.cmd.address;
+		ent[i].unit     = hit->ev.cmd.unit;
+		ent[i].level    = hit->ev.cmd.level;
+		ent[i].time     = hit->ev.time;
+		ent[i].last     = hit->ev.last;
+		ent[i].count    = hit->ev.count;
+		ent[i].file     = hit->file;
+		ent[i].offset   = cap->idx[capture_find(cap, hit->ev.time)].offset;
+	}
+	qsort(ent, b->num, sizeof(*ent), by_key);
+
+	fp = fopen(path, "w");
+	if (!fp)
+		goto done;
+
+	hdr.files = b->files;
+	hdr.num   = b->num;
+	if (fwrite(&hdr, sizeof(hdr), 1, fp) != 1 ||
+	    fwrite(file, sizeof(*file), b->files, fp) != (size_t)b->files ||
+	    fwrite(ent, sizeof(*ent), b->num, fp) != b->num)
+		goto fail;
+	for (i = 0; i < (size_t)b->files; i++) {
+		if (fwrite(name[i], strlen(name[i]) + 1, 1, fp) != 1)
+			goto fail;
+	}
+	rc = 0;
+fail:
+	if (fclose(fp))
+		rc = -1;
+done:
+	for (i = 0; name && i < (size_t)b->files; i++)
+		free(name[i]);
+	free(name);
+	free(file);
+	free(ent);
+
+	return rc;
+}
+
+/* Map index read-only, validating header and table bounds */
+int search_open(struct search *s, const char *path)
+{
+	const struct search_hdr *hdr;
+	struct stat sb;
+	size_t need;
+	uint32_t i;
+	int fd;
+
+	memset(s, 0, sizeof(*s));
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	if (fstat(fd, &sb) || (size_t)sb.st_size < sizeof(*hdr)) {
+		close(fd);
+		errno = EINVAL;
+		return -1;
+	}
+
+	s->size = sb.st_size;
+	s->map = mmap(NULL, s->size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (s->map == MAP_FAILED) {
+		s->map = NULL;
+		return -1;
+	}
+
+	hdr = s->map;
+	need = sizeof(*hdr) + (size_t)hdr->files * sizeof(struct search_file) +
+		(size_t)hdr->num * sizeof(struct search_ent);
+	if (memcmp(hdr->magic, SEARCH_MAGIC, sizeof(hdr->magic)) ||
+	    hdr->version != SEARCH_VERSION || hdr->hdr_size != sizeof(*hdr) || need > s->size)
+		goto invalid;
+
+	s->hdr   = hdr;
+	s->file  = (const struct search_file *)&hdr[1];
+	s->ent   = (const struct search_ent *)&s->file[hdr->files];
+	s->names = (const char *)&s->ent[hdr->num];
+	s->len   = s->size - need;
+
+	/* Names must be in bounds and terminated */
+	if (s->len && s->names[s->len - 1])
+		goto invalid;
+	for (i = 0; i < hdr->files; i++) {
+		if (s->file[i].name >= s->len)
+			goto invalid;
+	}
+	for (i = 0; i < hdr->num; i++) {
+		if (s->ent[i].file >= hdr->files)
+			goto invalid;
+	}
+
+	return 0;
+invalid:
+	search_close(s);
+	errno = EINVAL;
+	return -1;
+}
+
+/*
+ * Entries of @protocol and @address, in time order, are [first, *end).
+ * Returns first, both are equal if there are none.
+ */
+size_t search_find(const struct search *s, int protocol, uint32_t address, size_t *end)
+{
+	size_t lo = 0, hi = s->hdr->num, first;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (before(&s->ent[mid], protocol, address))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	first = lo;
+	while (lo < s->hdr->num && s->ent[lo].protocol == protocol && s->ent[lo].address == address)
+		lo++;
+	*end = lo;
+
+	return first;
+}
+
+/* Press searched for in the capture, see search_verify() */
+struct search_match {
+	const struct search_ent *ent;
+	struct rx_event          ev;
+	bool                     found;
+};
+
+static void match(void *arg, const struct rx_event *ev)
+{
+	struct search_match *m = arg;
+	const struct search_ent *e = m->ent;
+
+	if (ev->cmd.protocol != e->protocol || ev->cmd.address != e->address ||
+	    ev->cmd.unit != e->unit || ev->cmd.level != e->level)
+		return;
+	if (ev->time > e->last || ev->last < e->time)
+		return;
+
+	m->ev    = *ev;
+	m->found = true;
+}
+
+/*
+ * Decode the press of @e again, only reading its capture file from the
+ * block it starts in, until it is found or SEARCH_TAIL us after its
+ * last frame.  Returns 1 if found, in @ev, 0 if not, e.g. the file has
+ * been replaced since it was indexed, or -1 if it cannot be read.
+ */
+int search_verify(struct search *s, const struct search_ent *e, struct rx_event *ev)
+{
+	const struct search_file *f = &s->file[e->file];
+	struct search_match m = { .ent = e };
+	struct capture *cap = &s->cap;
+	int32_t val;
+	uint32_t blk;
+	int rc = 0;
+
+	if (!cap->map || s->cur != e->file) {
+		capture_close(cap);
+		if (capture_open(cap, search_name(s, e->file)))
+			return -1;
+		s->cur = e->file;
+	}
+
+	if (cap->hdr->start != f->start || cap->num < f->blocks)
+		return 0;
+	blk = capture_find(cap, e->time);
+	if (cap->idx[blk].offset != e->offset)
+		return 0;
+	if (capture_block(cap, blk))
+		return -1;
+
+	rx_decoder_init(&s->dec, match, &m);
+	while (!m.found && (rc = capture_next(cap, &val)) > 0) {
+		rx_decoder_edge(&s->dec, val, cap->time - LIRC_VALUE(val));
+		if (cap->time > e->last + SEARCH_TAIL)
+			break;
+	}
+	if (rc < 0)
+		return -1;
+	if (!m.found)
+		rx_decoder_flush(&s->dec);
+	if (m.found)
+		*ev = m.ev;
+
+	return m.found;
+}
+
+const char *search_name(const struct search *s, uint32_t file)
+{
+	return &s->names[s->file[file].name];
+}
+
+void search_close(struct search *s)
+{
+	capture_close(&s->cap);
+	if (s->map)
+		munmap(s->map, s->size);
+	memset(s, 0, sizeof(*s));
+}
@@ -0,0 +1,96 @@
+/* Control tool for NEXA and other RF remote receivers
+ *
+ * Copyright (C) 2010, 2012  Tord Andersson <tord.andersson@endian.se>
+ * Copyright (C) 2017        Joachim Nilsson <troglobit@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, visit the Free Software Foundation
+ * website at http://www.gnu.org/licenses/gpl-2.0.html or write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef RFCTL_SEARCH_H_
+#define RFCTL_SEARCH_H_
+
+#include "protocol.h"
+#include "capture.h"
+#include "rx.h"
+
+#define SEARCH_MAGIC   "RFSI"
+#define SEARCH_VERSION 1
+#define SEARCH_TAIL    1000000	/* us read after a press, to verify it */
+
+struct batch;
+
+/*
+ * Sidecar index of commands decoded from an archive of capture files,
+ * written by 'rfctl -I FILE decode'.  Host byte order, like captures:
+ *
+ *     struct search_hdr
+ *     struct search_file[files]
+ *     struct search_ent[num]      sorted by protocol, address, time
+ *     char names[]                NUL terminated paths of the files
+ *
+ * Each entry has the capture block its press starts in, so a search
+ * only reads the blocks of matching presses to verify them.
+ */
+struct search_hdr {
+	char     magic[4];
+	uint16_t version;
+	uint16_t hdr_size;	/* sizeof(struct search_hdr) */
+	uint32_t files;
+	uint32_t num;
+};
+
+struct search_file {
+	uint32_t name;		/* Offset in names[] */
+	uint32_t blocks;	/* In capture file, when indexed */
+	int64_t  start;		/* Wall-clock time of capture file, us */
+};
+
+struct search_ent {
+	int32_t  protocol;
+	uint32_t address;
+	int32_t  unit;
+	int32_t  level;
+	int64_t  time;		/* Start of first frame, us */
+	int64_t  last;		/* Start of last repeat */
+	uint32_t count;		/* Frames */
+	uint32_t file;
+	uint64_t offset;	/* Of capture block the first frame starts in */
+};
+
+/* Memory mapped index */
+struct search {
+	void                     *map;
+	size_t                    size;
+	const struct search_hdr  *hdr;
+	const struct search_file *file;
+	const struct search_ent  *ent;
+	const char               *names;
+	size_t                    len;		/* of names */
+
+	struct capture            cap;		/* Of current file, to verify */
+	uint32_t                  cur;
+	struct rx_decoder         dec;
+};
+
+int         search_save   (const struct batch *b, const char *path);
+int         search_open   (struct search *s, const char *path);
+size_t      search_find   (const struct search *s, int protocol, uint32_t address, size_t *end);
+int         search_verify (struct search *s, const struct search_ent *e, struct rx_event *ev);
+const char *search_name   (const struct search *s, uint32_t file);
+void        search_close  (struct search *s);
+
+#endif /* RFCTL_SEARCH_H_ */
@@ -0,0 +1,299 @@
+/* Control tool for NEXA and other RF remote receivers
+ *
+ * Copyright (C) 2010, 2012  Tord Andersson <tord.andersson@endian.se>
+ * Copyright (C) 2017        Joachim Nilsson <troglobit@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, visit the Free Software Foundation
+ * website at http://www.gnu.org/licenses/gpl-2.0.html or write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "common.h"
+#include "store.h"
+
+/* FNV-1a over the binary key */
+static uint32_t hash(rf_protocol_t protocol, uint32_t address, int unit, int level)
+{
+	uint8_t key[7] = {
+		protocol, address, address >> 8, address >> 16, address >> 24, unit, level
+	};
+	uint32_t h = 2166136261u;
+	size_t i;
+
+	for (i = 0; i < sizeof(key); i++) {
+		h ^= key[i];
+		h *= 16777619u;
+	}
+
+	return h;
+}
+
+static struct store_slot *slot_find(struct store_slot *slot, uint32_t num, rf_protocol_t protocol,
+				    uint32_t address, int unit, int level)
+{
+	uint32_t i = hash(protocol, address, unit, level) & (num - 1);
+	uint32_t probe;
+
+	for (probe = 0; probe < num; probe++) {
+		if (slot[i].protocol == PROT_UNKNOWN)
+			return &slot[i];
+		if (slot[i].protocol == protocol && slot[i].address == address &&
+		    slot[i].unit == unit && slot[i].level == level)
+			return &slot[i];
+		i = (i + 1) & (num - 1);
+	}
+
+	return NULL;	/* Table full */
+}
+
+/*
+ * Read fleet config, one device per line, same as a command without
+ * the level: PROTO GROUP CHANNEL.  Both on and off frames are encoded
+ * for each device and written to the store file at @path.
+ */
+int store_compile(const char *fleet, const char *path)
+{
+	struct store_hdr hdr = { .magic = STORE_MAGIC, .version = STORE_VERSION };
+	struct store_slot *slot = NULL;
+	int32_t *data = NULL;
+	uint32_t num = 0, max = 0, size;
+	char buf[256], tmp[256], next[512];
+	int lineno = 0, err;
+	FILE *fp;
+
+	fp = fopen(fleet, "r");
+	if (!fp)
+		return -1;
+
+	/* Size hash table for at most 50% load */
+	while (fgets(buf, sizeof(buf), fp))
+		max += 2;
+	for (hdr.num_slots = 16; hdr.num_slots < 2 * max; hdr.num_slots <<= 1)
+		;
+
+	size = max * RF_MAX_FRAME_BITS;
+	slot = calloc(hdr.num_slots, sizeof(*slot));
+	data = malloc(size * sizeof(int32_t));
+	if (!slot || !data)
+		goto fail;
+
+	rewind(fp);
+	while (fgets(buf, sizeof(buf), fp)) {
+		char *proto, *group, *channel, *ptr;
+		rf_protocol_t protocol;
+		uint32_t address;
+		int unit, level;
+
+		lineno++;
+		proto = strtok_r(buf, " \t\r\n", &ptr);
+		if (!proto || proto[0] == '#')
+			continue;
+
+		group   = strtok_r(NULL, " \t\r\n", &ptr);
+		channel = strtok_r(NULL, " \t\r\n", &ptr);
+		protocol = rf_protocol(proto);
+		if (!group || !channel || protocol == PROT_UNKNOWN ||
+		    rf_address(protocol, group, channel, &address, &unit))
+			goto error;
+
+		for (level = 0; level < 2; level++) {
+			struct store_slot *s;
+			int32_t frame[RF_MAX_FRAME_BITS];
+			int len, repeat = 0, i;
+
+			s = slot_find(slot, hdr.num_slots, protocol, address, unit, level);
+			if (s->protocol != PROT_UNKNOWN)
+				continue;	/* duplicate */
+
+			snprintf(tmp, sizeof(tmp), "%d", level);
+			len = rf_encode(protocol, group, channel, tmp, frame, &repeat);
+			if (len <= 0 || len > RF_MAX_FRAME_BITS || repeat > 255)
+				goto error;
+
+			if (hdr.data_len + len * repeat > size) {
+				int32_t *ptr;
+
+				size = 2 * size + len * repeat;
+				ptr = realloc(data, size * sizeof(int32_t));
+				if (!ptr)
+					goto fail;
+				data = ptr;
+			}
+
+			s->protocol = protocol;
+			s->address  = address;
+			s->unit     = unit;
+			s->level    = level;
+			s->repeat   = repeat;
+			s->offset   = hdr.data_len;
+			s->len      = len;
+
+			/* Store all repeats back-to-back, ready for one write() */
+			for (i = 0; i < repeat; i++) {
+				memcpy(&data[hdr.data_len], frame, len * sizeof(int32_t));
+				hdr.data_len += len;
+			}
+			num++;
+		}
+	}
+	fclose(fp);
+	hdr.num_frames = num;
+	hdr.slot_size  = sizeof(struct store_slot);
+
+	/*
+	 * Write a new file next to the store and rename it over the old
+	 * one, so a running daemon or a failed write never sees a partial
+	 * store, and the old store is kept if anything goes wrong.
+	 */
+	if ((size_t)snprintf(next, sizeof(next), "%s.tmp", path) >= sizeof(next)) {
+		errno = ENAMETOOLONG;
+		goto fail_free;
+	}
+
+	fp = fopen(next, "w");
+	if (!fp)
+		goto fail_free;
+
+	if (fwrite(&hdr, sizeof(hdr), 1, fp) != 1 ||
+	    fwrite(slot, sizeof(*slot), hdr.num_slots, fp) != hdr.num_slots ||
+	    fwrite(data, sizeof(int32_t), hdr.data_len, fp) != hdr.data_len ||
+	    fflush(fp) || fsync(fileno(fp))) {
+		err = errno;
+		fclose(fp);
+		goto fail_unlink;
+	}
+	if (fclose(fp)) {
+		err = errno;
+		goto fail_unlink;
+	}
+	if (rename(next, path)) {
+		err = errno;
+		goto fail_unlink;
+	}
+
+	free(slot);
+	free(data);
+
+	return 0;
+
+fail_unlink:
+	unlink(next);
+	errno = err;
+	goto fail_free;
+error:
+	fprintf(stderr, "%s:%d: invalid device\n", fleet, lineno);
+	errno = EINVAL;
+fail:
+	fclose(fp);
+fail_free:
+	free(slot);
+	free(data);
+
+	return -1;
+}
+
+/* Map store file read-only, validating header and table bounds */
+int store_open(struct store *st, const char *path)
+{
+	const struct store_hdr *hdr;
+	struct stat sb;
+	size_t need;
+	int fd;
+
+	memset(st, 0, sizeof(*st));
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	if (fstat(fd, &sb) || (size_t)sb.st_size < sizeof(*hdr)) {
+		close(fd);
+		errno = EINVAL;
+		return -1;
+	}
+
+	st->size = sb.st_size;
+	st->map = mmap(NULL, st->size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (st->map == MAP_FAILED) {
+		st->map = NULL;
+		return -1;
+	}
+
+	hdr = st->map;
+	need = sizeof(*hdr) + (size_t)hdr->num_slots * sizeof(struct store_slot) +
+		(size_t)hdr->data_len * sizeof(int32_t);
+	if (memcmp(hdr->magic, STORE_MAGIC, sizeof(hdr->magic)) ||
+	    hdr->version != STORE_VERSION || hdr->slot_size != sizeof(struct store_slot) ||
+	    !hdr->num_slots || (hdr->num_slots & (hdr->num_slots - 1)) || need > st->size) {
+		store_close(st);
+		errno = EINVAL;
+		return -1;
+	}
+
+	st->hdr  = hdr;
+	st->slot = (const struct store_slot *)&hdr[1];
+	st->data = (const int32_t *)&st->slot[hdr->num_slots];
+
+	return 0;
+}
+
+/*
+ * Look up precomputed frame, returns pointer into the mapped file, with
+ * all repeats back-to-back, or NULL if the device or level is not in
+ * the store, or the level is not a plain number.  The caller then falls
+ * back to the encoder, which reports invalid input.
+ */
+const int32_t *store_lookup(const struct store *st, rf_protocol_t protocol, const char *group,
+			    const char *channel, const char *level, int *len, int *repeat)
+{
+	const struct store_slot *s;
+	uint32_t address;
+	char *end;
+	long lvl;
+	int unit;
+
+	if (!st->map || rf_address(protocol, group, channel, &address, &unit))
+		return NULL;
+
+	errno = 0;
+	lvl = strtol(level, &end, 10);
+	if (end == level || *end || errno || lvl < INT_MIN || lvl > INT_MAX)
+		return NULL;
+
+	s = slot_find((struct store_slot *)st->slot, st->hdr->num_slots, protocol,
+		      address, unit, lvl);
+	if (!s || s->protocol == PROT_UNKNOWN ||
+	    (size_t)s->offset + (size_t)s->len * s->repeat > st->hdr->data_len)
+		return NULL;
+
+	*len    = s->len;
+	*repeat = s->repeat;
+
+	return &st->data[s->offset];
+}
+
+void store_close(struct store *st)
+{
+	if (st->map)
+		munmap(st->map, st->size);
+	memset(st, 0, sizeof(*st));
+}
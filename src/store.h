@@ -0,0 +1,73 @@
+/* Control tool for NEXA and other RF remote receivers
+ *
+ * Copyright (C) 2010, 2012  Tord Andersson <tord.andersson@endian.se>
+ * Copyright (C) 2017        Joachim Nilsson <troglobit@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, visit the Free Software Foundation
+ * website at http://www.gnu.org/licenses/gpl-2.0.html or write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef RFCTL_STORE_H_
+#define RFCTL_STORE_H_
+
+#include "protocol.h"
+
+#define STORE_MAGIC    "RFCS"
+#define STORE_VERSION  1
+
+/*
+ * Precomputed frame store, a file with every (device, on/off) frame of
+ * a fleet already encoded, including repeats.  Built on the target, so
+ * all fields are in host byte order.  Layout:
+ *
+ *     struct store_hdr
+ *     struct store_slot[num_slots]    open addressing hash table
+ *     int32_t data[data_len]          LIRC mode2 elements
+ */
+struct store_hdr {
+	char     magic[4];
+	uint16_t version;
+	uint16_t slot_size;	/* sizeof(struct store_slot) */
+	uint32_t num_slots;	/* power of two */
+	uint32_t num_frames;
+	uint32_t data_len;	/* elements */
+};
+
+struct store_slot {
+	uint32_t address;
+	uint8_t  protocol;	/* PROT_UNKNOWN marks an empty slot */
+	uint8_t  unit;
+	uint8_t  level;
+	uint8_t  repeat;
+	uint32_t offset;	/* first element in data[] */
+	uint32_t len;		/* elements in one frame */
+};
+
+struct store {
+	void                    *map;
+	size_t                   size;
+	const struct store_hdr  *hdr;
+	const struct store_slot *slot;
+	const int32_t           *data;
+};
+
+int            store_compile (const char *fleet, const char *path);
+int            store_open    (struct store *st, const char *path);
+const int32_t *store_lookup  (const struct store *st, rf_protocol_t protocol, const char *group,
+			      const char *channel, const char *level, int *len, int *repeat);
+void           store_close   (struct store *st);
+
+#endif /* RFCTL_STORE_H_ */
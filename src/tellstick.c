@@ -0,0 +1,82 @@
+/* Control tool for NEXA and other RF remote receivers
+ *
+ * Copyright (C) 2010, 2012  Tord Andersson <tord.andersson@endian.se>
+ * Copyright (C) 2017        Joachim Nilsson <troglobit@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, visit the Free Software Foundation
+ * website at http://www.gnu.org/licenses/gpl-2.0.html or write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "common.h"
+#include "protocol.h"
+
+/*
+ * Each pulse/space is sent as one byte, in units of 10 us.  The '+'
+ * character terminates a command so that value is nudged to the next
+ * tick, 10 us is well within the tolerance of all receivers.
+ */
+static int tick(int32_t val)
+{
+	int t = (LIRC_VALUE(val) + TELLSTICK_TICK / 2) / TELLSTICK_TICK;
+
+	if (t < 1)
+		t = 1;
+	if (t == '+')
+		t++;
+
+	return t;
+}
+
+/*
+ * Convert generic bitstream format to Tellstick format:
+ *
+ *   'P' <pause ms> 'R' <repeat> 'S' <t0> <t1> ... <tN> '+'
+ *
+ * The trailing sync space of a frame is too long for a single 10 us
+ * tick, so it is sent as the pause between repetitions instead.
+ * Returns length of command, or 0 if the bitstream cannot be encoded.
+ */
+int bitstream2tellstick(const int32_t *bitstream, int len, int repeat, char *cmd)
+{
+	int pause = 0;
+	int i, j = 0;
+
+	if (len > 0 && LIRC_IS_SPACE(bitstream[len - 1]) &&
+	    LIRC_VALUE(bitstream[len - 1]) > TELLSTICK_MAX_TICK * TELLSTICK_TICK) {
+		pause = (LIRC_VALUE(bitstream[len - 1]) + 999) / 1000;
+		len--;
+	}
+
+	if (len <= 0 || len > TELLSTICK_MAX_PULSES || repeat < 1 || repeat > 255 || pause > 255)
+		return 0;
+
+	if (pause) {
+		cmd[j++] = 'P';
+		cmd[j++] = pause;
+	}
+	cmd[j++] = 'R';
+	cmd[j++] = repeat;
+	cmd[j++] = 'S';
+
+	for (i = 0; i < len; i++) {
+		if (LIRC_VALUE(bitstream[i]) > TELLSTICK_MAX_TICK * TELLSTICK_TICK)
+			return 0;
+		cmd[j++] = tick(bitstream[i]);
+	}
+	cmd[j++] = '+';
+
+	return j;
+}
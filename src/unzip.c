@@ -0,0 +1,439 @@
+/* Control tool for NEXA and other RF remote receivers
+ *
+ * Copyright (C) 2010, 2012  Tord Andersson <tord.andersson@endian.se>
+ * Copyright (C) 2017        Joachim Nilsson <troglobit@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, visit the Free Software Foundation
+ * website at http://www.gnu.org/licenses/gpl-2.0.html or write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "unzip.h"
+
+#define ZIP_LOCAL   0x04034b50
+#define ZIP_CENTRAL 0x02014b50
+#define ZIP_END     0x06054b50
+
+/* Deflate, RFC 1951 */
+#define STORED  0
+#define FIXED   1
+#define DYNAMIC 2
+
+static const uint16_t len_base[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t len_extra[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t dist_base[30] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t dist_extra[30] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+static int fail(int err)
+{
+	errno = err;
+	return -1;
+}
+
+static uint32_t get16(const uint8_t *p)
+{
+	return p[0] | p[1] << 8;
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+	return get16(p) | get16(p + 2) << 16;
+}
+
+/* Past the end of the member is a bad stream, reads as zeros from then on */
+static uint32_t bits(struct unzip *z, int num)
+{
+	uint32_t val;
+
+	while (z->nbits < num) {
+		if (z->in >= z->end) {
+			z->error = true;
+			return 0;
+		}
+		z->bits |= (uint32_t)*z->in++ << z->nbits;
+		z->nbits += 8;
+	}
+
+	val = z->bits & ((1UL << num) - 1);
+	z->bits >>= num;
+	z->nbits -= num;
+
+	return val;
+}
+
+/* Build code from lengths, returns -1 if over-subscribed */
+static int build(struct unzip_huff *h, const uint8_t *len, int num)
+{
+	uint16_t offs[16];
+	int left = 1;
+	int i;
+
+	memset(h->count, 0, sizeof(h->count));
+	for (i = 0; i < num; i++)
+		h->count[len[i]]++;
+	h->count[0] = 0;
+
+	for (i = 1; i < 16; i++) {
+		left <<= 1;
+		left -= h->count[i];
+		if (left < 0)
+			return -1;
+	}
+
+	offs[1] = 0;
+	for (i = 1; i < 15; i++)
+		offs[i + 1] = offs[i] + h->count[i];
+	for (i = 0; i < num; i++) {
+		if (len[i])
+			h->symbol[offs[len[i]]++] = i;
+	}
+
+	return 0;
+}
+
+/* One bit at a time, codes are stored most significant bit first */
+static int decode(struct unzip *z, const struct unzip_huff *h)
+{
+	int code = 0, first = 0, index = 0;
+	int len;
+
+	for (len = 1; len < 16; len++) {
+		int count = h->count[len];
+
+		code |= bits(z, 1);
+		if (code - count < first)
+			return h->symbol[index + code - first];
+		index += count;
+		first  = (first + count) << 1;
+		code <<= 1;
+	}
+	z->error = true;
+
+	return -1;
+}
+
+static void fixed(struct unzip *z)
+{
+	uint8_t len[288];
+	int i;
+
+	for (i = 0; i < 144; i++)
+		len[i] = 8;
+	for (; i < 256; i++)
+		len[i] = 9;
+	for (; i < 280; i++)
+		len[i] = 7;
+	for (; i < 288; i++)
+		len[i] = 8;
+	build(&z->lit, len, 288);
+
+	for (i = 0; i < 30; i++)
+		len[i] = 5;
+	build(&z->dst, len, 30);
+}
+
+static int dynamic(struct unzip *z)
+{
+	static const uint8_t order[19] = {
+		16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+	};
+	uint8_t len[320];
+	int nlit, ndist, ncode;
+	int i, sym, rep;
+
+	nlit  = bits(z, 5) + 257;
+	ndist = bits(z, 5) + 1;
+	ncode = bits(z, 4) + 4;
+	if (nlit > 286 || ndist > 30)
+		return -1;
+
+	memset(len, 0, sizeof(len));
+	for (i = 0; i < ncode; i++)
+		len[order[i]] = bits(z, 3);
+	if (build(&z->lit, len, 19))
+		return -1;
+
+	for (i = 0; i < nlit + ndist; ) {
+		sym = decode(z, &z->lit);
+		if (sym < 0 || z->error)
+			return -1;
+
+		if (sym < 16) {
+			len[i++] = sym;
+			continue;
+		}
+
+		if (sym == 16) {
+			if (!i)
+				return -1;
+			sym = len[i - 1];
+			rep = 3 + bits(z, 2);
+		} else if (sym == 17) {
+			sym = 0;
+			rep = 3 + bits(z, 3);
+		} else {
+			sym = 0;
+			rep = 11 + bits(z, 7);
+		}
+		if (i + rep > nlit + ndist)
+			return -1;
+		while (rep--)
+			len[i++] = sym;
+	}
+
+	if (!len[256] || build(&z->lit, len, nlit) || build(&z->dst, &len[nlit], ndist))
+		return -1;
+
+	return 0;
+}
+
+/* Next block header, returns -1 on bad data */
+static int block(struct unzip *z)
+{
+	z->last = bits(z, 1);
+	z->type = bits(z, 2);
+
+	switch (z->type) {
+	case STORED:
+		z->bits  = 0;
+		z->nbits = 0;
+		if (z->end - z->in < 4 || get16(z->in) != (~get16(z->in + 2) & 0xffff))
+			return -1;
+		z->stored = get16(z->in);
+		z->in += 4;
+		if (z->stored > (size_t)(z->end - z->in))
+			return -1;
+		return 0;
+
+	case FIXED:
+		fixed(z);
+		return 0;
+
+	case DYNAMIC:
+		return dynamic(z);
+	}
+
+	return -1;
+}
+
+static void out(struct unzip *z, uint8_t *buf, size_t *num, uint8_t byte)
+{
+	z->win[z->pos++ & (UNZIP_WINDOW - 1)] = byte;
+	buf[(*num)++] = byte;
+}
+
+static ssize_t inflate(struct unzip *z, uint8_t *buf, size_t len)
+{
+	size_t num = 0;
+	int sym;
+
+	while (num < len) {
+		if (z->copy) {
+			out(z, buf, &num, z->win[(z->pos - z->dist) & (UNZIP_WINDOW - 1)]);
+			z->copy--;
+			continue;
+		}
+
+		if (z->type < 0) {
+			if (z->last)
+				break;
+			if (block(z) || z->error)
+				return fail(EINVAL);
+			continue;
+		}
+
+		if (z->type == STORED) {
+			if (!z->stored) {
+				z->type = -1;
+				continue;
+			}
+			out(z, buf, &num, *z->in++);
+			z->stored--;
+			continue;
+		}
+
+		sym = decode(z, &z->lit);
+		if (sym < 256) {
+			if (sym < 0)
+				return fail(EINVAL);
+			out(z, buf, &num, sym);
+			continue;
+		}
+		if (sym == 256) {
+			z->type = -1;
+			continue;
+		}
+
+		sym -= 257;
+		if (sym >= 29)
+			return fail(EINVAL);
+		z->copy = len_base[sym] + bits(z, len_extra[sym]);
+
+		sym = decode(z, &z->dst);
+		if (sym < 0 || sym >= 30)
+			return fail(EINVAL);
+		z->dist = dist_base[sym] + bits(z, dist_extra[sym]);
+		if ((uint32_t)z->dist > z->pos || z->error)
+			return fail(EINVAL);
+	}
+
+	return num;
+}
+
+/* Map archive read-only and locate its central directory */
+int unzip_open(struct unzip *z, const char *path)
+{
+	const uint8_t *p, *eocd = NULL;
+	struct stat sb;
+	uint32_t off, len;
+	int fd;
+
+	memset(z, 0, sizeof(*z));
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	if (fstat(fd, &sb) || (size_t)sb.st_size < 22) {
+		close(fd);
+		return fail(EINVAL);
+	}
+
+	z->size = sb.st_size;
+	z->map = mmap(NULL, z->size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (z->map == MAP_FAILED) {
+		z->map = NULL;
+		return -1;
+	}
+
+	/* End record is last, followed by a comment of up to 64 kiB */
+	for (p = (const uint8_t *)z->map + z->size - 22; p >= (const uint8_t *)z->map; p--) {
+		if (get32(p) == ZIP_END) {
+			eocd = p;
+			break;
+		}
+		if ((const uint8_t *)z->map + z->size - p > 22 + 65535)
+			break;
+	}
+	if (!eocd)
+		goto invalid;
+
+	z->entries = get16(eocd + 10);
+	len = get32(eocd + 12);
+	off = get32(eocd + 16);
+	if ((uint64_t)off + len > z->size)
+		goto invalid;
+	z->cd = (const uint8_t *)z->map + off;
+
+	return 0;
+invalid:
+	unzip_close(z);
+	return fail(EINVAL);
+}
+
+/* Start reading member @name, returns -1 with ENOENT if there is none */
+int unzip_member(struct unzip *z, const char *name)
+{
+	const uint8_t *base = z->map, *p = z->cd, *lh;
+	size_t len = strlen(name);
+	uint32_t i;
+
+	z->in = z->end = NULL;
+	for (i = 0; i < z->entries; i++) {
+		uint32_t nlen, off, csize;
+
+		if (p + 46 > base + z->size || get32(p) != ZIP_CENTRAL)
+			return fail(EINVAL);
+		nlen = get16(p + 28);
+		if (p + 46 + nlen > base + z->size)
+			return fail(EINVAL);
+
+		if (nlen != len || memcmp(p + 46, name, len)) {
+			p += 46 + nlen + get16(p + 30) + get16(p + 32);
+			continue;
+		}
+
+		z->method = get16(p + 10);
+		csize = get32(p + 20);
+		off = get32(p + 42);
+		if (z->method != 0 && z->method != 8)
+			return fail(ENOTSUP);
+		if (csize == UINT32_MAX || (uint64_t)off + 30 > z->size)
+			return fail(EFBIG);
+
+		lh = base + off;
+		if (get32(lh) != ZIP_LOCAL)
+			return fail(EINVAL);
+		lh += 30 + get16(lh + 26) + get16(lh + 28);
+		if (lh + csize > base + z->size)
+			return fail(EINVAL);
+
+		z->in    = lh;
+		z->end   = lh + csize;
+		z->error = false;
+		z->bits  = 0;
+		z->nbits = 0;
+		z->type  = -1;
+		z->last  = false;
+		z->copy  = 0;
+		z->pos   = 0;
+
+		return 0;
+	}
+
+	return fail(ENOENT);
+}
+
+/* Up to @len bytes of current member, returns 0 at its end, or -1 */
+ssize_t unzip_read(struct unzip *z, void *buf, size_t len)
+{
+	if (z->method == 0) {
+		size_t left = z->end - z->in;
+
+		if (len > left)
+			len = left;
+		memcpy(buf, z->in, len);
+		z->in += len;
+
+		return len;
+	}
+
+	return inflate(z, buf, len);
+}
+
+void unzip_close(struct unzip *z)
+{
+	if (z->map)
+		munmap(z->map, z->size);
+	memset(z, 0, sizeof(*z));
+}
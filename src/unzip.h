@@ -0,0 +1,72 @@
+/* Control tool for NEXA and other RF remote receivers
+ *
+ * Copyright (C) 2010, 2012  Tord Andersson <tord.andersson@endian.se>
+ * Copyright (C) 2017        Joachim Nilsson <troglobit@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, visit the Free Software Foundation
+ * website at http://www.gnu.org/licenses/gpl-2.0.html or write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef RFCTL_UNZIP_H_
+#define RFCTL_UNZIP_H_
+
+#include <sys/types.h>
+
+#include "common.h"
+
+#define UNZIP_WINDOW 32768	/* Max distance back of a deflate match */
+
+/* Canonical Huffman code, number of codes per length and symbols in order */
+struct unzip_huff {
+	uint16_t count[16];
+	uint16_t symbol[288];
+};
+
+/*
+ * Streaming reader of one member at a time of a memory mapped zip
+ * archive, stored or deflated.  Output is pulled in any size pieces,
+ * only the last 32 kiB are kept, so members of any size can be read in
+ * bounded memory.  No zip64, members and archive are below 4 GiB.
+ */
+struct unzip {
+	void              *map;
+	size_t             size;
+	const uint8_t     *cd;		/* Central directory */
+	uint32_t           entries;
+
+	/* Current member */
+	const uint8_t     *in, *end;	/* Compressed data left */
+	int                method;	/* 0 stored, 8 deflated */
+	bool               error;
+
+	/* Inflate state */
+	uint32_t           bits;
+	int                nbits;
+	int                type;	/* Of current block, -1 between blocks */
+	bool               last;	/* Current block is the final one */
+	uint32_t           stored;	/* Bytes left of stored block */
+	int                copy, dist;	/* Match being copied */
+	struct unzip_huff  lit, dst;
+	uint8_t            win[UNZIP_WINDOW];
+	uint32_t           pos;
+};
+
+int     unzip_open   (struct unzip *z, const char *path);
+int     unzip_member (struct unzip *z, const char *name);
+ssize_t unzip_read   (struct unzip *z, void *buf, size_t len);
+void    unzip_close  (struct unzip *z);
+
+#endif /* RFCTL_UNZIP_H_ */